@@ -0,0 +1,110 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+#include "nyga_distribution.h"
+#include "probabilistic_circuit.h"
+#include "univariate.h"
+#include "variable.h"
+
+/**
+ * The seed of all generators such that every run measures the same data.
+ */
+const unsigned benchmark_seed = 69;
+
+/**
+ * Generate normally distributed samples of which a share are repetitions of other samples.
+ * @param size The number of samples.
+ * @param duplicate_percentage The percentage of samples that repeat an earlier sample.
+ * @return The shuffled samples.
+ */
+inline DataVector samples_with_duplicates(size_t size, size_t duplicate_percentage) {
+    std::mt19937_64 generator(benchmark_seed);
+    std::normal_distribution<double> normal(0, 1);
+
+    auto number_of_unique_values = std::max<size_t>(1, size * (100 - duplicate_percentage) / 100);
+    DataVector result(size);
+    std::generate(result.begin(), result.begin() + number_of_unique_values, [&]() { return normal(generator); });
+    std::uniform_int_distribution<size_t> unique_index(0, number_of_unique_values - 1);
+    for (size_t index = number_of_unique_values; index < size; index++) {
+        result[index] = result[unique_index(generator)];
+    }
+    std::shuffle(result.begin(), result.end(), generator);
+    return result;
+}
+
+/**
+ * Generate column-major data that is uniformly distributed in [0, 1).
+ * @param number_of_variables The number of columns.
+ * @param n_rows The number of rows.
+ * @return The data.
+ */
+inline std::vector<double> uniform_rows(size_t number_of_variables, size_t n_rows) {
+    std::mt19937_64 generator(benchmark_seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<double> result(number_of_variables * n_rows);
+    std::generate(result.begin(), result.end(), [&]() { return uniform(generator); });
+    return result;
+}
+
+/**
+ * Create continuous variables named x_000, x_001, ... such that their order matches their index.
+ * @param number_of_variables The number of variables.
+ * @return The variables.
+ */
+inline std::vector<ContinuousPtr_t> continuous_variables(size_t number_of_variables) {
+    std::vector<ContinuousPtr_t> result;
+    for (size_t index = 0; index < number_of_variables; index++) {
+        auto name = std::to_string(index);
+        result.push_back(make_shared_continuous("x_" + std::string(3 - name.size(), '0') + name));
+    }
+    return result;
+}
+
+/**
+ * Create a uniform distribution with a random support that overlaps [0, 1).
+ */
+inline ProbabilisticCircuitPtr_t random_uniform(const ContinuousPtr_t &variable, std::mt19937_64 &generator) {
+    std::uniform_real_distribution<double> lower(-0.2, 0.5);
+    auto lower_bound = lower(generator);
+    return UniformDistribution::make_shared(variable, closed_open<double>(lower_bound, lower_bound + 0.8));
+}
+
+/**
+ * Create a circuit of alternating sum and product layers.
+ *
+ * Every sum has `width` children, every product splits its variables into two halves. Once the depth is exhausted
+ * or only one variable is left, a product of uniform leaves is created.
+ * @param variables The variables of the circuit.
+ * @param depth The number of sum layers.
+ * @param width The number of children of every sum.
+ * @param generator The random generator for the weights and supports.
+ * @return The circuit.
+ */
+inline ProbabilisticCircuitPtr_t random_circuit(const std::vector<ContinuousPtr_t> &variables, size_t depth,
+                                                size_t width, std::mt19937_64 &generator) {
+    if (variables.size() == 1) {
+        return random_uniform(variables[0], generator);
+    }
+    if (depth == 0) {
+        auto product = std::make_shared<DecomposableProductUnit>();
+        for (auto &variable: variables) {
+            product->add_subcircuit(random_uniform(variable, generator));
+        }
+        return product;
+    }
+
+    std::uniform_real_distribution<double> weight(0.1, 1);
+    auto sum = std::make_shared<SmoothSumUnit>();
+    auto middle = variables.begin() + (long) variables.size() / 2;
+    std::vector<ContinuousPtr_t> left(variables.begin(), middle);
+    std::vector<ContinuousPtr_t> right(middle, variables.end());
+    for (size_t child = 0; child < width; child++) {
+        auto product = std::make_shared<DecomposableProductUnit>();
+        product->add_subcircuit(random_circuit(left, depth - 1, width, generator));
+        product->add_subcircuit(random_circuit(right, depth - 1, width, generator));
+        sum->add_subcircuit(weight(generator), product);
+    }
+    return sum;
+}
@@ -0,0 +1,29 @@
+#include "benchmark/benchmark.h"
+#include "benchmark_data.h"
+#include "joint_probability_tree.h"
+
+
+static void BM_JointProbabilityTreeFit(benchmark::State &state) {
+    auto n_rows = (size_t) state.range(0);
+    auto number_of_variables = (size_t) state.range(1);
+    auto data = uniform_rows(number_of_variables, n_rows);
+    auto variables = make_shared_variable_set();
+    for (auto &variable: continuous_variables(number_of_variables)) {
+        variables->insert(variable);
+    }
+    auto tree = JointProbabilityTree::make_shared(variables, n_rows / 100, 0.01);
+    tree->min_samples_per_quantile = n_rows / 1000;
+    tree->number_of_threads = (size_t) state.range(2);
+
+    for (auto _: state) {
+        auto result = tree->fit(data.data(), n_rows);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * n_rows));
+}
+
+BENCHMARK(BM_JointProbabilityTreeFit)
+        ->ArgNames({"rows", "variables", "threads"})
+        ->ArgsProduct({{10000, 100000}, {4, 16}, {1, 4}})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
@@ -0,0 +1,94 @@
+#include "benchmark/benchmark.h"
+#include "benchmark_data.h"
+#include "nyga_distribution.h"
+
+
+static void BM_NygaDistributionFit(benchmark::State &state) {
+    auto size = (size_t) state.range(0);
+    auto duplicate_percentage = (size_t) state.range(1);
+    auto samples = samples_with_duplicates(size, duplicate_percentage);
+    auto model = NygaDistribution::make_shared(make_shared_continuous("x"), std::max<size_t>(1, size / 1000), 0.01);
+
+    DataVector data;
+    for (auto _: state) {
+        // fit sorts the data in place
+        state.PauseTiming();
+        data = samples;
+        state.ResumeTiming();
+        auto result = model->fit(&data);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * size));
+}
+
+BENCHMARK(BM_NygaDistributionFit)
+        ->ArgNames({"size", "duplicate_percentage"})
+        ->ArgsProduct({{1000, 10000, 100000, 1000000, 10000000}, {0, 50, 90}})
+        ->Unit(benchmark::kMillisecond);
+
+
+/**
+ * Fit and discard models with their quantiles on the heap (0) or in an arena (1).
+ */
+static void BM_NygaDistributionFitAndDiscard(benchmark::State &state) {
+    auto size = (size_t) state.range(0);
+    auto samples = samples_with_duplicates(size, 0);
+    auto model = NygaDistribution::make_shared(make_shared_continuous("x"), 1, 0.01);
+    model->allocate_in_arena = state.range(1) == 1;
+
+    DataVector data;
+    for (auto _: state) {
+        state.PauseTiming();
+        data = samples;
+        state.ResumeTiming();
+        auto result = model->fit(&data);
+        state.counters["quantiles"] = (double) result->sub_circuits.size();
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * size));
+}
+
+BENCHMARK(BM_NygaDistributionFitAndDiscard)
+        ->ArgNames({"size", "arena"})
+        ->ArgsProduct({{1000, 10000}, {0, 1}})
+        ->Unit(benchmark::kMillisecond);
+
+
+static void BM_NygaDistributionFitWeighted(benchmark::State &state) {
+    auto size = (size_t) state.range(0);
+    auto samples = samples_with_duplicates(size, 0);
+    std::sort(samples.begin(), samples.end());
+    WeightsVector weights(size, 1.);
+    auto model = NygaDistribution::make_shared(make_shared_continuous("x"), std::max<size_t>(1, size / 1000), 0.01);
+
+    for (auto _: state) {
+        auto result = model->fit_weighted(samples, weights);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * size));
+}
+
+BENCHMARK(BM_NygaDistributionFitWeighted)
+        ->ArgName("size")
+        ->RangeMultiplier(10)->Range(1000, 1000000)
+        ->Unit(benchmark::kMillisecond);
+
+
+static void BM_NygaDistributionLogLikelihood(benchmark::State &state) {
+    auto size = (size_t) state.range(0);
+    auto samples = samples_with_duplicates(size, 0);
+    auto model = NygaDistribution::make_shared(make_shared_continuous("x"), 10, 0.01)->fit(&samples);
+
+    size_t n_rows = 10000;
+    auto data = samples_with_duplicates(n_rows, 0);
+    std::vector<double> out(n_rows);
+    for (auto _: state) {
+        model->log_likelihood_batch(data.data(), n_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.counters["quantiles"] = (double) model->sub_circuits.size();
+    state.SetItemsProcessed((int64_t) (state.iterations() * n_rows));
+}
+
+BENCHMARK(BM_NygaDistributionLogLikelihood)
+        ->ArgName("fit_size")
+        ->RangeMultiplier(10)->Range(1000, 100000);
@@ -0,0 +1,300 @@
+#include "benchmark/benchmark.h"
+#include "benchmark_data.h"
+#include "compiled_circuit.h"
+#include "parallel_evaluator.h"
+#include "probabilistic_circuit.h"
+#include "single_precision_circuit.h"
+#include "static_circuit.h"
+#include "univariate.h"
+
+const size_t benchmark_rows = 10000;
+
+
+static void BM_SmoothSumUnitLogLikelihood(benchmark::State &state) {
+    auto width = (size_t) state.range(0);
+    std::mt19937_64 generator(benchmark_seed);
+    auto variable = continuous_variables(1)[0];
+    auto model = std::make_shared<SmoothSumUnit>();
+    for (size_t child = 0; child < width; child++) {
+        model->add_subcircuit(1. / (double) width, random_uniform(variable, generator));
+    }
+
+    auto data = uniform_rows(1, benchmark_rows);
+    std::vector<double> out(benchmark_rows);
+    for (auto _: state) {
+        model->log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_SmoothSumUnitLogLikelihood)->ArgName("width")->RangeMultiplier(4)->Range(2, 512);
+
+
+static void BM_DecomposableProductUnitLogLikelihood(benchmark::State &state) {
+    auto width = (size_t) state.range(0);
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = std::make_shared<DecomposableProductUnit>();
+    for (auto &variable: continuous_variables(width)) {
+        model->add_subcircuit(random_uniform(variable, generator));
+    }
+
+    auto data = uniform_rows(width, benchmark_rows);
+    std::vector<double> out(benchmark_rows);
+    for (auto _: state) {
+        model->log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_DecomposableProductUnitLogLikelihood)->ArgName("width")->RangeMultiplier(4)->Range(2, 128);
+
+
+static void BM_DecomposableProductUnitLogLikelihoodPerRow(benchmark::State &state) {
+    auto width = (size_t) state.range(0);
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = std::make_shared<DecomposableProductUnit>();
+    for (auto &variable: continuous_variables(width)) {
+        model->add_subcircuit(random_uniform(variable, generator));
+    }
+
+    auto event = std::make_shared<FullEvidence>(uniform_rows(width, 1));
+    for (auto _: state) {
+        benchmark::DoNotOptimize(model->log_likelihood(event));
+    }
+    state.SetItemsProcessed((int64_t) state.iterations());
+}
+
+BENCHMARK(BM_DecomposableProductUnitLogLikelihoodPerRow)->ArgName("width")->RangeMultiplier(4)->Range(2, 128);
+
+
+/**
+ * Evaluate a mixture of 4 products of 4 uniform distributions one row at a time.
+ * The argument selects the implementation: 0 runtime circuit, 1 compiled, 2 static.
+ */
+static void BM_SmallMixtureLogLikelihoodPerRow(benchmark::State &state) {
+    auto path = state.range(0);
+    std::mt19937_64 generator(benchmark_seed);
+    auto variables = continuous_variables(4);
+    auto model = std::make_shared<SmoothSumUnit>();
+    for (size_t component = 0; component < 4; component++) {
+        auto product = std::make_shared<DecomposableProductUnit>();
+        for (auto &variable: variables) {
+            product->add_subcircuit(random_uniform(variable, generator));
+        }
+        model->add_subcircuit(0.25, product);
+    }
+    auto compiled = CompiledCircuit::make_shared(model);
+    StaticCircuit<StaticMixture<StaticProduct<StaticUniform, StaticUniform, StaticUniform, StaticUniform>, 4>>
+            static_model(model);
+
+    auto event = std::make_shared<FullEvidence>(uniform_rows(4, 1));
+    for (auto _: state) {
+        if (path == 0) {
+            benchmark::DoNotOptimize(model->log_likelihood(event));
+        } else if (path == 1) {
+            benchmark::DoNotOptimize(compiled->log_likelihood(event));
+        } else {
+            benchmark::DoNotOptimize(static_model.log_likelihood(event->data()));
+        }
+    }
+    state.SetItemsProcessed((int64_t) state.iterations());
+}
+
+BENCHMARK(BM_SmallMixtureLogLikelihoodPerRow)->ArgName("path")->DenseRange(0, 2);
+
+
+/**
+ * Evaluate a circuit of alternating sum and product layers over 16 variables.
+ * The second argument selects the evaluation path: 0 row by row, 1 batched, 2 compiled, 3 compiled in single
+ * precision.
+ */
+static void BM_CircuitLogLikelihood(benchmark::State &state) {
+    auto depth = (size_t) state.range(0);
+    auto path = state.range(1);
+    size_t number_of_variables = 16;
+    size_t width = 3;
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = random_circuit(continuous_variables(number_of_variables), depth, width, generator);
+    auto compiled = CompiledCircuit::make_shared(model);
+    SinglePrecisionCircuit single_precision(compiled, compiled->tape());
+
+    auto data = uniform_rows(number_of_variables, benchmark_rows);
+    std::vector<double> out(benchmark_rows);
+    std::vector<float> float_data(data.begin(), data.end());
+    std::vector<float> float_out(benchmark_rows);
+    auto event = std::make_shared<FullEvidence>(number_of_variables);
+    for (auto _: state) {
+        if (path == 0) {
+            for (size_t row = 0; row < benchmark_rows; row++) {
+                for (size_t column = 0; column < number_of_variables; column++) {
+                    (*event)[column] = data[column * benchmark_rows + row];
+                }
+                out[row] = model->log_likelihood(event);
+            }
+        } else if (path == 1) {
+            model->log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        } else if (path == 2) {
+            compiled->log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        } else {
+            single_precision.log_likelihood_batch(float_data.data(), benchmark_rows, float_out.data());
+        }
+        benchmark::DoNotOptimize(out.data());
+        benchmark::DoNotOptimize(float_out.data());
+    }
+    state.counters["nodes"] = (double) compiled->number_of_nodes();
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_CircuitLogLikelihood)
+        ->ArgNames({"depth", "path"})
+        ->ArgsProduct({{1, 2, 3}, {0, 1, 2, 3}})
+        ->Unit(benchmark::kMillisecond);
+
+
+/**
+ * Evaluate a circuit of depth 3 over 16 variables on a pool of threads.
+ * The rows are scaled with the threads such that every thread evaluates the same number of blocks.
+ */
+static void BM_ParallelCircuitLogLikelihood(benchmark::State &state) {
+    auto number_of_threads = (size_t) state.range(0);
+    size_t number_of_variables = 16;
+    size_t n_rows = 16 * ProbabilisticModel::batch_block_size * number_of_threads;
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = random_circuit(continuous_variables(number_of_variables), 3, 3, generator);
+    ParallelEvaluator evaluator(model, number_of_threads);
+
+    auto data = uniform_rows(number_of_variables, n_rows);
+    std::vector<double> out(n_rows);
+    for (auto _: state) {
+        evaluator.log_likelihood_batch(data.data(), n_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * n_rows));
+    state.SetBytesProcessed((int64_t) (state.iterations() * n_rows * (number_of_variables + 1) * sizeof(double)));
+}
+
+BENCHMARK(BM_ParallelCircuitLogLikelihood)
+        ->ArgName("threads")
+        ->RangeMultiplier(2)
+        ->Range(1, 32)
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+
+static void BM_UniformDistributionLogLikelihood(benchmark::State &state) {
+    auto model = UniformDistribution(make_shared_continuous("x"), closed_open<double>(0.2, 0.7));
+    auto data = uniform_rows(1, benchmark_rows);
+    std::vector<double> out(benchmark_rows);
+    for (auto _: state) {
+        model.log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_UniformDistributionLogLikelihood);
+
+
+static void BM_DiracDeltaDistributionLogLikelihood(benchmark::State &state) {
+    auto model = DiracDeltaDistribution(make_shared_continuous("x"), 0.5, 2.);
+    auto data = uniform_rows(1, benchmark_rows);
+    std::vector<double> out(benchmark_rows);
+    for (auto _: state) {
+        model.log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_DiracDeltaDistributionLogLikelihood);
+
+
+static void BM_DiscreteDistributionLogLikelihood(benchmark::State &state) {
+    auto number_of_codes = (int) state.range(0);
+    std::map<int, double> probabilities;
+    for (int code = 0; code < number_of_codes; code++) {
+        probabilities[code] = 1. / number_of_codes;
+    }
+    auto model = IntegerDistribution(make_shared_integer("i"), probabilities);
+
+    std::mt19937_64 generator(benchmark_seed);
+    std::uniform_int_distribution<int> code(0, number_of_codes - 1);
+    std::vector<double> data(benchmark_rows);
+    std::generate(data.begin(), data.end(), [&]() { return (double) code(generator); });
+    std::vector<double> out(benchmark_rows);
+    for (auto _: state) {
+        model.log_likelihood_batch(data.data(), benchmark_rows, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_DiscreteDistributionLogLikelihood)->ArgName("codes")->RangeMultiplier(8)->Range(2, 512);
+
+
+/**
+ * One iteration of expectation maximization of a circuit of depth 3 over 16 variables.
+ */
+static void BM_CircuitExpectationMaximization(benchmark::State &state) {
+    auto number_of_threads = (size_t) state.range(0);
+    size_t number_of_variables = 16;
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = random_circuit(continuous_variables(number_of_variables), 3, 3, generator);
+
+    auto data = uniform_rows(number_of_variables, benchmark_rows);
+    for (auto _: state) {
+        benchmark::DoNotOptimize(model->expectation_maximization(data.data(), benchmark_rows, 1, number_of_threads));
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_CircuitExpectationMaximization)
+        ->ArgName("threads")
+        ->RangeMultiplier(2)
+        ->Range(1, 8)
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+
+/**
+ * The gradient of the log-likelihood with respect to the weights and inputs of a circuit over 16 variables.
+ */
+static void BM_CircuitLogLikelihoodGradient(benchmark::State &state) {
+    auto depth = (size_t) state.range(0);
+    size_t number_of_variables = 16;
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = random_circuit(continuous_variables(number_of_variables), depth, 3, generator);
+
+    auto data = uniform_rows(number_of_variables, benchmark_rows);
+    std::vector<double> log_likelihoods(benchmark_rows);
+    std::vector<double> weight_gradients(model->number_of_sum_weights());
+    std::vector<double> input_gradients(data.size());
+    for (auto _: state) {
+        model->log_likelihood_gradient(data.data(), benchmark_rows, log_likelihoods.data(), weight_gradients.data(),
+                                       input_gradients.data());
+        benchmark::DoNotOptimize(weight_gradients.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_CircuitLogLikelihoodGradient)->ArgName("depth")->DenseRange(1, 3)->Unit(benchmark::kMillisecond);
+
+
+static void BM_CircuitSample(benchmark::State &state) {
+    auto depth = (size_t) state.range(0);
+    size_t number_of_variables = 16;
+    size_t width = 3;
+    std::mt19937_64 generator(benchmark_seed);
+    auto model = random_circuit(continuous_variables(number_of_variables), depth, width, generator);
+
+    std::vector<double> samples(number_of_variables * benchmark_rows);
+    for (auto _: state) {
+        model->sample(benchmark_rows, generator, samples.data());
+        benchmark::DoNotOptimize(samples.data());
+    }
+    state.SetItemsProcessed((int64_t) (state.iterations() * benchmark_rows));
+}
+
+BENCHMARK(BM_CircuitSample)->ArgName("depth")->DenseRange(1, 3)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * The random number generator used for sampling.
+ */
+typedef std::mt19937_64 RandomGenerator_t;
+
+/**
+ * Walker's alias table for drawing indices proportional to non-negative weights in constant time.
+ *
+ * Every bucket holds the probability of its own index and an alias index that takes the remaining probability of the
+ * bucket. A draw selects a bucket uniformly and then either the bucket or its alias.
+ */
+struct AliasTable {
+
+    /**
+     * The probability that a draw in a bucket returns the index of the bucket instead of its alias.
+     */
+    std::vector<double> acceptance_probabilities;
+
+    /**
+     * The index that a draw in a bucket returns if it does not accept the bucket.
+     */
+    std::vector<uint32_t> aliases;
+
+    /**
+     * Construct the table with Vose's algorithm in linear time.
+     * @param weights The non-negative weights. They do not need to be normalized but must not all be 0.
+     */
+    explicit AliasTable(const std::vector<double> &weights);
+
+    size_t size() const {
+        return aliases.size();
+    }
+
+    /**
+     * Draw an index with a probability proportional to its weight.
+     *
+     * The integer part of one uniform number selects the bucket and the fractional part decides between the bucket
+     * and its alias.
+     * @param generator The random number generator.
+     * @return The index.
+     */
+    size_t draw(RandomGenerator_t &generator) const {
+        auto uniform = (double) (generator() >> 11) * 0x1.0p-53 * (double) size();
+        auto bucket = std::min((size_t) uniform, size() - 1);
+        return uniform - (double) bucket < acceptance_probabilities[bucket] ? bucket : aliases[bucket];
+    }
+
+};
+
+typedef std::shared_ptr<const AliasTable> AliasTablePtr_t;
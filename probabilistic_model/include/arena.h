@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+
+/**
+ * Class for a monotonic arena that hands out memory from large blocks and frees all of it at once when it is
+ * destroyed.
+ *
+ * Objects created with make_shared_in keep the arena alive through their control block, hence the memory of a
+ * model is released once the last of its objects is gone. Allocation is thread-safe.
+ */
+class Arena {
+public:
+
+    /**
+     * @param initial_size The size in bytes of the first block. Every further block is larger than the previous one.
+     */
+    explicit Arena(size_t initial_size = 1 << 16) : resource(initial_size) {}
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * Allocate memory that stays valid until the arena is destroyed.
+     * @param bytes The number of bytes.
+     * @param alignment The alignment.
+     * @return The pointer to the memory.
+     */
+    void *allocate(size_t bytes, size_t alignment) {
+        std::lock_guard<std::mutex> lock(mutex);
+        number_of_allocations_++;
+        bytes_allocated_ += bytes;
+        return resource.allocate(bytes, alignment);
+    }
+
+    /**
+     * @return The number of allocations served by this arena.
+     */
+    size_t number_of_allocations() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return number_of_allocations_;
+    }
+
+    /**
+     * @return The number of bytes handed out by this arena.
+     */
+    size_t bytes_allocated() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytes_allocated_;
+    }
+
+private:
+
+    mutable std::mutex mutex;
+    std::pmr::monotonic_buffer_resource resource;
+    size_t number_of_allocations_ = 0;
+    size_t bytes_allocated_ = 0;
+
+};
+
+typedef std::shared_ptr<Arena> ArenaPtr_t;
+
+
+/**
+ * Allocator that takes memory from an arena and never returns it.
+ * @tparam T The type of the allocated objects.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaPtr_t arena;
+
+    explicit ArenaAllocator(ArenaPtr_t arena) : arena(std::move(arena)) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const {
+        return arena != other.arena;
+    }
+};
+
+
+/**
+ * Create an object and its control block in an arena, or on the heap if no arena is given.
+ * @tparam T The type of the object.
+ * @param arena The arena, may be nullptr.
+ * @param args The arguments of the constructor.
+ * @return The shared pointer to the object.
+ */
+template<typename T, typename... Args>
+std::shared_ptr<T> make_shared_in(const ArenaPtr_t &arena, Args &&... args) {
+    if (!arena) {
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
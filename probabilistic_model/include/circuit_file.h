@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiled_circuit.h"
+
+//FORWARD DECLARATIONS
+class MappedCircuit;
+
+typedef std::shared_ptr<MappedCircuit> MappedCircuitPtr_t;
+
+/**
+ * The header of a binary circuit file.
+ *
+ * A circuit file is a snapshot of the evaluation tape of a CompiledCircuit and only supports the computation of
+ * likelihoods. It does not store the graph of the source circuit, hence there is no loader back to a
+ * ProbabilisticCircuit and the mapped circuit cannot be marginalized, conditioned, sampled, maximized or refitted.
+ * In particular:
+ *
+ * - Deterministic sum units and Nyga distributions are stored as plain sums and lose their type.
+ * - Circuits with uniform distributions whose support consists of multiple intervals, discrete distributions whose
+ *   codes are too sparse for a dense representation or leaves of other types cannot be compiled, hence not saved.
+ *
+ * The header is followed by the variable table and the arrays of the tape. Every section starts at an offset that
+ * is a multiple of 8 bytes, hence the arrays can be used in place once the file is mapped into memory.
+ * Numbers are stored in the byte order of the machine that wrote the file.
+ *
+ * The variable table holds one record per variable: the kind (0 continuous, 1 integer, 2 symbolic) as uint32, the
+ * length of the name as uint32 and the name. Symbolic variables append the number of their elements as uint32 and the
+ * length and name of every element in the same way.
+ */
+struct CircuitFileHeader {
+
+    static constexpr char expected_magic[8] = {'P', 'M', 'C', 'I', 'R', 'C', 'U', 'I'};
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t expected_byte_order_mark = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+
+    uint64_t number_of_nodes;
+    uint64_t number_of_variables;
+    uint64_t number_of_edges;
+    uint64_t number_of_parameters;
+
+    uint64_t variables_offset;
+    uint64_t variables_size;
+    uint64_t kinds_offset;
+    uint64_t children_begin_offset;
+    uint64_t children_offset;
+    uint64_t edge_log_weights_offset;
+    uint64_t variable_indices_offset;
+    uint64_t parameters_begin_offset;
+    uint64_t parameters_offset;
+
+    /**
+     * The size of the file in bytes.
+     */
+    uint64_t file_size;
+
+};
+
+
+/**
+ * Class for a compiled circuit that is evaluated directly from a memory mapped circuit file.
+ *
+ * Like the file it only computes likelihoods, see CircuitFileHeader for what is not preserved.
+ *
+ * Opening the file maps it read-only and reads the variable table, no node is copied to the heap. The mapping is
+ * released when the object is destroyed.
+ */
+class MappedCircuit : public ProbabilisticModel {
+public:
+
+    /**
+     * The variables of the circuit. The order defines the order of the columns.
+     */
+    std::vector<AbstractVariablePtr_t> variables;
+
+    /**
+     * Map a circuit file.
+     * @throws std::runtime_error if the file cannot be mapped, is truncated or was written with another version or
+     * byte order.
+     * @param path The path of the file written by CompiledCircuit::save.
+     */
+    explicit MappedCircuit(const std::string &path);
+
+    MappedCircuit(const MappedCircuit &) = delete;
+
+    MappedCircuit &operator=(const MappedCircuit &) = delete;
+
+    ~MappedCircuit();
+
+    /**
+     * @return The view of the mapped arrays.
+     */
+    const CircuitTape &tape() const {
+        return circuit_tape;
+    }
+
+    size_t number_of_nodes() const {
+        return circuit_tape.number_of_nodes;
+    }
+
+    AbstractVariableSetPtr_t get_variables() const override {
+        return make_shared_variable_set(variables.begin(), variables.end());
+    }
+
+    double log_likelihood(const FullEvidencePtr_t &event) const override;
+
+    void log_likelihood_batch(const double *data, size_t n_rows, double *out) const override;
+
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override;
+
+    template<typename... Args>
+    static MappedCircuitPtr_t make_shared(Args &&... args) {
+        return std::make_shared<MappedCircuit>(std::forward<Args>(args)...);
+    };
+
+private:
+
+    void *address = nullptr;
+    size_t size = 0;
+    CircuitTape circuit_tape;
+
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "probabilistic_model.h"
+#include "probabilistic_circuit.h"
+
+//FORWARD DECLARATIONS
+class CompiledCircuit;
+
+typedef std::shared_ptr<CompiledCircuit> CompiledCircuitPtr_t;
+
+/**
+ * The kinds of nodes that can appear in a compiled circuit.
+ */
+enum class NodeKind : uint8_t {
+    SUM = 0,
+    PRODUCT = 1,
+    UNIFORM = 2,
+    DIRAC_DELTA = 3,
+    DISCRETE = 4,
+};
+
+/**
+ * Non-owning view of the flat arrays that describe a compiled circuit.
+ *
+ * The nodes are in topological order, every child appears before its parents and the root is the last node.
+ * The parameters of the leaves are stored in one contiguous array:
+ *
+ * - UNIFORM: lower, upper, log density, 1 if the lower border is closed, 1 if the upper border is closed.
+ * - DIRAC_DELTA: location, log density cap.
+ * - DISCRETE: the smallest code followed by the log-probabilities of all codes up to the largest one. Only discrete
+ *   distributions with a dense representation are compiled.
+ *
+ * The weights, parameters, columns and results are of type Scalar, which is double or float.
+ */
+template<typename Scalar>
+struct BasicCircuitTape {
+
+    typedef std::vector<const Scalar *> Columns;
+
+    size_t number_of_nodes = 0;
+    size_t number_of_variables = 0;
+
+    /**
+     * The kind of every node.
+     */
+    const NodeKind *kinds = nullptr;
+
+    /**
+     * The offsets of the first child of every node into `children` with one extra element at the end.
+     */
+    const uint32_t *children_begin = nullptr;
+
+    /**
+     * The node indices of the children.
+     */
+    const uint32_t *children = nullptr;
+
+    /**
+     * The logarithmic weight of every edge. Edges of product nodes have a weight of 0.
+     */
+    const Scalar *edge_log_weights = nullptr;
+
+    /**
+     * The column a leaf reads from. Undefined for inner nodes.
+     */
+    const uint32_t *variable_indices = nullptr;
+
+    /**
+     * The offsets of the first parameter of every node into `parameters` with one extra element at the end.
+     */
+    const uint32_t *parameters_begin = nullptr;
+
+    /**
+     * The parameters of the leaves.
+     */
+    const Scalar *parameters = nullptr;
+
+    /**
+     * @param n_rows The number of rows in a block.
+     * @return The number of scalars the scratch buffer for a block of `n_rows` has to hold.
+     */
+    size_t scratch_size(size_t n_rows) const {
+        return (number_of_nodes + 1) * n_rows;
+    }
+
+    /**
+     * Evaluate every node for a block of rows in one linear sweep over the tape.
+     *
+     * Afterwards the log-likelihoods of node i are in `scratch[i * n_rows, (i + 1) * n_rows)`.
+     * @param columns The pointers to the columns, ordered like the variables of the circuit.
+     * @param n_rows The number of rows.
+     * @param scratch The buffer of size `scratch_size(n_rows)`.
+     */
+    void evaluate(const Columns &columns, size_t n_rows, Scalar *scratch) const;
+
+    /**
+     * The log-likelihood of a block of rows.
+     * @param columns The pointers to the columns, ordered like the variables of the circuit.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     * @param scratch The buffer of size `scratch_size(n_rows)`.
+     */
+    void log_likelihood_of_columns(const Columns &columns, size_t n_rows, Scalar *out, Scalar *scratch) const;
+
+    /**
+     * The log-likelihood of a batch of rows in blocks of ProbabilisticModel::batch_block_size.
+     *
+     * The scratch buffer is allocated once and reused by every block.
+     * @param data The column-major data, see ProbabilisticModel::log_likelihood_batch.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    void log_likelihood_batch(const Scalar *data, size_t n_rows, Scalar *out) const;
+
+};
+
+typedef BasicCircuitTape<double> CircuitTape;
+
+/**
+ * The tape of a circuit in single precision, see SinglePrecisionCircuit.
+ */
+typedef BasicCircuitTape<float> FloatCircuitTape;
+
+typedef FloatCircuitTape::Columns FloatColumnPointers;
+
+/**
+ * Class for a probabilistic circuit that is flattened into contiguous arrays.
+ *
+ * Compiling a circuit visits every distinct node once, hence sub-circuits that are shared by multiple parents are
+ * shared in the compiled circuit as well and evaluated only once.
+ * The compiled circuit is a snapshot, changes to the source circuit are not reflected.
+ */
+class CompiledCircuit : public ProbabilisticModel {
+public:
+
+    /**
+     * The variables of the circuit. The order defines the order of the columns.
+     */
+    std::vector<AbstractVariablePtr_t> variables;
+
+    std::vector<NodeKind> kinds;
+    std::vector<uint32_t> children_begin;
+    std::vector<uint32_t> children;
+    std::vector<double> edge_log_weights;
+    std::vector<uint32_t> variable_indices;
+    std::vector<uint32_t> parameters_begin;
+    std::vector<double> parameters;
+
+    /**
+     * Compile a circuit.
+     *
+     * @throws std::invalid_argument if the circuit contains nodes that cannot be compiled, discrete distributions whose
+     * codes are too sparse for a dense representation or more than 2^32 edges or parameters.
+     * @param circuit The root of the circuit.
+     */
+    explicit CompiledCircuit(const ProbabilisticCircuitPtr_t &circuit);
+
+    /**
+     * @return The view of the arrays of this circuit.
+     */
+    CircuitTape tape() const;
+
+    /**
+     * Write this circuit to a binary file that can be mapped by MappedCircuit.
+     *
+     * The file only stores the tape for the computation of likelihoods, see CircuitFileHeader.
+     * @throws std::runtime_error if the file cannot be written.
+     * @param path The path of the file.
+     */
+    void save(const std::string &path) const;
+
+    size_t number_of_nodes() const {
+        return kinds.size();
+    }
+
+    AbstractVariableSetPtr_t get_variables() const override {
+        return make_shared_variable_set(variables.begin(), variables.end());
+    }
+
+    double log_likelihood(const FullEvidencePtr_t &event) const override;
+
+    void log_likelihood_batch(const double *data, size_t n_rows, double *out) const override;
+
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override;
+
+    template<typename... Args>
+    static CompiledCircuitPtr_t make_shared(Args &&... args) {
+        return std::make_shared<CompiledCircuit>(std::forward<Args>(args)...);
+    };
+
+private:
+
+    /**
+     * Append a node and its parameters to the arrays.
+     * @param node The node.
+     * @param child_indices The indices of the already compiled children of the node.
+     */
+    void append_node(const ProbabilisticCircuit &node, const std::vector<uint32_t> &child_indices);
+
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * Sorted unique values and the accumulated weight of every value.
+ */
+struct FrequencyTable {
+
+    /**
+     * The values in strictly ascending order.
+     */
+    std::vector<double> values;
+
+    /**
+     * The weight of every value, e.g. the number of times it occurred.
+     */
+    std::vector<double> weights;
+
+    size_t size() const {
+        return values.size();
+    }
+
+    /**
+     * @return The number of bytes occupied by the entries of this table.
+     */
+    size_t bytes() const {
+        return values.size() * 2 * sizeof(double);
+    }
+
+    /**
+     * Append an entry or add its weight to the last entry if the value is equal to the last value.
+     *
+     * The value must not be smaller than the last value of the table.
+     * @param value The value.
+     * @param weight The weight.
+     */
+    void append(double value, double weight) {
+        if (!values.empty() && values.back() == value) {
+            weights.back() += weight;
+            return;
+        }
+        values.push_back(value);
+        weights.push_back(weight);
+    }
+
+    /**
+     * The number of samples from which on from_samples sorts with radix_sort instead of std::sort.
+     */
+    static constexpr size_t radix_sort_threshold = 1 << 16;
+
+    /**
+     * Create a frequency table by sorting samples and counting runs of equal values.
+     * @param samples The samples. They are sorted in place.
+     * @return The table that counts every sample with weight 1.
+     */
+    static FrequencyTable from_samples(std::vector<double> &samples);
+
+    /**
+     * Merge two tables in one linear sweep, adding the weights of values that occur in both.
+     * @param left The first table.
+     * @param right The second table.
+     * @return The merged table.
+     */
+    static FrequencyTable merge(const FrequencyTable &left, const FrequencyTable &right);
+
+};
+
+
+/**
+ * Sort doubles with a least significant digit radix sort over their IEEE 754 bit patterns.
+ *
+ * The bit patterns are mapped to unsigned keys whose order equals the order of the values by flipping the sign bit of
+ * non-negative values and all bits of negative values. The keys are sorted in passes of 11 bits, passes in which all
+ * keys share the same digit are skipped. Negative zero is sorted before positive zero, NaNs are sorted to the ends.
+ * @param values The values to sort in place.
+ */
+void radix_sort(std::vector<double> &values);
+
+
+/**
+ * Class for aggregating a stream of samples into a frequency table with bounded memory.
+ *
+ * Every chunk is sorted and counted into a table. The in-memory tables are merged geometrically, a new table is merged
+ * with the previous one as long as it is at least half as large, hence streaming n samples in small chunks costs
+ * O(n log n) instead of copying the whole table for every chunk. If the in-memory tables exceed the memory budget they
+ * are merged, written to an anonymous temporary file as a sorted run and cleared. `finish` merges all runs externally.
+ * The final table holds every unique value once and therefore has to fit into memory.
+ */
+class ExternalFrequencyAggregator {
+public:
+
+    /**
+     * The number of bytes the in-memory tables may occupy before they are spilled to disk.
+     */
+    const size_t memory_budget;
+
+    explicit ExternalFrequencyAggregator(size_t memory_budget) : memory_budget(memory_budget) {}
+
+    ExternalFrequencyAggregator(const ExternalFrequencyAggregator &) = delete;
+
+    ExternalFrequencyAggregator &operator=(const ExternalFrequencyAggregator &) = delete;
+
+    /**
+     * Close and thereby delete all temporary files.
+     */
+    ~ExternalFrequencyAggregator();
+
+    /**
+     * Aggregate a chunk of samples.
+     * @param chunk The samples. They are sorted in place.
+     */
+    void add_chunk(std::vector<double> &chunk);
+
+    /**
+     * @return The number of sorted runs that were spilled to disk so far.
+     */
+    size_t number_of_runs() const {
+        return runs.size();
+    }
+
+    /**
+     * Merge the in-memory tables and all spilled runs.
+     *
+     * The aggregator is empty afterwards.
+     * @return The frequency table of all samples.
+     */
+    FrequencyTable finish();
+
+private:
+
+    /**
+     * The in-memory tables that are not merged yet, ordered by decreasing size.
+     */
+    std::vector<FrequencyTable> tables;
+
+    std::vector<std::FILE *> runs;
+
+    /**
+     * Merge and remove all in-memory tables.
+     * @return The merged table.
+     */
+    FrequencyTable merge_tables();
+
+    void spill();
+
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include "nyga_distribution.h"
+#include "probabilistic_circuit.h"
+#include "univariate.h"
+
+//FORWARD DECLARATIONS
+class JointProbabilityTree;
+
+// TYPEDEFS
+typedef std::shared_ptr<JointProbabilityTree> JointProbabilityTreePtr_t;
+
+
+/**
+ * Class for joint probability trees, multivariate distributions that are learned by recursively partitioning the
+ * data.
+ *
+ * Every partition is split at the value of one variable that reduces the impurity of all variables the most. The
+ * impurity of continuous and integer variables is their variance, the impurity of symbolic variables is their Gini
+ * impurity, both relative to the impurity of the entire data, such that every variable contributes equally. Continuous
+ * and integer variables are split at a threshold, symbolic variables into one symbol and all others.
+ *
+ * The leaves are decomposable products of one distribution per variable, a Nyga Distribution for continuous variables
+ * and a discrete distribution of the relative frequencies for integer and symbolic variables. The partitions are
+ * disjoint, hence the tree is a deterministic sum of the leaves weighted by their share of the data.
+ */
+class JointProbabilityTree : public DeterministicSumUnit {
+public:
+
+    /**
+     * The variables of the data, in the order of its columns.
+     */
+    AbstractVariableSetPtr_t variables;
+
+    /**
+     * The minimal number of rows of every leaf.
+     */
+    size_t min_samples_per_leaf;
+
+    /**
+     * The minimal decrease of the mean relative impurity of the variables that justifies a split.
+     */
+    double min_impurity_improvement;
+
+    /**
+     * The maximal depth of the tree, the root partition has depth 0.
+     */
+    size_t max_depth = std::numeric_limits<size_t>::max();
+
+    /**
+     * The parameters of the Nyga Distributions of continuous variables.
+     */
+    size_t min_samples_per_quantile = 1;
+    double min_likelihood_improvement = 0.1;
+
+    /**
+     * The number of threads used for learning. If greater than 1, the variables are sorted, the partitions are split
+     * and the leaf distributions are fitted on a work-stealing thread pool.
+     */
+    size_t number_of_threads = 1;
+
+    /**
+     * The minimal number of rows of a partition from which on the best split of every variable is searched for by
+     * its own task. The splits of smaller partitions are searched for by one task.
+     */
+    size_t min_samples_per_parallel_task = 4096;
+
+    explicit JointProbabilityTree(const AbstractVariableSetPtr_t &variables, size_t min_samples_per_leaf = 1,
+                                  double min_impurity_improvement = 0.1) :
+            variables(variables), min_samples_per_leaf(min_samples_per_leaf),
+            min_impurity_improvement(min_impurity_improvement) {}
+
+    template<typename... Args>
+    static JointProbabilityTreePtr_t make_shared(Args &&... args) {
+        return std::make_shared<JointProbabilityTree>(std::forward<Args>(args)...);
+    };
+
+    /**
+     * Fit a new joint probability tree with the parameters of this one.
+     *
+     * The rows are sorted by every variable once. The sorted row indices are shared by all partitions, every
+     * partition is a range in each of them, and a split reorders the range of the partition in place such that
+     * the subranges of both children stay sorted. Hence the leaf distributions are fitted from sorted data without
+     * copying or sorting it again.
+     *
+     * Values of symbolic variables are the indices of their elements and values of integer variables are integers,
+     * both stored as doubles.
+     *
+     * @throws std::invalid_argument if there are no rows or variables, if a variable is neither continuous, integer
+     * nor symbolic, if a value is NaN or if a symbolic value is not the index of an element of its variable.
+     * @param data The column-major data. The columns are ordered like `variables`, hence the value of the j-th
+     * variable in row i is `data[j * n_rows + i]`.
+     * @param n_rows The number of rows.
+     * @return The fitted tree.
+     */
+    JointProbabilityTreePtr_t fit(const double *data, size_t n_rows) const;
+
+};
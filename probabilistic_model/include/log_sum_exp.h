@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+/**
+ * The exponential function written without branches and library calls such that compilers can vectorize loops that
+ * call it. GCC only if-converts the selects below if floating point traps are disabled, hence the library is built
+ * with -fno-trapping-math (see .bazelrc); loops are vectorized at -O3.
+ *
+ * The argument is reduced to `x = n * ln(2) + r` with `|r| <= ln(2) / 2`, exp(r) is approximated by its Taylor
+ * polynomial of degree 13 and the result is scaled by 2^n through the exponent bits. The relative error is below
+ * 1e-15 for arguments that do not underflow. Arguments below -708 (including -inf) are flushed to 0, which is exact
+ * enough for sums that are shifted by their maximum.
+ * @param x The argument. Must not be greater than 709.
+ * @return exp(x)
+ */
+inline double vectorizable_exp(double x) {
+    const double log2e = 1.4426950408889634;
+    const double ln2_high = 6.93147180369123816490e-01;
+    const double ln2_low = 1.90821492927058770002e-10;
+    const double shift = 6755399441055744.0; // 1.5 * 2^52, rounds to the nearest integer when added
+    const double min_argument = -708.;
+
+    bool underflows = !(x >= min_argument);
+    x = underflows ? min_argument : x;
+
+    // n = round(x / ln(2)), the integer n ends up in the low bits of shifted
+    double shifted = x * log2e + shift;
+    double n = shifted - shift;
+    double r = (x - n * ln2_high) - n * ln2_low;
+
+    double polynomial = 1. / 6227020800.;
+    polynomial = polynomial * r + 1. / 479001600.;
+    polynomial = polynomial * r + 1. / 39916800.;
+    polynomial = polynomial * r + 1. / 3628800.;
+    polynomial = polynomial * r + 1. / 362880.;
+    polynomial = polynomial * r + 1. / 40320.;
+    polynomial = polynomial * r + 1. / 5040.;
+    polynomial = polynomial * r + 1. / 720.;
+    polynomial = polynomial * r + 1. / 120.;
+    polynomial = polynomial * r + 1. / 24.;
+    polynomial = polynomial * r + 1. / 6.;
+    polynomial = polynomial * r + 0.5;
+    polynomial = polynomial * r + 1.;
+    polynomial = polynomial * r + 1.;
+
+    // 2^n from the exponent bits
+    uint64_t shifted_bits;
+    std::memcpy(&shifted_bits, &shifted, sizeof(double));
+    uint64_t scale_bits = (shifted_bits + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &scale_bits, sizeof(double));
+
+    return underflows ? 0. : polynomial * scale;
+}
+
+/**
+ * The single precision counterpart of vectorizable_exp(double) with the same argument reduction, a Taylor polynomial
+ * of degree 7 and a relative error below 2e-7. Arguments below -87 (including -inf) are flushed to 0.
+ * @param x The argument. Must not be greater than 88.
+ * @return exp(x)
+ */
+inline float vectorizable_exp(float x) {
+    const float log2e = 1.44269504f;
+    const float ln2_high = 0.693359375f;
+    const float ln2_low = -2.12194440e-4f;
+    const float shift = 12582912.f; // 1.5 * 2^23, rounds to the nearest integer when added
+    const float min_argument = -87.f;
+
+    bool underflows = !(x >= min_argument);
+    x = underflows ? min_argument : x;
+
+    // n = round(x / ln(2)), the integer n ends up in the low bits of shifted
+    float shifted = x * log2e + shift;
+    float n = shifted - shift;
+    float r = (x - n * ln2_high) - n * ln2_low;
+
+    float polynomial = 1.f / 5040.f;
+    polynomial = polynomial * r + 1.f / 720.f;
+    polynomial = polynomial * r + 1.f / 120.f;
+    polynomial = polynomial * r + 1.f / 24.f;
+    polynomial = polynomial * r + 1.f / 6.f;
+    polynomial = polynomial * r + 0.5f;
+    polynomial = polynomial * r + 1.f;
+    polynomial = polynomial * r + 1.f;
+
+    // 2^n from the exponent bits
+    uint32_t shifted_bits;
+    std::memcpy(&shifted_bits, &shifted, sizeof(float));
+    uint32_t scale_bits = (shifted_bits + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scale_bits, sizeof(float));
+
+    return underflows ? 0.f : polynomial * scale;
+}
+
+/**
+ * Calculate log(sum(exp(values))) without underflow by shifting the values by their maximum.
+ * @param values The pointer to the values.
+ * @param size The number of values.
+ * @return The logarithm of the sum of the exponentials, -inf if all values are -inf or there are no values.
+ */
+inline double log_sum_exp(const double *values, size_t size) {
+    double maximum = -std::numeric_limits<double>::infinity();
+    for (size_t index = 0; index < size; index++) {
+        maximum = std::max(maximum, values[index]);
+    }
+    if (std::isinf(maximum)) {
+        return maximum;
+    }
+    double sum = 0;
+    for (size_t index = 0; index < size; index++) {
+        sum += vectorizable_exp(values[index] - maximum);
+    }
+    return maximum + log(sum);
+}
+
+/**
+ * Calculate the weighted log-sum-exp for a block of rows, reducing across the children of a sum.
+ *
+ * For every row i this computes `out[i] = log(sum_j exp(log_weights[j] + child_values[j][i]))`, which is infinite if
+ * the maximal weighted value is infinite.
+ * @param child_values The pointers to the log-likelihoods of every child.
+ * @param log_weights The logarithmic weights of the children.
+ * @param number_of_children The number of children.
+ * @param n_rows The number of rows.
+ * @param out The array of size n_rows to write the results to.
+ * @param accumulator A buffer of size n_rows.
+ */
+inline void weighted_log_sum_exp(const double *const *child_values, const double *log_weights,
+                                 size_t number_of_children, size_t n_rows, double *out, double *accumulator) {
+    const auto minus_infinity = -std::numeric_limits<double>::infinity();
+
+    std::fill(out, out + n_rows, minus_infinity);
+    for (size_t child = 0; child < number_of_children; child++) {
+        auto values = child_values[child];
+        auto log_weight = log_weights[child];
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = std::max(out[row], values[row] + log_weight);
+        }
+    }
+
+    std::fill(accumulator, accumulator + n_rows, 0.);
+    for (size_t child = 0; child < number_of_children; child++) {
+        auto values = child_values[child];
+        auto log_weight = log_weights[child];
+        for (size_t row = 0; row < n_rows; row++) {
+            // rows whose maximum is -inf produce nan here, which vectorizable_exp flushes to 0
+            accumulator[row] += vectorizable_exp(values[row] + log_weight - out[row]);
+        }
+    }
+
+    // rows whose maximum is infinite keep it, like log_sum_exp, since inf - inf is flushed to 0 above
+    for (size_t row = 0; row < n_rows; row++) {
+        out[row] = std::isinf(out[row]) ? out[row] : out[row] + log(accumulator[row]);
+    }
+}
+
+/**
+ * Calculate the weighted log-sum-exp for a block of rows of children that are stored one after another.
+ *
+ * For every row i this computes `out[i] = log(sum_j exp(log_weights[j] + values[j * n_rows + i]))`.
+ * @param values The child-major log-likelihoods of the children.
+ * @param log_weights The logarithmic weights of the children.
+ * @param number_of_children The number of children.
+ * @param n_rows The number of rows.
+ * @param out The array of size n_rows to write the results to.
+ * @param accumulator A buffer of size n_rows.
+ */
+inline void weighted_log_sum_exp(const double *values, const double *log_weights, size_t number_of_children,
+                                 size_t n_rows, double *out, double *accumulator) {
+    std::vector<const double *> child_values(number_of_children);
+    for (size_t child = 0; child < number_of_children; child++) {
+        child_values[child] = values + child * n_rows;
+    }
+    weighted_log_sum_exp(child_values.data(), log_weights, number_of_children, n_rows, out, accumulator);
+}
@@ -6,9 +6,15 @@
 #include "univariate.h"
 #include "probabilistic_circuit.h"
 #include "random_events/include/variable.h"
+#include "thread_pool.h"
+#include "frequency_table.h"
+#include "arena.h"
 #include <optional>
 #include <map>
-#include <queue>
+#include <stack>
+#include <mutex>
+#include <functional>
+#include <algorithm>
 
 //FORWARD DECLARATIONS
 class NygaDistribution;
@@ -21,10 +27,53 @@ typedef WeightsVector *WeightsVectorPtr_t;
 typedef std::vector<double> DataVector;
 typedef DataVector *DataVectorPtr_t;
 
+/**
+ * A function that writes the next chunk of samples into its argument and returns false if there are no more chunks.
+ */
+typedef std::function<bool(DataVector &)> ChunkSource_t;
+
 typedef std::shared_ptr<NygaDistribution> NygaDistributionPtr_t;
 typedef std::shared_ptr<InductionStep> InductionStepPtr_t;
 
 
+/**
+ * The supports of the quantiles of a Nyga Distribution, sorted by their lower bounds, and the cumulative probability
+ * mass in front of every quantile.
+ *
+ * Quantiles are uniform distributions over disjoint intervals or Dirac delta distributions, which are stored as
+ * intervals of width 0.
+ */
+struct CumulativeMassTable {
+
+    /**
+     * The number of subcircuits of the distribution when the table was built.
+     */
+    size_t number_of_sub_circuits = 0;
+
+    std::vector<double> lowers;
+    std::vector<double> uppers;
+
+    /**
+     * The element at index i is the normalized probability mass of the first i quantiles, hence the vector has one
+     * element more than there are quantiles and ends with 1.
+     */
+    std::vector<double> cumulative_masses;
+
+    /**
+     * Calculate P(x <= value) or P(x < value).
+     * @param value The value.
+     * @param inclusive Whether the value itself is included.
+     * @param first_quantile The index of the first quantile that may contain the value. Queries with ascending
+     * values can start where the previous one ended.
+     * @return The probability and the index of the quantile the search ended at.
+     */
+    std::pair<double, size_t> cumulative_mass(double value, bool inclusive, size_t first_quantile = 0) const;
+
+};
+
+typedef std::shared_ptr<const CumulativeMassTable> CumulativeMassTablePtr_t;
+
+
 class NygaDistribution : public DeterministicSumUnit {
 public:
 
@@ -32,6 +81,29 @@ public:
     size_t min_samples_per_quantile;
     ContinuousPtr_t variable;
 
+    /**
+     * The number of threads used for the induction. If greater than 1, independent induction steps are processed on
+     * a work-stealing thread pool.
+     */
+    size_t number_of_threads = 1;
+
+    /**
+     * The minimal number of unique datapoints an induction step must cover to be handed to another thread during
+     * parallel induction. Smaller steps are processed by the thread that created them.
+     */
+    size_t min_samples_per_parallel_task = 4096;
+
+    /**
+     * Whether fitting allocates the resulting distribution, its quantiles and the induction steps in one arena that
+     * is freed at once with the distribution, instead of one heap allocation per object.
+     */
+    bool allocate_in_arena = false;
+
+    /**
+     * The arena this distribution and its quantiles were allocated in, nullptr if they are on the heap.
+     */
+    ArenaPtr_t arena;
+
     explicit NygaDistribution(const ContinuousPtr_t &variable, size_t min_samples_per_quantile = 1,
                               double min_likelihood_improvement = 0.1);
 
@@ -48,10 +120,169 @@ public:
         return std::make_shared<NygaDistribution>(std::forward<Args>(args)...);
     };
 
+    /**
+     * Fit a new Nyga Distribution with the parameters of this one from samples.
+     *
+     * The samples are sorted in place and counted in one run-length pass.
+     * @param data_p The samples.
+     * @return The fitted distribution.
+     */
     NygaDistributionPtr_t fit(const DataVectorPtr_t &data_p);
 
+    /**
+     * Fit a new Nyga Distribution from pre-aggregated data, e.g. a histogram of (value, count) pairs.
+     *
+     * If the values are already sorted and unique they are used as they are, otherwise they are sorted and equal
+     * values are merged. Values with a weight of 0 are dropped.
+     * @throws std::invalid_argument if the vectors differ in size or a weight is negative.
+     * @param values The values.
+     * @param weights The non-negative weight of every value.
+     * @return The fitted distribution.
+     */
+    NygaDistributionPtr_t fit_weighted(const DataVector &values, const WeightsVector &weights);
+
+    /**
+     * Fit a new Nyga Distribution with the parameters of this one from sorted unique values and their weights.
+     * @param table The frequency table.
+     * @return The fitted distribution.
+     */
+    NygaDistributionPtr_t fit_frequency_table(const FrequencyTable &table);
+
+    /**
+     * Fit a new Nyga Distribution from a stream of chunks.
+     *
+     * The chunks are aggregated into a frequency table that is spilled to temporary files and merged externally
+     * if it exceeds the memory budget, hence the samples never have to be in memory at once. Only the unique values
+     * have to fit into memory.
+     * @param next_chunk The source of the chunks.
+     * @param memory_budget The number of bytes the in-memory frequency table may occupy before it is spilled.
+     * @return The fitted distribution.
+     */
+    NygaDistributionPtr_t fit_streaming(const ChunkSource_t &next_chunk, size_t memory_budget = 1ul << 30);
+
+    /**
+     * Fit a new Nyga Distribution from a range of chunks, e.g. a vector of DataVectors.
+     * @param first_chunk The iterator to the first chunk.
+     * @param last_chunk The iterator past the last chunk.
+     * @param memory_budget The number of bytes the in-memory frequency table may occupy before it is spilled.
+     * @return The fitted distribution.
+     */
+    template<typename ChunkIterator>
+    NygaDistributionPtr_t fit_streaming(ChunkIterator first_chunk, ChunkIterator last_chunk,
+                                        size_t memory_budget = 1ul << 30) {
+        return fit_streaming([&](DataVector &chunk) {
+            if (first_chunk == last_chunk) {
+                return false;
+            }
+            chunk.assign(std::begin(*first_chunk), std::end(*first_chunk));
+            first_chunk++;
+            return true;
+        }, memory_budget);
+    }
+
+    /**
+     * Perform the induction starting from an initial step.
+     *
+     * The steps are processed depth first, hence the quantile distributions are mounted in ascending order of their
+     * support. If `number_of_threads` is greater than 1, the induction runs in parallel and the quantiles are mounted
+     * after all steps finished, in the same order as in the sequential case.
+     * @param initial_induction_step The step covering all data.
+     * @return The Nyga Distribution of the initial step.
+     */
     NygaDistributionPtr_t fit_with_initial_induction_step(const InductionStepPtr_t &initial_induction_step);
 
+    /**
+     * Perform the induction starting from an initial step on a work-stealing thread pool.
+     * @param initial_induction_step The step covering all data.
+     * @return The Nyga Distribution of the initial step.
+     */
+    NygaDistributionPtr_t fit_with_initial_induction_step_in_parallel(const InductionStepPtr_t &initial_induction_step);
+
+    /**
+     * Calculate the cumulative distribution function P(x <= value) in O(log k) for k quantiles.
+     * @param value The value.
+     * @return The probability.
+     */
+    double cdf(double value) const;
+
+    /**
+     * Calculate the cumulative distribution function for an array of values.
+     * @param values The values.
+     * @param n The number of values.
+     * @param out The array of size n to write the probabilities to.
+     */
+    void cdf(const double *values, size_t n, double *out) const;
+
+    /**
+     * Calculate the quantile function, the smallest value whose cumulative probability is at least `probability`.
+     * @throws std::invalid_argument if the probability is not in [0, 1].
+     * @param probability The probability.
+     * @return The value.
+     */
+    double quantile(double probability) const;
+
+    /**
+     * Calculate the quantile function for an array of probabilities.
+     * @throws std::invalid_argument if a probability is not in [0, 1].
+     * @param probabilities The probabilities.
+     * @param n The number of probabilities.
+     * @param out The array of size n to write the values to.
+     */
+    void quantile(const double *probabilities, size_t n, double *out) const;
+
+    /**
+     * Calculate the probability of an event of the variable of this distribution.
+     *
+     * The simple intervals of the event are sorted and disjoint, hence they are processed in one sweep in which
+     * every search starts at the quantile where the previous one ended.
+     * @param event The event.
+     * @return The probability.
+     */
+    double probability(const ContinuousSupportPtr_t &event) const;
+
+    using DeterministicSumUnit::probability;
+
+    /**
+     * Calculate the probabilities of the constraints on the variable with the cumulative mass table instead of
+     * visiting every quantile.
+     */
+    void probability_of_events(const std::vector<ProductEvent> &events, const ProbabilityMemo &memo,
+                               double *out) const override;
+
+    bool probability_uses_sub_circuits() const override {
+        return false;
+    }
+
+    /**
+     * Calculate P(lower <= x < upper) for arrays of bounds.
+     * @param lowers The lower bounds.
+     * @param uppers The upper bounds.
+     * @param n The number of intervals.
+     * @param out The array of size n to write the probabilities to.
+     */
+    void probability(const double *lowers, const double *uppers, size_t n, double *out) const;
+
+    /**
+     * Get the cumulative mass table of the quantiles.
+     *
+     * The table is built on first use and rebuilt when quantiles were added. Code that modifies the weights or the
+     * quantiles in place has to call reset_caches. Concurrent calls are safe, at worst the table is built more than
+     * once.
+     * @throws std::logic_error if the distribution has no quantiles or a quantile is neither a uniform distribution
+     * over one interval nor a Dirac delta distribution.
+     * @return The table.
+     */
+    CumulativeMassTablePtr_t cumulative_mass_table() const;
+
+    void reset_caches() override {
+        DeterministicSumUnit::reset_caches();
+        std::atomic_store(&cumulative_mass_table_cache, CumulativeMassTablePtr_t());
+    }
+
+private:
+
+    mutable CumulativeMassTablePtr_t cumulative_mass_table_cache;
+
 };
 
 
@@ -71,6 +302,19 @@ public:
      */
     const WeightsVectorPtr_t log_weights_p;
 
+    /**
+     * The prefix sums of the logarithmic weights.
+     *
+     * The element at index i is the sum of the first i logarithmic weights, hence the vector has one element more
+     * than the data. It is computed once per fit and shared by all induction steps derived from the initial one.
+     */
+    const std::shared_ptr<const WeightsVector> cumulative_log_weights_p;
+
+    /**
+     * The prefix sums of the weights themselves, used to calculate the probability mass of the quantiles.
+     */
+    const std::shared_ptr<const WeightsVector> cumulative_weights_p;
+
     /**
      * The index of the first element of the data vector that is included in this step.
      */
@@ -88,24 +332,56 @@ public:
 
 
     /**
-     * Construct an induction step and calculate the logarithm of the weights.
+     * Construct an induction step and calculate the prefix sums of the logarithmic weights and of the weights.
      * @param data_p The pointer to the data vector.
-     * @param weights_p The pointer to the weights vector.
+     * @param log_weights_p The pointer to the logarithmic weights vector.
      * @param begin_index The index of the first element of the data vector that is included in this step.
      * @param end_index The index of the first element of the data vector that is not included in this step.
-     * @param total_number_of_samples The total number of samples in the data vector before it was made unique.
      * @param nyga_distribution_p The pointer to the Nyga Distribution to mount the quantile distributions into and read the parameters from.
      */
     explicit InductionStep(const DataVectorPtr_t &data_p, const WeightsVectorPtr_t &log_weights_p, size_t begin_index,
                            size_t end_index,
-                           const NygaDistributionPtr_t &nyga_distribution_p) : data_p(data_p),
-                                                                               log_weights_p(log_weights_p),
-                                                                               begin_index(begin_index),
-                                                                               end_index(end_index),
-                                                                               nyga_distribution_p(
-                                                                                       nyga_distribution_p) {
+                           const NygaDistributionPtr_t &nyga_distribution_p) :
+            InductionStep(data_p, log_weights_p, cumulative_sums(*log_weights_p),
+                          cumulative_sums_of_exponentials(*log_weights_p), begin_index, end_index,
+                          nyga_distribution_p) {
+    }
+
+    /**
+     * Construct an induction step that reuses already computed prefix sums.
+     * @param data_p The pointer to the data vector.
+     * @param log_weights_p The pointer to the logarithmic weights vector.
+     * @param cumulative_log_weights_p The pointer to the prefix sums of the logarithmic weights.
+     * @param cumulative_weights_p The pointer to the prefix sums of the weights.
+     * @param begin_index The index of the first element of the data vector that is included in this step.
+     * @param end_index The index of the first element of the data vector that is not included in this step.
+     * @param nyga_distribution_p The pointer to the Nyga Distribution to mount the quantile distributions into and read the parameters from.
+     */
+    InductionStep(const DataVectorPtr_t &data_p, const WeightsVectorPtr_t &log_weights_p,
+                  const std::shared_ptr<const WeightsVector> &cumulative_log_weights_p,
+                  const std::shared_ptr<const WeightsVector> &cumulative_weights_p, size_t begin_index,
+                  size_t end_index, const NygaDistributionPtr_t &nyga_distribution_p) :
+            data_p(data_p), log_weights_p(log_weights_p), cumulative_log_weights_p(cumulative_log_weights_p),
+            cumulative_weights_p(cumulative_weights_p), begin_index(begin_index), end_index(end_index),
+            nyga_distribution_p(nyga_distribution_p) {
     }
 
+    /**
+     * Calculate the prefix sums of a weights vector.
+     * @param weights The weights.
+     * @return The pointer to a vector of size `weights.size() + 1` where the element at index i is the sum of the
+     * first i weights.
+     */
+    static std::shared_ptr<const WeightsVector> cumulative_sums(const WeightsVector &weights);
+
+    /**
+     * Calculate the prefix sums of the exponentials of a logarithmic weights vector.
+     * @param log_weights The logarithmic weights.
+     * @return The pointer to a vector of size `log_weights.size() + 1` where the element at index i is the sum of the
+     * exponentials of the first i logarithmic weights.
+     */
+    static std::shared_ptr<const WeightsVector> cumulative_sums_of_exponentials(const WeightsVector &log_weights);
+
 
 
     /**
@@ -151,18 +427,38 @@ public:
     UniformDistributionPtr_t create_uniform_distribution() const;
 
     /**
-    * Sum the weights from `begin_index_` to `end_index_`.
+    * Sum the weights from `begin_index_` to `end_index_` in constant time using the prefix sums.
     * @param begin_index_ The index of the first weight.
     * @param end_index_ The index of the excluded last weight.
-    * @return
+    * @return The sum of the logarithmic weights in the range.
     */
     double sum_weights_from_indices(size_t begin_index_, size_t end_index_) const;
 
     double sum_weights() const;
 
+    /**
+     * Calculate the share of the total weight that lies in the datapoints from `begin_index_` to `end_index_`.
+     * @param begin_index_ The index of the first datapoint.
+     * @param end_index_ The index of the excluded last datapoint.
+     * @return The probability mass of the range.
+     */
+    double probability_from_indices(size_t begin_index_, size_t end_index_) const;
+
 
+    /**
+     * Find the split index that maximizes the log-likelihood of the two resulting quantiles.
+     *
+     * Every candidate is scored in constant time, hence this is linear in the number of datapoints in this step.
+     * @return The best log-likelihood and the best split index, or -1 if no valid split exists.
+     */
     std::tuple<double, int> compute_best_split() const;
 
+    /**
+     * @return The number of split indices that compute_best_split scores, those that leave at least
+     * `min_samples_per_quantile` datapoints on both sides.
+     */
+    size_t number_of_candidate_splits() const;
+
     /**
      * Construct the left induction step.
      * @param split_index The index of the split.
@@ -178,6 +474,26 @@ public:
     InductionStepPtr_t construct_right_induction_step(size_t split_index) const;
 
 
+    /**
+     * Find the best split and check if it improves the likelihood sufficiently.
+     *
+     * This does not modify the Nyga Distribution and hence can be called from multiple threads.
+     * @return The split index if splitting is beneficial, std::nullopt otherwise.
+     */
+    std::optional<size_t> split_index_if_beneficial() const;
+
+    /**
+     * Create the uniform distribution from the datapoint at `begin_index_` to the datapoint at `end_index_` and mount
+     * it into the Nyga Distribution, weighted by its probability mass.
+     * @param begin_index_  The index of the first datapoint.
+     * @param end_index_ The index of the excluded last datapoint.
+     */
+    void mount_distribution_from_indices(size_t begin_index_, size_t end_index_) const;
+
+    /**
+     * Split this step or mount its uniform distribution into the Nyga Distribution if splitting is not beneficial.
+     * @return The left and right induction steps if a split was made.
+     */
     [[maybe_unused]] std::optional<std::pair<InductionStepPtr_t, InductionStepPtr_t>> induce();
 
     template<typename... Args>
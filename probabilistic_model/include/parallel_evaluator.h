@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "compiled_circuit.h"
+#include "thread_pool.h"
+
+//FORWARD DECLARATIONS
+class ParallelEvaluator;
+
+typedef std::shared_ptr<ParallelEvaluator> ParallelEvaluatorPtr_t;
+
+/**
+ * Class for evaluating large batches of rows with a compiled circuit on a pool of threads.
+ *
+ * The batch is split into blocks of `block_size` rows at the same boundaries as log_likelihood_batch, and the workers
+ * claim blocks from a shared counter. Every worker owns a scratch buffer for all nodes of one block, which is allocated
+ * by the worker itself on its first evaluation such that it resides on the NUMA node of the worker. Hence the hot loop
+ * neither allocates nor writes to shared memory other than the output, and the results are bit-identical to
+ * evaluating the circuit on a single thread.
+ */
+class ParallelEvaluator {
+public:
+
+    /**
+     * The number of rows that a worker evaluates at once.
+     */
+    const size_t block_size;
+
+    /**
+     * Construct an evaluator for a compiled or mapped circuit.
+     * @throws std::invalid_argument if the block size is 0 or the NUMA node does not exist.
+     * @param model The CompiledCircuit or MappedCircuit that owns the arrays of the tape.
+     * @param circuit_tape The tape of the model.
+     * @param number_of_threads The number of workers. If 0, the number of CPUs of the NUMA node or of hardware
+     * threads is used.
+     * @param numa_node The NUMA node to pin the workers to, or -1 to not pin them.
+     * @param block_size The number of rows that a worker evaluates at once.
+     */
+    ParallelEvaluator(std::shared_ptr<const ProbabilisticModel> model, const CircuitTape &circuit_tape,
+                      size_t number_of_threads = 0, int numa_node = -1,
+                      size_t block_size = ProbabilisticModel::batch_block_size);
+
+    /**
+     * Construct an evaluator that owns a compiled copy of a circuit.
+     * @throws std::invalid_argument if the circuit cannot be compiled, the block size is 0 or the NUMA node does not
+     * exist.
+     * @param circuit The root of the circuit.
+     * @param number_of_threads The number of workers. If 0, the number of CPUs of the NUMA node or of hardware
+     * threads is used.
+     * @param numa_node The NUMA node to pin the workers to, or -1 to not pin them.
+     * @param block_size The number of rows that a worker evaluates at once.
+     */
+    explicit ParallelEvaluator(const ProbabilisticCircuitPtr_t &circuit, size_t number_of_threads = 0,
+                               int numa_node = -1, size_t block_size = ProbabilisticModel::batch_block_size);
+
+    /**
+     * The log-likelihood of a batch of full evidences.
+     *
+     * The data is column-major with the columns ordered like the variables of the circuit, see
+     * ProbabilisticModel::log_likelihood_batch. Concurrent calls are serialized.
+     * @param data The column-major data.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    void log_likelihood_batch(const double *data, size_t n_rows, double *out);
+
+    /**
+     * @return The number of workers.
+     */
+    size_t number_of_threads() const {
+        return thread_pool->size();
+    }
+
+    template<typename... Args>
+    static ParallelEvaluatorPtr_t make_shared(Args &&... args) {
+        return std::make_shared<ParallelEvaluator>(std::forward<Args>(args)...);
+    };
+
+private:
+
+    /**
+     * The buffers of one worker, reused by every block it evaluates.
+     */
+    struct WorkerScratch {
+        std::vector<double> scratch;
+        ColumnPointers columns;
+    };
+
+    std::shared_ptr<const ProbabilisticModel> model;
+    CircuitTape circuit_tape;
+    ThreadPoolPtr_t thread_pool;
+    std::vector<WorkerScratch> worker_scratches;
+    std::mutex evaluation_mutex;
+
+    /**
+     * Evaluate blocks until all blocks of the batch are claimed.
+     */
+    void evaluate_blocks(const double *data, size_t n_rows, double *out, std::atomic<size_t> &next_block);
+
+};
@@ -4,13 +4,41 @@
 #include <memory>
 #include "probabilistic_model.h"
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include "log_sum_exp.h"
+#include "alias_table.h"
 
 //FORWARD DECLARATIONS
 class ProbabilisticCircuit;
 
 typedef std::shared_ptr<ProbabilisticCircuit> ProbabilisticCircuitPtr_t;
 
-class ProbabilisticCircuit : public ProbabilisticModel {
+/**
+ * One pointer per variable to the column that samples of that variable are written to.
+ */
+typedef std::vector<double *> SampleColumnPointers;
+
+/**
+ * The probabilities of a batch of events under every node that was evaluated so far.
+ */
+typedef std::unordered_map<const ProbabilisticCircuit *, std::vector<double>> ProbabilityMemo;
+
+/**
+ * The marginals of nodes that were already computed, keyed by the node and the variables of the node that are kept.
+ */
+typedef std::map<std::pair<const ProbabilisticCircuit *, std::vector<AbstractVariablePtr_t>>,
+        ProbabilisticCircuitPtr_t> MarginalCache;
+
+class ProbabilisticCircuit : public ProbabilisticModel, public std::enable_shared_from_this<ProbabilisticCircuit> {
 public:
     std::vector<ProbabilisticCircuitPtr_t> sub_circuits;
 
@@ -35,7 +63,7 @@ public:
         auto other_variables_iterator = other_variables->begin();
         int index = 0;
         for (auto const &variable: *own_variables) {
-            if (variable == *other_variables_iterator) {
+            if (other_variables_iterator != other_variables->end() && variable == *other_variables_iterator) {
                 result.push_back(index);
                 other_variables_iterator++;
             }
@@ -44,6 +72,339 @@ public:
         return result;
     }
 
+    /**
+     * Discard all values that this node derived from its structure or parameters.
+     *
+     * Nodes keep such values to speed up inference. The add_subcircuit methods keep them up to date; code that
+     * modifies the public members of a node directly has to call this method afterwards.
+     */
+    virtual void reset_caches() {}
+
+    /**
+     * Draw independent samples from this circuit.
+     *
+     * The samples are drawn ancestrally: every sum unit distributes the rows it receives among its subcircuits and
+     * every subcircuit is visited once per path with all of its rows, instead of walking the circuit once per sample.
+     *
+     * @param n The number of samples.
+     * @param generator The random number generator.
+     * @param out The column-major buffer of size `n * get_variables()->size()` to write the samples to. The columns
+     * are ordered like get_variables().
+     */
+    void sample(size_t n, RandomGenerator_t &generator, double *out) const {
+        auto number_of_variables = get_variables()->size();
+        SampleColumnPointers columns(number_of_variables);
+        for (size_t column = 0; column < number_of_variables; column++) {
+            columns[column] = out + column * n;
+        }
+        std::vector<size_t> rows(n);
+        std::iota(rows.begin(), rows.end(), 0);
+        sample_rows(rows.data(), n, columns, generator);
+    }
+
+    /**
+     * Draw one sample for each of the given rows.
+     *
+     * This method has by default throws a std::logic_error, every circuit that supports sampling has to overload it.
+     *
+     * @param rows The indices of the rows to write samples to.
+     * @param n_rows The number of rows.
+     * @param columns The pointers to the columns of the variables of this circuit, ordered like get_variables().
+     * @param generator The random number generator.
+     */
+    virtual void sample_rows(const size_t * /*rows*/, size_t /*n_rows*/, const SampleColumnPointers & /*columns*/,
+                             RandomGenerator_t & /*generator*/) const {
+        throw std::logic_error("Sampling is not implemented for " + representation());
+    }
+
+    /**
+     * Get the distinct nodes of this circuit such that every node comes after its subcircuits.
+     * @param descend Whether to visit the subcircuits of a node. If not given, all nodes are visited.
+     * @return The nodes, this circuit is the last one.
+     */
+    std::vector<const ProbabilisticCircuit *>
+    nodes_in_post_order(const std::function<bool(const ProbabilisticCircuit &)> &descend = nullptr) const;
+
+    /**
+     * Calculate the probability of an event.
+     * @param event The event.
+     * @return The probability.
+     */
+    double probability(const ProductEvent &event) const {
+        double result;
+        probability(std::vector<ProductEvent>{event}, &result);
+        return result;
+    }
+
+    /**
+     * Calculate the probabilities of a batch of events in one bottom-up pass.
+     *
+     * Every distinct node is evaluated once for all events, hence subcircuits that are shared by multiple parents
+     * are not evaluated again.
+     * @param events The events.
+     * @param out The array of size events.size() to write the probabilities to.
+     */
+    void probability(const std::vector<ProductEvent> &events, double *out) const;
+
+    /**
+     * Calculate the probabilities of a batch of events under this node.
+     *
+     * The probabilities under the subcircuits are already in the memo. This method has by default throws a
+     * std::logic_error, every circuit that supports probability queries has to overload it.
+     *
+     * @param events The events.
+     * @param memo The probabilities under all nodes that come before this node in post order.
+     * @param out The array of size events.size() to write the probabilities to.
+     */
+    virtual void probability_of_events(const std::vector<ProductEvent> & /*events*/, const ProbabilityMemo & /*memo*/,
+                                       double * /*out*/) const {
+        throw std::logic_error("Probability queries are not implemented for " + representation());
+    }
+
+    /**
+     * Calculate the marginal distribution of a subset of the variables.
+     *
+     * Subcircuits whose variables are all kept are shared with this circuit, subcircuits whose variables are all
+     * marginalized out are dropped and products that are left with one subcircuit are replaced by it. Nodes that are
+     * shared by multiple parents are marginalized once and stay shared in the result.
+     *
+     * @param variables The variables to keep.
+     * @return The marginal circuit, nullptr if none of the variables is in this circuit. If all variables of this
+     * circuit are kept and it is owned by a shared pointer, this circuit itself.
+     */
+    ProbabilisticCircuitPtr_t marginal(const AbstractVariableSetPtr_t &variables) const {
+        MarginalCache cache;
+        return marginal(variables, cache);
+    }
+
+    /**
+     * Calculate the marginal distribution of a subset of the variables with a cache of marginals of nodes.
+     *
+     * Reusing the cache for queries over the same variables shares the marginal subcircuits between the results.
+     * The cache must not outlive this circuit.
+     *
+     * @param variables The variables to keep.
+     * @param cache The cache.
+     * @return The marginal circuit.
+     */
+    ProbabilisticCircuitPtr_t marginal(const AbstractVariableSetPtr_t &variables, MarginalCache &cache) const;
+
+    /**
+     * Create a node of the same type as this one over the marginals of the subcircuits.
+     *
+     * This method has by default throws a std::logic_error, every inner node that supports marginalization has to
+     * overload it.
+     *
+     * @param sub_circuit_marginals The marginal of every subcircuit, nullptr for subcircuits that are marginalized out
+     * completely.
+     * @return The marginal of this node.
+     */
+    virtual ProbabilisticCircuitPtr_t
+    marginal_from_sub_circuits(const std::vector<ProbabilisticCircuitPtr_t> & /*sub_circuit_marginals*/) const {
+        throw std::logic_error("Marginalization is not implemented for " + representation());
+    }
+
+    /**
+     * @return Whether probability_of_events reads the probabilities of the subcircuits from the memo. Nodes that
+     * answer probability queries on their own return false, such that their subcircuits are not evaluated.
+     */
+    virtual bool probability_uses_sub_circuits() const {
+        return true;
+    }
+
+    /**
+     * Calculate the most probable explanation of rows with missing values by max-product inference.
+     *
+     * Sums take the maximum of their weighted subcircuits, products add the maxima of their subcircuits and leaves
+     * evaluate missing values at their mode. The maximizing subcircuit of every sum and row is stored and the
+     * assignments are read off by following these choices from the root to the leaves. The rows are processed in
+     * blocks of `batch_block_size` with buffers of one block per node that are allocated once, and every distinct
+     * node is evaluated once per block.
+     *
+     * @param data The column-major data, ordered like get_variables(). NaN marks a missing value.
+     * @param n_rows The number of rows.
+     * @param assignments The column-major buffer of the same size as the data to write the assignments to. Observed
+     * values are copied and missing values are replaced by their most probable value.
+     * @param max_log_likelihoods The array of size n_rows to write the maximal log-likelihood of every row to, or
+     * nullptr.
+     */
+    void most_probable_explanation(const double *data, size_t n_rows, double *assignments,
+                                   double *max_log_likelihoods = nullptr) const;
+
+    /**
+     * Calculate the maximal log-likelihood of a block of rows under this node from the maxima of its subcircuits.
+     *
+     * This method has by default throws a std::logic_error, every circuit that supports max-product inference has to
+     * overload it.
+     *
+     * @param columns The columns of the variables of this node, ordered like get_variables(). NaN marks a missing
+     * value.
+     * @param n_rows The number of rows.
+     * @param sub_circuit_maxima The maximal log-likelihoods of every subcircuit for the block.
+     * @param out The array of size n_rows to write the maxima to.
+     * @param argmax The array of size n_rows to write the index of the maximizing subcircuit of every row to, if this
+     * node chooses between its subcircuits.
+     * @param scratch A buffer of n_rows doubles this method may overwrite.
+     */
+    virtual void max_log_likelihood_of_columns(const ColumnPointers & /*columns*/, size_t /*n_rows*/,
+                                               const ColumnPointers & /*sub_circuit_maxima*/, double * /*out*/,
+                                               uint32_t * /*argmax*/, double * /*scratch*/) const {
+        throw std::logic_error("Max-product inference is not implemented for " + representation());
+    }
+
+    /**
+     * Pass rows on to the subcircuits that maximize them or, for leaves, write the most probable values.
+     *
+     * This method has by default throws a std::logic_error, every circuit that supports max-product inference has to
+     * overload it.
+     *
+     * @param rows The indices of the rows in the block.
+     * @param n_rows The number of rows.
+     * @param argmax The indices written by max_log_likelihood_of_columns for the entire block.
+     * @param sub_circuit_rows The lists to append the rows of every subcircuit to.
+     * @param columns The columns of the variables of this node in the assignments of the block. Missing values are
+     * NaN until a leaf replaces them.
+     */
+    virtual void most_probable_rows(const size_t * /*rows*/, size_t /*n_rows*/, const uint32_t * /*argmax*/,
+                                    const std::vector<std::vector<size_t> *> & /*sub_circuit_rows*/,
+                                    const SampleColumnPointers & /*columns*/) const {
+        throw std::logic_error("Max-product inference is not implemented for " + representation());
+    }
+
+    /**
+     * Refit the weights of all sums and the probabilities of all discrete leaves to data by expectation maximization.
+     *
+     * The structure and all other parameters are kept. Every iteration evaluates all nodes bottom-up and propagates
+     * the flows, i.e. the posterior probability that a row passes through a node, top-down in blocks of
+     * `batch_block_size`. The expected counts of the edges of every sum and of the codes of every discrete leaf are
+     * accumulated, and the weights and probabilities are set to the normalized counts at the end of the iteration.
+     * Rows that are impossible under the current parameters are ignored.
+     *
+     * The blocks are split into one contiguous shard per thread. Every thread keeps its own buffers and expected
+     * counts, which are reduced in the order of the shards, hence the result does not depend on the scheduling.
+     *
+     * @throws std::logic_error if the circuit contains inner nodes that do not support expectation maximization.
+     * @param data The column-major data, ordered like get_variables().
+     * @param n_rows The number of rows.
+     * @param number_of_iterations The number of iterations.
+     * @param number_of_threads The number of threads.
+     * @return The log-likelihood of the possible rows before every iteration.
+     */
+    std::vector<double> expectation_maximization(const double *data, size_t n_rows, size_t number_of_iterations,
+                                                 size_t number_of_threads = 1);
+
+    /**
+     * Calculate the log-likelihood of a block of rows under this node from the log-likelihoods of its subcircuits.
+     *
+     * This method has by default calls log_likelihood_of_columns, which evaluates the subcircuits again. Inner nodes
+     * should overload it.
+     *
+     * @param columns The columns of the variables of this node, ordered like get_variables().
+     * @param n_rows The number of rows.
+     * @param sub_circuit_log_likelihoods The log-likelihoods of every subcircuit for the block.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     * @param scratch A buffer of n_rows doubles this method may overwrite.
+     */
+    virtual void log_likelihood_of_sub_circuits(const ColumnPointers &columns, size_t n_rows,
+                                                const ColumnPointers & /*sub_circuit_log_likelihoods*/, double *out,
+                                                double * /*scratch*/) const {
+        log_likelihood_of_columns(columns, n_rows, out);
+    }
+
+    /**
+     * @return The number of expected counts this node accumulates during expectation maximization.
+     */
+    virtual size_t number_of_expected_counts() const {
+        return 0;
+    }
+
+    /**
+     * Pass the flows of a block of rows on to the subcircuits and accumulate the expected counts of this node.
+     *
+     * This method has by default throws a std::logic_error for inner nodes and does nothing for leaves.
+     *
+     * @param columns The columns of the variables of this node, ordered like get_variables().
+     * @param n_rows The number of rows.
+     * @param log_likelihoods The log-likelihoods of this node for the block.
+     * @param flows The flows of this node for the block.
+     * @param sub_circuit_log_likelihoods The log-likelihoods of every subcircuit for the block.
+     * @param sub_circuit_flows The flows of every subcircuit to add to.
+     * @param expected_counts The array of size number_of_expected_counts() to add to.
+     */
+    virtual void accumulate_expected_counts(const ColumnPointers & /*columns*/, size_t /*n_rows*/,
+                                            const double * /*log_likelihoods*/, const double * /*flows*/,
+                                            const ColumnPointers & /*sub_circuit_log_likelihoods*/,
+                                            const SampleColumnPointers & /*sub_circuit_flows*/,
+                                            double * /*expected_counts*/) const {
+        if (!sub_circuits.empty()) {
+            throw std::logic_error("Expectation maximization is not implemented for " + representation());
+        }
+    }
+
+    /**
+     * Set the parameters of this node to the normalized expected counts. Parameters without counts are kept.
+     * @param expected_counts The array of size number_of_expected_counts() accumulated over all rows.
+     */
+    virtual void maximize_expected_counts(const double * /*expected_counts*/) {}
+
+    /**
+     * @return The number of weights of all sums of this circuit, i.e. the size of the weight gradient.
+     */
+    size_t number_of_sum_weights() const;
+
+    /**
+     * Calculate the gradient of the log-likelihood of a batch with respect to the weights of the sums and the values
+     * of continuous variables by reverse-mode differentiation.
+     *
+     * The forward pass stores the log-likelihood of every node for a block of `batch_block_size` rows. The backward
+     * pass propagates the derivatives of the log-likelihood of the root with respect to the log-likelihoods of the
+     * nodes, which are the flows of expectation maximization, from the root to the leaves. Both passes visit every
+     * distinct node once per block, hence the time is linear in the size of the circuit.
+     *
+     * The weights are treated as free parameters, the gradient of normalized or logarithmic weights follows by the
+     * chain rule. Impossible rows do not contribute to the gradient.
+     *
+     * @param data The column-major data, ordered like get_variables().
+     * @param n_rows The number of rows.
+     * @param log_likelihoods The array of size n_rows to write the log-likelihoods to, or nullptr.
+     * @param weight_gradients The array of size number_of_sum_weights() to write the derivatives of the sum of the
+     * log-likelihoods with respect to the weights to, or nullptr. The sums are ordered like nodes_in_post_order() and
+     * the weights of a sum like its subcircuits.
+     * @param input_gradients The column-major array of the size of the data to write the derivatives of the
+     * log-likelihood of every row with respect to its values to, or nullptr. The derivatives of discrete variables
+     * are 0.
+     * @throws std::logic_error if the circuit contains inner nodes other than smooth sums and decomposable products.
+     */
+    void log_likelihood_gradient(const double *data, size_t n_rows, double *log_likelihoods,
+                                 double *weight_gradients, double *input_gradients = nullptr) const;
+
+    /**
+     * @return The number of weights of this node that are differentiated by log_likelihood_gradient.
+     */
+    virtual size_t number_of_weights() const {
+        return 0;
+    }
+
+    /**
+     * Add the derivatives of a block of rows with respect to the weights and the input values of this node.
+     *
+     * By default this method does nothing, which is correct for nodes without weights and densities that are
+     * piecewise constant.
+     *
+     * @param columns The columns of the variables of this node, ordered like get_variables().
+     * @param n_rows The number of rows.
+     * @param log_likelihoods The log-likelihoods of this node for the block.
+     * @param flows The derivatives of the log-likelihood of the root with respect to the log-likelihoods of this node.
+     * @param sub_circuit_log_likelihoods The log-likelihoods of every subcircuit for the block.
+     * @param weight_gradients The array of size number_of_weights() to add to.
+     * @param input_gradients The gradients of the columns of the variables of this node for the block to add to.
+     */
+    virtual void accumulate_gradients(const ColumnPointers & /*columns*/, size_t /*n_rows*/,
+                                      const double * /*log_likelihoods*/, const double * /*flows*/,
+                                      const ColumnPointers & /*sub_circuit_log_likelihoods*/,
+                                      double * /*weight_gradients*/,
+                                      const SampleColumnPointers & /*input_gradients*/) const {}
+
 };
 
 /**
@@ -52,7 +413,57 @@ public:
 class SmoothSumUnit : public ProbabilisticCircuit {
 public:
 
-    std::vector<double> weights;
+    /**
+     * The weight of every subcircuit. This is a read-only view, use set_weights or set_weight to change them.
+     */
+    const std::vector<double> &weights = weight_values;
+
+    SmoothSumUnit() = default;
+
+    /**
+     * Copy the weights of another sum. The view `weights` refers to the copy, the alias table is rebuilt lazily.
+     */
+    SmoothSumUnit(const SmoothSumUnit &other) : ProbabilisticCircuit(other), weight_values(other.weight_values),
+                                                log_weight_values(other.log_weight_values) {}
+
+    SmoothSumUnit &operator=(const SmoothSumUnit &other) {
+        ProbabilisticCircuit::operator=(other);
+        weight_values = other.weight_values;
+        log_weight_values = other.log_weight_values;
+        std::atomic_store(&alias_table_cache, AliasTablePtr_t());
+        return *this;
+    }
+
+    /**
+     * @return The logarithms of the weights.
+     */
+    const std::vector<double> &log_weights() const {
+        return log_weight_values;
+    }
+
+    /**
+     * Replace the weights and rebuild all representations that are derived from them.
+     * @throws std::invalid_argument if the number of weights differs from the number of subcircuits.
+     * @param weights The weight of every subcircuit.
+     */
+    void set_weights(std::vector<double> weights) {
+        if (weights.size() != sub_circuits.size()) {
+            throw std::invalid_argument("Expected " + std::to_string(sub_circuits.size()) + " weights but got " +
+                                        std::to_string(weights.size()));
+        }
+        weight_values = std::move(weights);
+        reset_caches();
+    }
+
+    /**
+     * Replace the weight of one subcircuit and rebuild all representations that are derived from the weights.
+     * @param index The index of the subcircuit.
+     * @param weight The new weight.
+     */
+    void set_weight(size_t index, double weight) {
+        weight_values.at(index) = weight;
+        reset_caches();
+    }
 
     virtual std::string representation() const override {
         return "+";
@@ -60,7 +471,7 @@ public:
 
     double likelihood(const FullEvidencePtr_t &event) const override {
         double sum = 0;
-        auto current_weight = weights.begin();
+        auto current_weight = weight_values.begin();
         for (auto &sub_circuit: sub_circuits) {
             sum += *current_weight * sub_circuit->likelihood(event);
             current_weight++;
@@ -68,19 +479,269 @@ public:
         return sum;
     }
 
+    /**
+     * Calculate the log-likelihood as log-sum-exp of the weighted log-likelihoods of the subcircuits.
+     *
+     * The sum is accumulated relative to the running maximum, hence it does not underflow if all subcircuits have
+     * log-likelihoods far below the smallest representable exponent.
+     */
     double log_likelihood(const FullEvidencePtr_t &event) const override {
-        double sum = 0;
-        auto current_weight = weights.begin();
-        for (auto &sub_circuit: sub_circuits) {
-            sum += *current_weight * exp(sub_circuit->log_likelihood(event));
-            current_weight++;
+        PROFILE_NODE_EVALUATION(1);
+        return streaming_log_sum_exp([&](size_t index) {
+            return sub_circuits[index]->log_likelihood(event);
+        });
+    }
+
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+
+        // a single row does not need any buffers
+        if (n_rows == 1) {
+            *out = streaming_log_sum_exp([&](size_t index) {
+                double sub_circuit_log_likelihood;
+                sub_circuits[index]->log_likelihood_of_columns(columns, 1, &sub_circuit_log_likelihood);
+                return sub_circuit_log_likelihood;
+            });
+            return;
+        }
+
+        std::vector<double> sub_circuit_log_likelihoods(sub_circuits.size() * n_rows);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            sub_circuits[index]->log_likelihood_of_columns(columns, n_rows,
+                                                           sub_circuit_log_likelihoods.data() + index * n_rows);
+        }
+        std::vector<double> accumulator(n_rows);
+        weighted_log_sum_exp(sub_circuit_log_likelihoods.data(), log_weight_values.data(), sub_circuits.size(), n_rows,
+                             out, accumulator.data());
+    }
+
+    /**
+     * Draw a subcircuit for every row from the alias table of the weights and pass the rows of every subcircuit on in
+     * one call.
+     */
+    void sample_rows(const size_t *rows, size_t n_rows, const SampleColumnPointers &columns,
+                     RandomGenerator_t &generator) const override {
+        auto table = alias_table();
+
+        std::vector<uint32_t> drawn_sub_circuits(n_rows);
+        std::vector<size_t> sub_circuit_begin(sub_circuits.size() + 1);
+        for (size_t row = 0; row < n_rows; row++) {
+            drawn_sub_circuits[row] = (uint32_t) table->draw(generator);
+            sub_circuit_begin[drawn_sub_circuits[row] + 1]++;
+        }
+        std::partial_sum(sub_circuit_begin.begin(), sub_circuit_begin.end(), sub_circuit_begin.begin());
+
+        // group the rows by subcircuit, keeping their order
+        std::vector<size_t> grouped_rows(n_rows);
+        std::vector<size_t> positions(sub_circuit_begin.begin(), sub_circuit_begin.end() - 1);
+        for (size_t row = 0; row < n_rows; row++) {
+            grouped_rows[positions[drawn_sub_circuits[row]]++] = rows[row];
+        }
+
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto count = sub_circuit_begin[index + 1] - sub_circuit_begin[index];
+            if (count > 0) {
+                sub_circuits[index]->sample_rows(grouped_rows.data() + sub_circuit_begin[index], count, columns,
+                                                 generator);
+            }
+        }
+    }
+
+    void probability_of_events(const std::vector<ProductEvent> &events, const ProbabilityMemo &memo,
+                               double *out) const override {
+        std::fill(out, out + events.size(), 0.);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto &sub_circuit_probabilities = memo.at(sub_circuits[index].get());
+            for (size_t event = 0; event < events.size(); event++) {
+                out[event] += weight_values[index] * sub_circuit_probabilities[event];
+            }
+        }
+    }
+
+    /**
+     * Take the maximum of the weighted subcircuits for every row, the first maximum wins ties.
+     */
+    void max_log_likelihood_of_columns(const ColumnPointers & /*columns*/, size_t n_rows,
+                                       const ColumnPointers &sub_circuit_maxima, double *out, uint32_t *argmax,
+                                       double * /*scratch*/) const override {
+        std::fill(out, out + n_rows, -std::numeric_limits<double>::infinity());
+        std::fill(argmax, argmax + n_rows, 0);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto sub_circuit_maximum = sub_circuit_maxima[index];
+            auto log_weight = log_weight_values[index];
+            for (size_t row = 0; row < n_rows; row++) {
+                auto value = log_weight + sub_circuit_maximum[row];
+                bool is_greater = value > out[row];
+                out[row] = is_greater ? value : out[row];
+                argmax[row] = is_greater ? (uint32_t) index : argmax[row];
+            }
+        }
+    }
+
+    void most_probable_rows(const size_t *rows, size_t n_rows, const uint32_t *argmax,
+                            const std::vector<std::vector<size_t> *> &sub_circuit_rows,
+                            const SampleColumnPointers & /*columns*/) const override {
+        for (size_t index = 0; index < n_rows; index++) {
+            sub_circuit_rows[argmax[rows[index]]]->push_back(rows[index]);
+        }
+    }
+
+    void log_likelihood_of_sub_circuits(const ColumnPointers & /*columns*/, size_t n_rows,
+                                        const ColumnPointers &sub_circuit_log_likelihoods, double *out,
+                                        double *scratch) const override {
+        weighted_log_sum_exp(sub_circuit_log_likelihoods.data(), log_weight_values.data(), sub_circuits.size(), n_rows,
+                             out, scratch);
+    }
+
+    size_t number_of_expected_counts() const override {
+        return sub_circuits.size();
+    }
+
+    /**
+     * Split the flow of every row between the subcircuits in proportion to their weighted likelihoods. Rows without
+     * flow have an undefined ratio, which vectorizable_exp flushes to 0. Rows in which this sum is infinite are split
+     * between the infinite subcircuits, see infinite_rows.
+     */
+    void accumulate_expected_counts(const ColumnPointers & /*columns*/, size_t n_rows, const double *log_likelihoods,
+                                    const double *flows, const ColumnPointers &sub_circuit_log_likelihoods,
+                                    const SampleColumnPointers &sub_circuit_flows,
+                                    double *expected_counts) const override {
+        std::vector<size_t> rows;
+        std::vector<double> infinite_weights;
+        infinite_rows(n_rows, log_likelihoods, sub_circuit_log_likelihoods, rows, infinite_weights);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto sub_circuit_log_likelihood = sub_circuit_log_likelihoods[index];
+            auto sub_circuit_flow = sub_circuit_flows[index];
+            auto log_weight = log_weight_values[index];
+            double expected_count = 0;
+            for (size_t row = 0; row < n_rows; row++) {
+                auto flow = flows[row] * vectorizable_exp(log_weight + sub_circuit_log_likelihood[row] -
+                                                          log_likelihoods[row]);
+                sub_circuit_flow[row] += flow;
+                expected_count += flow;
+            }
+            for (size_t position = 0; position < rows.size(); position++) {
+                auto row = rows[position];
+                auto flow = sub_circuit_log_likelihood[row] == std::numeric_limits<double>::infinity() ?
+                            flows[row] * exp(log_weight) / infinite_weights[position] : 0.;
+                sub_circuit_flow[row] += flow;
+                expected_count += flow;
+            }
+            expected_counts[index] += expected_count;
+        }
+    }
+
+    void maximize_expected_counts(const double *expected_counts) override {
+        auto total = std::accumulate(expected_counts, expected_counts + sub_circuits.size(), 0.);
+        if (total <= 0) {
+            return;
         }
-        return log(sum);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            weight_values[index] = expected_counts[index] / total;
+        }
+        reset_caches();
+    }
+
+    size_t number_of_weights() const override {
+        return sub_circuits.size();
+    }
+
+    /**
+     * The derivative of the log-likelihood of the root with respect to a weight is the flow of this sum times the
+     * likelihood ratio of the subcircuit and this sum. Rows without flow are skipped, since their ratio is undefined.
+     * In rows where this sum is infinite, the ratio is taken in the limit, see infinite_rows.
+     */
+    void accumulate_gradients(const ColumnPointers & /*columns*/, size_t n_rows, const double *log_likelihoods,
+                              const double *flows, const ColumnPointers &sub_circuit_log_likelihoods,
+                              double *weight_gradients,
+                              const SampleColumnPointers & /*input_gradients*/) const override {
+        std::vector<size_t> rows;
+        std::vector<double> infinite_weights;
+        infinite_rows(n_rows, log_likelihoods, sub_circuit_log_likelihoods, rows, infinite_weights);
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto sub_circuit_log_likelihood = sub_circuit_log_likelihoods[index];
+            double gradient = 0;
+            for (size_t row = 0; row < n_rows; row++) {
+                bool is_finite = flows[row] > 0 && !std::isinf(log_likelihoods[row]);
+                gradient += is_finite ? flows[row] * exp(sub_circuit_log_likelihood[row] - log_likelihoods[row]) : 0.;
+            }
+            for (size_t position = 0; position < rows.size(); position++) {
+                auto row = rows[position];
+                gradient += sub_circuit_log_likelihood[row] == std::numeric_limits<double>::infinity() ?
+                            flows[row] / infinite_weights[position] : 0.;
+            }
+            weight_gradients[index] += gradient;
+        }
+    }
+
+    /**
+     * Create a smooth sum with the weights of this one. Sums share the variables of their subcircuits, hence no
+     * subcircuit is marginalized out completely. The marginal of a deterministic sum is in general not deterministic.
+     */
+    ProbabilisticCircuitPtr_t
+    marginal_from_sub_circuits(const std::vector<ProbabilisticCircuitPtr_t> &sub_circuit_marginals) const override {
+        auto result = std::make_shared<SmoothSumUnit>();
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            result->add_subcircuit(weight_values[index], sub_circuit_marginals[index]);
+        }
+        return result;
     }
 
     void add_subcircuit(double weight, const ProbabilisticCircuitPtr_t &sub_circuit) {
-        weights.push_back(weight);
+        weight_values.push_back(weight);
+        log_weight_values.push_back(log(weight));
         sub_circuits.push_back(sub_circuit);
+        std::atomic_store(&alias_table_cache, AliasTablePtr_t());
+    }
+
+    /**
+     * Recalculate the logarithmic weights and drop the alias table.
+     */
+    void reset_caches() override {
+        log_weight_values.resize(weight_values.size());
+        std::transform(weight_values.begin(), weight_values.end(), log_weight_values.begin(), [](double weight) {
+            return log(weight);
+        });
+        std::atomic_store(&alias_table_cache, AliasTablePtr_t());
+    }
+
+    /**
+     * Get the alias table of the weights.
+     *
+     * The table is built on first use and cached until the weights are set again. Concurrent calls are safe, at worst
+     * the table is built more than once.
+     *
+     * @return The alias table.
+     */
+    AliasTablePtr_t alias_table() const {
+        auto result = std::atomic_load(&alias_table_cache);
+        if (result) {
+            return result;
+        }
+        result = std::make_shared<AliasTable>(weight_values);
+        std::atomic_store(&alias_table_cache, result);
+        return result;
+    }
+
+    /**
+     * Accumulate the log-sum-exp of the weighted log-likelihoods of the subcircuits relative to the running maximum.
+     * @param sub_circuit_log_likelihood The function that returns the log-likelihood of the subcircuit at an index.
+     * @return The log-likelihood of this unit.
+     */
+    template<typename SubCircuitLogLikelihood>
+    double streaming_log_sum_exp(SubCircuitLogLikelihood sub_circuit_log_likelihood) const {
+        double maximum = -std::numeric_limits<double>::infinity();
+        double sum = 0;
+        for (size_t index = 0; index < sub_circuits.size(); index++) {
+            auto value = log_weight_values[index] + sub_circuit_log_likelihood(index);
+            if (value <= maximum) {
+                sum += vectorizable_exp(value - maximum);
+            } else if (value > maximum) {
+                sum = sum * vectorizable_exp(maximum - value) + 1.;
+                maximum = value;
+            }
+        }
+        return maximum + log(sum);
     }
 
     template<typename... Args>
@@ -96,17 +757,222 @@ public:
         return sub_circuits[0]->get_variables();
     }
 
+private:
+
+    /**
+     * The weights and their logarithms. They are private such that the logarithms and the alias table cannot get
+     * out of sync with the weights.
+     */
+    std::vector<double> weight_values;
+    std::vector<double> log_weight_values;
+
+    mutable AliasTablePtr_t alias_table_cache;
+
+    /**
+     * Find the rows of a block in which this sum is infinite and the total weight of its infinite subcircuits in
+     * every such row.
+     *
+     * The ratio of the likelihoods of a subcircuit and this sum is undefined in these rows. Treating the infinite
+     * densities as equal caps that grow without bound, the limit of the ratio is 1 over the total weight for the
+     * infinite subcircuits and 0 for all others.
+     * @param n_rows The number of rows.
+     * @param log_likelihoods The log-likelihoods of this sum.
+     * @param sub_circuit_log_likelihoods The log-likelihoods of every subcircuit.
+     * @param rows The vector to write the infinite rows to.
+     * @param infinite_weights The vector to write the total weights of the infinite subcircuits to.
+     */
+    void infinite_rows(size_t n_rows, const double *log_likelihoods, const ColumnPointers &sub_circuit_log_likelihoods,
+                       std::vector<size_t> &rows, std::vector<double> &infinite_weights) const {
+        for (size_t row = 0; row < n_rows; row++) {
+            if (log_likelihoods[row] != std::numeric_limits<double>::infinity()) {
+                continue;
+            }
+            double infinite_weight = 0;
+            for (size_t index = 0; index < sub_circuits.size(); index++) {
+                auto is_infinite = sub_circuit_log_likelihoods[index][row] == std::numeric_limits<double>::infinity();
+                infinite_weight += is_infinite ? exp(log_weight_values[index]) : 0.;
+            }
+            rows.push_back(row);
+            infinite_weights.push_back(infinite_weight);
+        }
+    }
+
+};
+
+/**
+ * The subcircuits of a deterministic sum over uniform distributions of one variable with disjoint, single interval
+ * supports, sorted by their lower bounds.
+ *
+ * A value can only be inside the interval with the greatest lower bound that is not greater than the value, or inside
+ * its predecessor if both touch in the value. Hence the log-likelihood is found by a binary search instead of
+ * evaluating every subcircuit.
+ */
+struct IntervalIndex {
+
+    /**
+     * The number of subcircuits of the sum when the index was built.
+     */
+    size_t number_of_sub_circuits = 0;
+
+    /**
+     * Whether the subcircuits allow an index. If not, all arrays are empty.
+     */
+    bool is_applicable = false;
+
+    std::vector<double> lowers;
+    std::vector<double> uppers;
+    std::vector<uint8_t> left_closed;
+    std::vector<uint8_t> right_closed;
+
+    /**
+     * The logarithmic weight plus the logarithmic density of every interval.
+     */
+    std::vector<double> log_values;
+
+    /**
+     * Find the index of the last interval whose lower bound is not greater than the value without branches.
+     * @param value The value.
+     * @return The index, 0 if the value is smaller than all lower bounds or nan.
+     */
+    size_t find(double value) const {
+        auto base = lowers.data();
+        auto size = lowers.size();
+        while (size > 1) {
+            auto half = size / 2;
+            base = base[half] <= value ? base + half : base;
+            size -= half;
+        }
+        return base - lowers.data();
+    }
+
+    bool contains(size_t index, double value) const {
+        bool inside_left = left_closed[index] ? value >= lowers[index] : value > lowers[index];
+        bool inside_right = right_closed[index] ? value <= uppers[index] : value < uppers[index];
+        return inside_left && inside_right;
+    }
+
+    /**
+     * @param value The value.
+     * @return The log-likelihood of the value under the sum.
+     */
+    double log_likelihood(double value) const {
+        if (lowers.empty()) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        auto index = find(value);
+        if (contains(index, value)) {
+            return log_values[index];
+        }
+        if (index > 0 && contains(index - 1, value)) {
+            return log_values[index - 1];
+        }
+        return -std::numeric_limits<double>::infinity();
+    }
+
 };
 
+typedef std::shared_ptr<const IntervalIndex> IntervalIndexPtr_t;
+
+
 class DeterministicSumUnit : public SmoothSumUnit {
+public:
 
     std::string representation() const override {
         return "⊕";
     }
 
+    double likelihood(const FullEvidencePtr_t &event) const override {
+        auto index = interval_index();
+        if (index->is_applicable) {
+            return exp(index->log_likelihood(event->at(0)));
+        }
+        return SmoothSumUnit::likelihood(event);
+    }
+
+    /**
+     * Calculate the log-likelihood with a binary search in the interval index if the subcircuits allow one.
+     */
+    double log_likelihood(const FullEvidencePtr_t &event) const override {
+        PROFILE_NODE_EVALUATION(1);
+        auto index = interval_index();
+        if (index->is_applicable) {
+            return index->log_likelihood(event->at(0));
+        }
+        return SmoothSumUnit::log_likelihood(event);
+    }
+
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto index = interval_index();
+        if (!index->is_applicable) {
+            SmoothSumUnit::log_likelihood_of_columns(columns, n_rows, out);
+            return;
+        }
+        auto values = columns[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = index->log_likelihood(values[row]);
+        }
+    }
+
+    /**
+     * Get the interval index of the subcircuits.
+     *
+     * The index is built on first use and rebuilt when subcircuits were added or the weights were set. Code that
+     * modifies the subcircuits in place has to call reset_caches. Concurrent calls are safe, at worst the index is
+     * built more than once.
+     *
+     * @return The index, which is not applicable if any subcircuit is not a uniform distribution over a single
+     * interval of the same variable or if the intervals overlap.
+     */
+    IntervalIndexPtr_t interval_index() const {
+        auto result = std::atomic_load(&interval_index_cache);
+        if (result && result->number_of_sub_circuits == sub_circuits.size()) {
+            return result;
+        }
+        result = build_interval_index();
+        std::atomic_store(&interval_index_cache, result);
+        return result;
+    }
+
+    void reset_caches() override {
+        SmoothSumUnit::reset_caches();
+        std::atomic_store(&interval_index_cache, IntervalIndexPtr_t());
+    }
+
+private:
+
+    mutable IntervalIndexPtr_t interval_index_cache;
+
+    IntervalIndexPtr_t build_interval_index() const;
+
 };
 
 
+/**
+ * The variables of a product unit and the columns of every subcircuit in the evidence of the product.
+ */
+struct ProductScope {
+
+    /**
+     * The union of the variables of all subcircuits.
+     */
+    AbstractVariableSetPtr_t variables;
+
+    /**
+     * For every subcircuit, the indices of its variables in `variables`.
+     */
+    std::vector<std::vector<size_t>> sub_circuit_column_indices;
+
+    /**
+     * The maximal number of variables of a subcircuit.
+     */
+    size_t max_sub_circuit_variables = 0;
+
+};
+
+typedef std::shared_ptr<const ProductScope> ProductScopePtr_t;
+
+
 class DecomposableProductUnit : public ProbabilisticCircuit {
 public:
 
@@ -114,32 +980,204 @@ public:
         return "*";
     }
 
+    /**
+     * Calculate the log-likelihood by passing views into the event to the subcircuits.
+     */
     double log_likelihood(const FullEvidencePtr_t &event) const override {
-        double product = 0;
-        auto own_variables = get_variables();
+        ColumnPointers columns(event->size());
+        for (size_t index = 0; index < event->size(); index++) {
+            columns[index] = event->data() + index;
+        }
+        double result;
+        log_likelihood_of_columns(columns, 1, &result);
+        return result;
+    }
+
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto product_scope = scope();
+        std::fill(out, out + n_rows, 0.);
+
+        // a single row does not need a buffer for the results of the subcircuits
+        double single_row_log_likelihood;
+        std::vector<double> sub_circuit_log_likelihoods(n_rows > 1 ? n_rows : 0);
+        auto sub_circuit_out = n_rows > 1 ? sub_circuit_log_likelihoods.data() : &single_row_log_likelihood;
+
+        ColumnPointers sub_circuit_columns;
+        sub_circuit_columns.reserve(product_scope->max_sub_circuit_variables);
+        for (size_t sub_circuit_index = 0; sub_circuit_index < sub_circuits.size(); sub_circuit_index++) {
+
+            // select the columns of the subcircuit
+            sub_circuit_columns.clear();
+            for (auto index: product_scope->sub_circuit_column_indices[sub_circuit_index]) {
+                sub_circuit_columns.push_back(columns[index]);
+            }
+
+            sub_circuits[sub_circuit_index]->log_likelihood_of_columns(sub_circuit_columns, n_rows, sub_circuit_out);
+            for (size_t row = 0; row < n_rows; row++) {
+                out[row] += sub_circuit_out[row];
+            }
+        }
+    }
+
+    /**
+     * Pass all rows to every subcircuit together with the columns of its variables.
+     */
+    void sample_rows(const size_t *rows, size_t n_rows, const SampleColumnPointers &columns,
+                     RandomGenerator_t &generator) const override {
+        auto product_scope = scope();
+        SampleColumnPointers sub_circuit_columns;
+        sub_circuit_columns.reserve(product_scope->max_sub_circuit_variables);
+        for (size_t sub_circuit_index = 0; sub_circuit_index < sub_circuits.size(); sub_circuit_index++) {
+            sub_circuit_columns.clear();
+            for (auto index: product_scope->sub_circuit_column_indices[sub_circuit_index]) {
+                sub_circuit_columns.push_back(columns[index]);
+            }
+            sub_circuits[sub_circuit_index]->sample_rows(rows, n_rows, sub_circuit_columns, generator);
+        }
+    }
+
+    void probability_of_events(const std::vector<ProductEvent> &events, const ProbabilityMemo &memo,
+                               double *out) const override {
+        std::fill(out, out + events.size(), 1.);
         for (auto &sub_circuit: sub_circuits) {
-            // get the indices of the subcircuit in this circuit
-            auto indices = indices_of_intersection_with_other(sub_circuit);
+            auto &sub_circuit_probabilities = memo.at(sub_circuit.get());
+            for (size_t event = 0; event < events.size(); event++) {
+                out[event] *= sub_circuit_probabilities[event];
+            }
+        }
+    }
+
+    /**
+     * Add the maxima of the subcircuits, whose variables are disjoint.
+     */
+    void max_log_likelihood_of_columns(const ColumnPointers & /*columns*/, size_t n_rows,
+                                       const ColumnPointers &sub_circuit_maxima, double *out, uint32_t * /*argmax*/,
+                                       double * /*scratch*/) const override {
+        std::fill(out, out + n_rows, 0.);
+        for (auto sub_circuit_maximum: sub_circuit_maxima) {
+            for (size_t row = 0; row < n_rows; row++) {
+                out[row] += sub_circuit_maximum[row];
+            }
+        }
+    }
+
+    /**
+     * Pass all rows on to every subcircuit.
+     */
+    void most_probable_rows(const size_t *rows, size_t n_rows, const uint32_t * /*argmax*/,
+                            const std::vector<std::vector<size_t> *> &sub_circuit_rows,
+                            const SampleColumnPointers & /*columns*/) const override {
+        for (auto sub_circuit_row_list: sub_circuit_rows) {
+            sub_circuit_row_list->insert(sub_circuit_row_list->end(), rows, rows + n_rows);
+        }
+    }
+
+    void log_likelihood_of_sub_circuits(const ColumnPointers & /*columns*/, size_t n_rows,
+                                        const ColumnPointers &sub_circuit_log_likelihoods, double *out,
+                                        double * /*scratch*/) const override {
+        std::fill(out, out + n_rows, 0.);
+        for (auto sub_circuit_log_likelihood: sub_circuit_log_likelihoods) {
+            for (size_t row = 0; row < n_rows; row++) {
+                out[row] += sub_circuit_log_likelihood[row];
+            }
+        }
+    }
 
-            // only process the relevant part of this event
-            auto sub_event = std::make_shared<FullEvidence>();
-            for (auto index: indices) {
-                sub_event->push_back(event->at(index));
+    /**
+     * Every row passes through all subcircuits of a product.
+     */
+    void accumulate_expected_counts(const ColumnPointers & /*columns*/, size_t n_rows,
+                                    const double * /*log_likelihoods*/, const double *flows,
+                                    const ColumnPointers & /*sub_circuit_log_likelihoods*/,
+                                    const SampleColumnPointers &sub_circuit_flows,
+                                    double * /*expected_counts*/) const override {
+        for (auto sub_circuit_flow: sub_circuit_flows) {
+            for (size_t row = 0; row < n_rows; row++) {
+                sub_circuit_flow[row] += flows[row];
             }
-            product += sub_circuit->log_likelihood(sub_event);
         }
-        return product;
+    }
+
+    /**
+     * Create a product of the remaining subcircuits or return the only remaining subcircuit.
+     */
+    ProbabilisticCircuitPtr_t
+    marginal_from_sub_circuits(const std::vector<ProbabilisticCircuitPtr_t> &sub_circuit_marginals) const override {
+        std::vector<ProbabilisticCircuitPtr_t> remaining;
+        std::copy_if(sub_circuit_marginals.begin(), sub_circuit_marginals.end(), std::back_inserter(remaining),
+                     [](const ProbabilisticCircuitPtr_t &sub_circuit_marginal) { return sub_circuit_marginal; });
+        if (remaining.size() == 1) {
+            return remaining[0];
+        }
+        auto result = std::make_shared<DecomposableProductUnit>();
+        for (auto &sub_circuit_marginal: remaining) {
+            result->add_subcircuit(sub_circuit_marginal);
+        }
+        return result;
     }
 
     void add_subcircuit(const ProbabilisticCircuitPtr_t &sub_circuit) {
         sub_circuits.push_back(sub_circuit);
+        reset_caches();
     }
 
+    /**
+     * @return The union of the variables of the subcircuits. The set is cached and must not be modified.
+     */
     AbstractVariableSetPtr_t get_variables() const override {
-        auto result = make_shared_variable_set();
+        return scope()->variables;
+    }
+
+    /**
+     * Get the scope of this product.
+     *
+     * The scope is computed on first use and cached until the subcircuits of this product change. Changes to the
+     * variables of a subcircuit after it was added require a call to reset_caches.
+     * Concurrent calls are safe, at worst the scope is computed more than once.
+     *
+     * @return The scope.
+     */
+    ProductScopePtr_t scope() const {
+        auto result = std::atomic_load(&scope_cache);
+        if (result) {
+            return result;
+        }
+        result = compute_scope();
+        std::atomic_store(&scope_cache, result);
+        return result;
+    }
+
+    void reset_caches() override {
+        std::atomic_store(&scope_cache, ProductScopePtr_t());
+    }
+
+private:
+
+    mutable ProductScopePtr_t scope_cache;
+
+    ProductScopePtr_t compute_scope() const {
+        auto result = std::make_shared<ProductScope>();
+        result->variables = make_shared_variable_set();
+
+        std::vector<AbstractVariableSetPtr_t> sub_circuit_variables;
+        sub_circuit_variables.reserve(sub_circuits.size());
         for (auto &sub_circuit: sub_circuits) {
-            auto sub_circuit_variables = sub_circuit->get_variables();
-            result->insert(sub_circuit_variables->begin(), sub_circuit_variables->end());
+            sub_circuit_variables.push_back(sub_circuit->get_variables());
+            result->variables->insert(sub_circuit_variables.back()->begin(), sub_circuit_variables.back()->end());
+        }
+
+        std::vector<AbstractVariablePtr_t> ordered_variables(result->variables->begin(), result->variables->end());
+        for (auto &variables: sub_circuit_variables) {
+            std::vector<size_t> indices;
+            indices.reserve(variables->size());
+            for (auto &variable: *variables) {
+                auto position = std::lower_bound(ordered_variables.begin(), ordered_variables.end(), variable,
+                                                 PointerLess<AbstractVariablePtr_t>());
+                indices.push_back(position - ordered_variables.begin());
+            }
+            result->max_sub_circuit_variables = std::max(result->max_sub_circuit_variables, indices.size());
+            result->sub_circuit_column_indices.push_back(std::move(indices));
         }
         return result;
     }
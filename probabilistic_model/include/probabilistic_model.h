@@ -1,10 +1,14 @@
 #pragma once
 
+#include <map>
 #include <set>
 #include "variable.h"
 #include "sigma_algebra.h"
+#include "profiling.h"
 #include <cmath>
 #include <utility>
+#include <algorithm>
+#include <vector>
 
 
 // TYPEDEFS
@@ -12,6 +16,17 @@ typedef std::shared_ptr<std::set<AbstractVariablePtr_t, PointerLess<AbstractVari
 typedef std::vector<double> FullEvidence;
 typedef std::shared_ptr<FullEvidence> FullEvidencePtr_t;
 
+/**
+ * An event that constrains every variable to a set, e.g. an interval or a set of symbols. Variables that are not in
+ * the map are not constrained.
+ */
+typedef std::map<AbstractVariablePtr_t, AbstractCompositeSetPtr_t, PointerLess<AbstractVariablePtr_t>> ProductEvent;
+
+/**
+ * One pointer per variable to the values of that variable for a block of rows.
+ */
+typedef std::vector<const double *> ColumnPointers;
+
 
 template<typename... Args>
 std::shared_ptr<std::set<AbstractVariablePtr_t, PointerLess<AbstractVariablePtr_t >>>
@@ -52,4 +67,55 @@ public:
         return log(likelihood(event));
     };
 
+    /**
+     * The number of rows that are evaluated at once by log_likelihood_batch.
+     *
+     * Intermediate results of a block have to fit into the cache for the batched evaluation to pay off.
+     */
+    static constexpr size_t batch_block_size = 1024;
+
+    /**
+     * The log-likelihood of a batch of full evidences.
+     *
+     * The data is column-major and the columns are ordered like get_variables(), hence the value of the j-th variable
+     * in row i is `data[j * n_rows + i]`. The rows are processed in blocks of `batch_block_size`.
+     * Models that need a scratch buffer per block should overload this method to allocate it once for all blocks.
+     *
+     * @param data The column-major data.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    virtual void log_likelihood_batch(const double *data, size_t n_rows, double *out) const {
+        auto number_of_variables = get_variables()->size();
+        ColumnPointers columns(number_of_variables);
+        for (size_t block_begin = 0; block_begin < n_rows; block_begin += batch_block_size) {
+            auto block_size = std::min(batch_block_size, n_rows - block_begin);
+            for (size_t column = 0; column < number_of_variables; column++) {
+                columns[column] = data + column * n_rows + block_begin;
+            }
+            log_likelihood_of_columns(columns, block_size, out + block_begin);
+        }
+    }
+
+    /**
+     * The log-likelihood of a block of full evidences given as one pointer per column.
+     *
+     * The columns are ordered like get_variables(). This method has by default calls the log_likelihood method for
+     * every row, models should overload it with a loop over the entire block.
+     *
+     * @param columns The pointers to the columns.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    virtual void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto event = std::make_shared<FullEvidence>(columns.size());
+        for (size_t row = 0; row < n_rows; row++) {
+            for (size_t column = 0; column < columns.size(); column++) {
+                (*event)[column] = columns[column][row];
+            }
+            out[row] = log_likelihood(event);
+        }
+    }
+
 };
\ No newline at end of file
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Instrumentation of circuit evaluation and fitting.
+ *
+ * The hooks in the library are compiled out unless PROBABILISTIC_MODEL_PROFILING is defined for the library and all
+ * code that includes its headers, e.g. by building with `--define profiling=true`. The Profiler itself is always
+ * available, without the hooks its reports are empty.
+ */
+
+
+/**
+ * The accumulated evaluations of one node or of all nodes of one type.
+ */
+struct NodeProfile {
+
+    /**
+     * The address of the node, nullptr for the profile of a type.
+     */
+    const void *node = nullptr;
+
+    /**
+     * The demangled name of the class of the node.
+     */
+    std::string type;
+
+    size_t evaluations = 0;
+
+    /**
+     * The number of rows of all evaluations.
+     */
+    size_t rows = 0;
+
+    /**
+     * The cumulative time of all evaluations, including the time spent in the subcircuits.
+     */
+    double seconds = 0;
+
+};
+
+/**
+ * The accumulated counters of all Nyga Distribution fits.
+ */
+struct FitProfile {
+
+    size_t fits = 0;
+    size_t induction_steps = 0;
+
+    /**
+     * The number of split indices whose log-likelihood was calculated.
+     */
+    size_t candidate_splits = 0;
+
+    /**
+     * The maximal depth of an induction step, the initial step has depth 0.
+     */
+    size_t max_depth = 0;
+
+    double sort_seconds = 0;
+
+    /**
+     * The time spent building frequency tables and prefix sums from samples.
+     */
+    double aggregation_seconds = 0;
+
+    double split_search_seconds = 0;
+
+};
+
+/**
+ * The phases of fitting a Nyga Distribution that are timed.
+ */
+enum class FitPhase {
+    SORT,
+    AGGREGATION,
+    SPLIT_SEARCH
+};
+
+/**
+ * A snapshot of everything the profiler recorded.
+ */
+struct ProfileReport {
+
+    /**
+     * The profiles of all node types, sorted by descending time.
+     */
+    std::vector<NodeProfile> node_types;
+
+    /**
+     * The profiles of all nodes, sorted by descending time.
+     */
+    std::vector<NodeProfile> nodes;
+
+    FitProfile fitting;
+
+    /**
+     * @return The report as a JSON object with the keys "node_types", "nodes" and "fitting".
+     */
+    std::string to_json() const;
+
+    /**
+     * @return The report as human readable tables.
+     */
+    std::string to_text() const;
+
+};
+
+/**
+ * One evaluation of a node, passed to the callback of the profiler.
+ */
+struct NodeEvaluation {
+    const void *node;
+    std::type_index type;
+    size_t rows;
+    double seconds;
+};
+
+typedef std::function<void(const NodeEvaluation &)> NodeEvaluationCallback_t;
+
+
+/**
+ * Class for collecting the records of the profiling hooks of all threads.
+ *
+ * Nodes are identified by their address, hence the profiler should be reset before nodes are freed and others are
+ * evaluated.
+ */
+class Profiler {
+public:
+
+    /**
+     * @return The profiler that the hooks record to.
+     */
+    static Profiler &instance();
+
+    void record_node_evaluation(const void *node, std::type_index type, size_t rows, double seconds);
+
+    void record_fit();
+
+    void record_induction_step(size_t depth);
+
+    void record_candidate_splits(size_t number_of_candidate_splits);
+
+    void record_fit_phase(FitPhase phase, double seconds);
+
+    /**
+     * Set a function that is called with every node evaluation, e.g. to forward it to a tracing system.
+     *
+     * The callback is called on the evaluating thread while the profiler is locked, hence it must not use the
+     * profiler.
+     * @param callback The callback, or nullptr to remove it.
+     */
+    void set_node_evaluation_callback(NodeEvaluationCallback_t callback);
+
+    /**
+     * @return The records so far.
+     */
+    ProfileReport report() const;
+
+    /**
+     * Discard all records. The callback is kept.
+     */
+    void reset();
+
+private:
+
+    mutable std::mutex mutex;
+    std::unordered_map<const void *, std::pair<std::type_index, NodeProfile>> nodes;
+    FitProfile fitting;
+    NodeEvaluationCallback_t node_evaluation_callback;
+
+};
+
+
+/**
+ * Scope guard that records the evaluation of a node when it is destroyed.
+ *
+ * Nested guards of the same node on the same thread, e.g. if an override calls the implementation of its base class,
+ * are inactive such that every evaluation is counted once.
+ */
+class NodeEvaluationTimer {
+public:
+
+    NodeEvaluationTimer(const void *node, std::type_index type, size_t rows) :
+            node(node), type(type), rows(rows), outer_node(current_node) {
+        if (outer_node != node) {
+            current_node = node;
+            begin = std::chrono::steady_clock::now();
+        }
+    }
+
+    NodeEvaluationTimer(const NodeEvaluationTimer &) = delete;
+
+    NodeEvaluationTimer &operator=(const NodeEvaluationTimer &) = delete;
+
+    ~NodeEvaluationTimer() {
+        if (outer_node == node) {
+            return;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        current_node = outer_node;
+        Profiler::instance().record_node_evaluation(node, type, rows, elapsed.count());
+    }
+
+private:
+
+    static thread_local const void *current_node;
+
+    const void *node;
+    std::type_index type;
+    size_t rows;
+    const void *outer_node;
+    std::chrono::steady_clock::time_point begin;
+
+};
+
+
+/**
+ * Scope guard that records the time of a phase of fitting when it is destroyed.
+ */
+class FitPhaseTimer {
+public:
+
+    explicit FitPhaseTimer(FitPhase phase) : phase(phase), begin(std::chrono::steady_clock::now()) {}
+
+    FitPhaseTimer(const FitPhaseTimer &) = delete;
+
+    FitPhaseTimer &operator=(const FitPhaseTimer &) = delete;
+
+    ~FitPhaseTimer() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        Profiler::instance().record_fit_phase(phase, elapsed.count());
+    }
+
+private:
+
+    FitPhase phase;
+    std::chrono::steady_clock::time_point begin;
+
+};
+
+
+#ifdef PROBABILISTIC_MODEL_PROFILING
+#define PROBABILISTIC_MODEL_CONCATENATE_(left, right) left##right
+#define PROBABILISTIC_MODEL_CONCATENATE(left, right) PROBABILISTIC_MODEL_CONCATENATE_(left, right)
+#define PROFILE_NODE_EVALUATION(n_rows) \
+    NodeEvaluationTimer PROBABILISTIC_MODEL_CONCATENATE(node_evaluation_timer_, __LINE__)(this, typeid(*this), n_rows)
+#define PROFILE_FIT_PHASE(phase) \
+    FitPhaseTimer PROBABILISTIC_MODEL_CONCATENATE(fit_phase_timer_, __LINE__)(phase)
+#define PROFILE_FIT() Profiler::instance().record_fit()
+#define PROFILE_INDUCTION_STEP(depth) Profiler::instance().record_induction_step(depth)
+#define PROFILE_CANDIDATE_SPLITS(number_of_candidate_splits) \
+    Profiler::instance().record_candidate_splits(number_of_candidate_splits)
+#else
+#define PROFILE_NODE_EVALUATION(n_rows) ((void) 0)
+#define PROFILE_FIT_PHASE(phase) ((void) 0)
+#define PROFILE_FIT() ((void) 0)
+#define PROFILE_INDUCTION_STEP(depth) ((void) 0)
+#define PROFILE_CANDIDATE_SPLITS(number_of_candidate_splits) ((void) 0)
+#endif
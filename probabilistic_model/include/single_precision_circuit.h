@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "compiled_circuit.h"
+
+//FORWARD DECLARATIONS
+class SinglePrecisionCircuit;
+
+typedef std::shared_ptr<SinglePrecisionCircuit> SinglePrecisionCircuitPtr_t;
+
+/**
+ * Class for evaluating a compiled circuit in single precision.
+ *
+ * Fitting and compiling stay in double precision, the weights and parameters are rounded to float once when this is
+ * constructed and the structure of the tape is shared with the double precision circuit. Floats halve the memory
+ * traffic of the data and the scratch buffers and double the number of rows per SIMD register.
+ *
+ * Every rounding has a relative error of at most 2^-24 and vectorizable_exp(float) adds at most 2e-7 per child of a
+ * sum. In the log domain these become absolute errors, so the log-likelihood of a node deviates from the double
+ * precision result by roughly 2^-23 * (|log-likelihood| + 1) per layer above it. For a circuit of depth d the error of
+ * the root is therefore bounded by about `d * 1.2e-7 * (|log-likelihood| + 1)`, see the tests for a check of this
+ * bound. Values that are within float rounding of the border of a uniform distribution or of the location of a Dirac
+ * delta may fall on the other side of it than in double precision.
+ */
+class SinglePrecisionCircuit {
+public:
+
+    /**
+     * The logarithmic weight of every edge in single precision.
+     */
+    std::vector<float> edge_log_weights;
+
+    /**
+     * The parameters of the leaves in single precision.
+     */
+    std::vector<float> parameters;
+
+    /**
+     * Construct the single precision version of a compiled or mapped circuit.
+     * @throws std::invalid_argument if a discrete leaf has codes that are not exactly representable as float.
+     * @param model The CompiledCircuit or MappedCircuit that owns the arrays of the tape.
+     * @param circuit_tape The tape of the model.
+     */
+    SinglePrecisionCircuit(std::shared_ptr<const ProbabilisticModel> model, const CircuitTape &circuit_tape);
+
+    /**
+     * Compile a circuit and construct its single precision version.
+     * @throws std::invalid_argument if the circuit cannot be compiled or a discrete leaf has codes that are not exactly
+     * representable as float.
+     * @param circuit The root of the circuit.
+     */
+    explicit SinglePrecisionCircuit(const ProbabilisticCircuitPtr_t &circuit);
+
+    /**
+     * @return The view of the arrays of this circuit.
+     */
+    FloatCircuitTape tape() const;
+
+    size_t number_of_nodes() const {
+        return circuit_tape.number_of_nodes;
+    }
+
+    /**
+     * The log-likelihood of a batch of full evidences in single precision.
+     *
+     * The data is column-major with the columns ordered like the variables of the circuit, see
+     * ProbabilisticModel::log_likelihood_batch. The rows are processed in blocks of
+     * ProbabilisticModel::batch_block_size.
+     * @param data The column-major data.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    void log_likelihood_batch(const float *data, size_t n_rows, float *out) const;
+
+    template<typename... Args>
+    static SinglePrecisionCircuitPtr_t make_shared(Args &&... args) {
+        return std::make_shared<SinglePrecisionCircuit>(std::forward<Args>(args)...);
+    };
+
+private:
+
+    /**
+     * The model that owns the structure of the tape.
+     */
+    std::shared_ptr<const ProbabilisticModel> model;
+
+    /**
+     * The tape in double precision.
+     */
+    CircuitTape circuit_tape;
+
+    /**
+     * Round the weights and parameters of the tape to float.
+     */
+    void convert();
+
+};
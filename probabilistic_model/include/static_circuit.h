@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "log_sum_exp.h"
+#include "probabilistic_circuit.h"
+#include "univariate.h"
+
+/**
+ * Circuits whose structure is fixed at compile time.
+ *
+ * The structure is spelled as nested types, e.g. a mixture of four products of two uniform distributions and a
+ * discrete distribution over at most three codes is
+ *
+ *     StaticCircuit<StaticMixture<StaticProduct<StaticUniform, StaticUniform, StaticDiscrete<3>>, 4>>
+ *
+ * Every node stores its parameters by value in fixed-size arrays and evaluates its children without virtual calls,
+ * hence the compiler inlines the evaluation of the entire circuit. The parameters are copied from a runtime circuit of
+ * the same shape, which keeps fitting and all other queries on the runtime circuit.
+ *
+ * Every node type provides
+ *
+ * - `void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables)` that copies
+ *   the parameters of a runtime node and throws std::invalid_argument if the shapes do not match, and
+ * - `double log_likelihood(const double *values, size_t stride) const` that reads the value of the variable in column
+ *   j from `values[j * stride]`.
+ */
+
+
+/**
+ * @throws std::invalid_argument always.
+ * @param node The runtime node that does not match.
+ * @param expected The description of the expected node.
+ */
+[[noreturn]] inline void throw_static_circuit_mismatch(const ProbabilisticCircuit &node, const std::string &expected) {
+    throw std::invalid_argument("Expected " + expected + " but got " + node.representation());
+}
+
+/**
+ * @throws std::invalid_argument if the node is not a univariate distribution.
+ * @param node The runtime node.
+ * @param expected The description of the expected leaf.
+ * @return The node as leaf.
+ */
+inline const UnivariateDistribution &
+static_circuit_leaf(const ProbabilisticCircuit &node, const std::string &expected) {
+    auto leaf = dynamic_cast<const UnivariateDistribution *>(&node);
+    if (leaf == nullptr) {
+        throw_static_circuit_mismatch(node, expected);
+    }
+    return *leaf;
+}
+
+/**
+ * @param leaf The runtime leaf.
+ * @param variables The sorted variables of the root.
+ * @return The column of the variable of the leaf.
+ */
+inline size_t static_circuit_column(const UnivariateDistribution &leaf,
+                                    const std::vector<AbstractVariablePtr_t> &variables) {
+    auto column = std::lower_bound(variables.begin(), variables.end(), leaf.variable,
+                                   PointerLess<AbstractVariablePtr_t>());
+    return (size_t) (column - variables.begin());
+}
+
+
+/**
+ * A uniform distribution over one interval.
+ */
+class StaticUniform {
+public:
+    size_t column = 0;
+    double lower = 0;
+    double upper = 0;
+    double log_density = 0;
+    bool left_closed = true;
+    bool right_closed = true;
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        auto uniform = dynamic_cast<const UniformDistribution *>(&static_circuit_leaf(node, "a uniform distribution"));
+        if (uniform == nullptr || uniform->support->simple_sets->size() != 1) {
+            throw_static_circuit_mismatch(node, "a uniform distribution over one interval");
+        }
+        auto interval = std::static_pointer_cast<SimpleInterval<double>>(*uniform->support->simple_sets->begin());
+        column = static_circuit_column(*uniform, variables);
+        lower = interval->lower;
+        upper = interval->upper;
+        log_density = log(uniform->pdf_value());
+        left_closed = interval->left == BorderType::CLOSED;
+        right_closed = interval->right == BorderType::CLOSED;
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        auto value = values[column * stride];
+        bool inside_left = left_closed ? value >= lower : value > lower;
+        bool inside_right = right_closed ? value <= upper : value < upper;
+        return inside_left && inside_right ? log_density : -std::numeric_limits<double>::infinity();
+    }
+};
+
+
+class StaticDiracDelta {
+public:
+    size_t column = 0;
+    double location = 0;
+    double log_density_cap = 0;
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        auto dirac_delta = dynamic_cast<const DiracDeltaDistribution *>(
+                &static_circuit_leaf(node, "a Dirac delta distribution"));
+        if (dirac_delta == nullptr) {
+            throw_static_circuit_mismatch(node, "a Dirac delta distribution");
+        }
+        column = static_circuit_column(*dirac_delta, variables);
+        location = dirac_delta->location;
+        log_density_cap = log(dirac_delta->density_cap);
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        return values[column * stride] == location ? log_density_cap : -std::numeric_limits<double>::infinity();
+    }
+};
+
+
+/**
+ * A discrete distribution whose codes span at most MaxCodes consecutive integers.
+ */
+template<size_t MaxCodes>
+class StaticDiscrete {
+public:
+    size_t column = 0;
+    long first_code = 0;
+    long number_of_codes = 0;
+
+    /**
+     * The log-probabilities of the codes `first_code, ..., first_code + number_of_codes - 1`.
+     */
+    std::array<double, MaxCodes> log_probabilities{};
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        auto expected = "a discrete distribution over at most " + std::to_string(MaxCodes) + " codes";
+        auto discrete = dynamic_cast<const DiscreteDistribution *>(&static_circuit_leaf(node, expected));
+        if (discrete == nullptr) {
+            throw_static_circuit_mismatch(node, expected);
+        }
+        column = static_circuit_column(*discrete, variables);
+        number_of_codes = 0;
+        if (discrete->probabilities.empty()) {
+            return;
+        }
+        first_code = discrete->probabilities.begin()->first;
+        number_of_codes = (long) discrete->probabilities.rbegin()->first - first_code + 1;
+        if (number_of_codes > (long) MaxCodes) {
+            throw_static_circuit_mismatch(node, expected);
+        }
+        for (long code = 0; code < number_of_codes; code++) {
+            log_probabilities[code] = log(discrete->pmf((int) (first_code + code)));
+        }
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        auto code = (long) (int) values[column * stride] - first_code;
+        return code >= 0 && code < number_of_codes ? log_probabilities[code]
+                                                   : -std::numeric_limits<double>::infinity();
+    }
+};
+
+
+/**
+ * A decomposable product of differently shaped children.
+ */
+template<typename... Children>
+class StaticProduct {
+public:
+    static_assert(sizeof...(Children) > 0, "A product needs at least one child");
+
+    static constexpr size_t number_of_children = sizeof...(Children);
+
+    std::tuple<Children...> children;
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        if (dynamic_cast<const DecomposableProductUnit *>(&node) == nullptr ||
+            node.sub_circuits.size() != number_of_children) {
+            throw_static_circuit_mismatch(node, "a product of " + std::to_string(number_of_children) + " children");
+        }
+        assign_children(node, variables, std::index_sequence_for<Children...>());
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        return log_likelihood(values, stride, std::index_sequence_for<Children...>());
+    }
+
+private:
+
+    template<size_t... Indices>
+    void assign_children(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables,
+                         std::index_sequence<Indices...>) {
+        (std::get<Indices>(children).assign(*node.sub_circuits[Indices], variables), ...);
+    }
+
+    template<size_t... Indices>
+    double log_likelihood(const double *values, size_t stride, std::index_sequence<Indices...>) const {
+        return (0. + ... + std::get<Indices>(children).log_likelihood(values, stride));
+    }
+};
+
+
+/**
+ * A smooth sum of differently shaped children.
+ */
+template<typename... Children>
+class StaticSum {
+public:
+    static_assert(sizeof...(Children) > 0, "A sum needs at least one child");
+
+    static constexpr size_t number_of_children = sizeof...(Children);
+
+    std::tuple<Children...> children;
+    std::array<double, number_of_children> log_weights{};
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        auto sum = dynamic_cast<const SmoothSumUnit *>(&node);
+        if (sum == nullptr || sum->sub_circuits.size() != number_of_children) {
+            throw_static_circuit_mismatch(node, "a sum of " + std::to_string(number_of_children) + " children");
+        }
+        for (size_t index = 0; index < number_of_children; index++) {
+            log_weights[index] = log(sum->weights[index]);
+        }
+        assign_children(node, variables, std::index_sequence_for<Children...>());
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        return log_likelihood(values, stride, std::index_sequence_for<Children...>());
+    }
+
+private:
+
+    template<size_t... Indices>
+    void assign_children(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables,
+                         std::index_sequence<Indices...>) {
+        (std::get<Indices>(children).assign(*node.sub_circuits[Indices], variables), ...);
+    }
+
+    template<size_t... Indices>
+    double log_likelihood(const double *values, size_t stride, std::index_sequence<Indices...>) const {
+        std::array<double, number_of_children> weighted{
+                (log_weights[Indices] + std::get<Indices>(children).log_likelihood(values, stride))...};
+        return log_sum_exp(weighted.data(), number_of_children);
+    }
+};
+
+
+/**
+ * A smooth sum of NumberOfComponents children of the same shape.
+ */
+template<typename Component, size_t NumberOfComponents>
+class StaticMixture {
+public:
+    static_assert(NumberOfComponents > 0, "A mixture needs at least one component");
+
+    std::array<Component, NumberOfComponents> components;
+    std::array<double, NumberOfComponents> log_weights{};
+
+    void assign(const ProbabilisticCircuit &node, const std::vector<AbstractVariablePtr_t> &variables) {
+        auto sum = dynamic_cast<const SmoothSumUnit *>(&node);
+        if (sum == nullptr || sum->sub_circuits.size() != NumberOfComponents) {
+            throw_static_circuit_mismatch(node, "a sum of " + std::to_string(NumberOfComponents) + " children");
+        }
+        for (size_t index = 0; index < NumberOfComponents; index++) {
+            log_weights[index] = log(sum->weights[index]);
+            components[index].assign(*sum->sub_circuits[index], variables);
+        }
+    }
+
+    double log_likelihood(const double *values, size_t stride) const {
+        std::array<double, NumberOfComponents> weighted;
+        for (size_t index = 0; index < NumberOfComponents; index++) {
+            weighted[index] = log_weights[index] + components[index].log_likelihood(values, stride);
+        }
+        return log_sum_exp(weighted.data(), NumberOfComponents);
+    }
+};
+
+
+/**
+ * Class for the root of a circuit whose structure is fixed at compile time.
+ *
+ * This is deliberately not a ProbabilisticModel, such that calls are not dispatched virtually.
+ */
+template<typename Root>
+class StaticCircuit {
+public:
+
+    Root root;
+
+    /**
+     * The variables of the circuit. The order defines the order of the columns.
+     */
+    std::vector<AbstractVariablePtr_t> variables;
+
+    /**
+     * Copy the parameters of a runtime circuit.
+     * @throws std::invalid_argument if the runtime circuit does not have the shape of Root.
+     * @param circuit The root of the runtime circuit.
+     */
+    explicit StaticCircuit(const ProbabilisticCircuitPtr_t &circuit) {
+        auto variable_set = circuit->get_variables();
+        variables.assign(variable_set->begin(), variable_set->end());
+        root.assign(*circuit, variables);
+    }
+
+    /**
+     * The log-likelihood of one full evidence.
+     * @param row The values ordered like the variables.
+     * @return The log-likelihood.
+     */
+    double log_likelihood(const double *row) const {
+        return root.log_likelihood(row, 1);
+    }
+
+    /**
+     * The log-likelihood of a batch of full evidences.
+     * @param data The column-major data, see ProbabilisticModel::log_likelihood_batch.
+     * @param n_rows The number of rows.
+     * @param out The array of size n_rows to write the log-likelihoods to.
+     */
+    void log_likelihood_batch(const double *data, size_t n_rows, double *out) const {
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = root.log_likelihood(data + row, n_rows);
+        }
+    }
+
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//FORWARD DECLARATIONS
+class ThreadPool;
+
+typedef std::shared_ptr<ThreadPool> ThreadPoolPtr_t;
+typedef std::function<void()> Task_t;
+
+/**
+ * Class for a work-stealing thread pool.
+ *
+ * Every worker owns a double ended queue of tasks. Tasks submitted from inside a worker are pushed to the back of the
+ * queue of that worker and popped from the back again, such that recursive work is processed depth first and stays
+ * cache local. Idle workers steal from the front of the queues of the other workers.
+ */
+class ThreadPool {
+public:
+
+    /**
+     * Construct a thread pool and start its workers.
+     * @param number_of_threads The number of worker threads. If 0, the number of hardware threads is used.
+     */
+    explicit ThreadPool(size_t number_of_threads);
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Wait for all pending tasks and join the workers.
+     */
+    ~ThreadPool();
+
+    /**
+     * Schedule a task for execution.
+     *
+     * This may be called from inside a task.
+     * @param task The task.
+     */
+    void submit(Task_t task);
+
+    /**
+     * Block until every submitted task, including tasks submitted by other tasks, has finished.
+     *
+     * If a task threw an exception, the first exception is rethrown here.
+     */
+    void wait();
+
+    /**
+     * @return The number of worker threads.
+     */
+    size_t size() const {
+        return threads.size();
+    }
+
+    /**
+     * @return The index of the worker that executes the calling thread, or `size()` if the caller is not a worker of
+     * this pool.
+     */
+    size_t current_worker_index() const;
+
+    /**
+     * Restrict all workers to a set of CPUs, e.g. the CPUs of one NUMA node.
+     *
+     * The workers may still migrate between the CPUs of the set.
+     * @throws std::invalid_argument if the set is empty.
+     * @throws std::runtime_error if the affinity cannot be set or the platform does not support it.
+     * @param cpus The indices of the CPUs.
+     */
+    void pin_workers(const std::vector<size_t> &cpus);
+
+    template<typename... Args>
+    static ThreadPoolPtr_t make_shared(Args &&... args) {
+        return std::make_shared<ThreadPool>(std::forward<Args>(args)...);
+    };
+
+private:
+
+    struct WorkerQueue {
+        std::deque<Task_t> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+
+    /**
+     * The number of tasks that are queued but not yet started.
+     */
+    std::atomic<size_t> queued_tasks{0};
+
+    /**
+     * The number of tasks that are queued or running.
+     */
+    std::atomic<size_t> pending_tasks{0};
+
+    std::atomic<size_t> next_queue{0};
+
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_tasks_done;
+    bool stopping = false;
+    std::exception_ptr first_exception;
+
+    void run_worker(size_t worker_index);
+
+    bool try_pop(size_t worker_index, Task_t &task);
+
+};
+
+
+/**
+ * The CPUs of a NUMA node as listed by the kernel in `/sys/devices/system/node/node<numa_node>/cpulist`.
+ * @throws std::invalid_argument if the node does not exist or the platform does not expose NUMA nodes.
+ * @param numa_node The index of the NUMA node.
+ * @return The indices of the CPUs in ascending order.
+ */
+std::vector<size_t> cpus_of_numa_node(size_t numa_node);
+
+/**
+ * Parse a CPU list in the format of the kernel, e.g. "0-3,8,10-11".
+ * @throws std::invalid_argument if the list is malformed.
+ * @param cpu_list The list.
+ * @return The indices of the CPUs in the order of the list.
+ */
+std::vector<size_t> parse_cpu_list(const std::string &cpu_list);
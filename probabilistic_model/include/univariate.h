@@ -7,6 +7,9 @@
 #include <cmath>
 #include <utility>
 #include <map>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
 
 //FORWARD DECLARATIONS
 class UniformDistribution;
@@ -42,6 +45,69 @@ public:
         return *variable->name + " ~ " + distribution_representation();
     }
 
+    /**
+     * Calculate the probability that the variable of this distribution takes a value in a set.
+     *
+     * This method has by default throws a std::logic_error, every distribution that supports probability queries has
+     * to overload it.
+     * @param set The set, an interval for numeric variables and a set of elements for symbolic variables.
+     * @return The probability.
+     */
+    virtual double probability_of_set(const AbstractCompositeSetPtr_t & /*set*/) const {
+        throw std::logic_error("Probability queries are not implemented for " + representation());
+    }
+
+    /**
+     * Get a value of maximal density or probability.
+     *
+     * This method has by default throws a std::logic_error, every distribution that supports max-product inference
+     * has to overload it.
+     * @return The mode.
+     */
+    virtual double mode() const {
+        throw std::logic_error("Max-product inference is not implemented for " + representation());
+    }
+
+    /**
+     * Evaluate observed values as they are and missing values at the mode.
+     */
+    void max_log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows,
+                                       const ColumnPointers & /*sub_circuit_maxima*/, double *out,
+                                       uint32_t * /*argmax*/, double *scratch) const override {
+        auto values = columns[0];
+        auto mode_value = mode();
+        for (size_t row = 0; row < n_rows; row++) {
+            scratch[row] = std::isnan(values[row]) ? mode_value : values[row];
+        }
+        log_likelihood_of_columns(ColumnPointers{scratch}, n_rows, out);
+    }
+
+    /**
+     * Write the mode to the rows whose value is missing.
+     */
+    void most_probable_rows(const size_t *rows, size_t n_rows, const uint32_t * /*argmax*/,
+                            const std::vector<std::vector<size_t> *> & /*sub_circuit_rows*/,
+                            const SampleColumnPointers &columns) const override {
+        auto values = columns[0];
+        auto mode_value = mode();
+        for (size_t index = 0; index < n_rows; index++) {
+            auto &value = values[rows[index]];
+            value = std::isnan(value) ? mode_value : value;
+        }
+    }
+
+    /**
+     * Calculate the probability of the constraint of every event on the variable of this distribution. Events that
+     * do not constrain the variable have probability 1.
+     */
+    void probability_of_events(const std::vector<ProductEvent> &events, const ProbabilityMemo & /*memo*/,
+                               double *out) const override {
+        for (size_t index = 0; index < events.size(); index++) {
+            auto constraint = events[index].find(variable);
+            out[index] = constraint == events[index].end() ? 1. : probability_of_set(constraint->second);
+        }
+    }
+
 };
 
 
@@ -51,30 +117,284 @@ public:
 class DiscreteDistribution : public UnivariateDistribution {
 public:
 
-    std::map<int, double> probabilities;
+    /**
+     * The number of codes up to which the dense representation is always used. Larger ranges of codes are only
+     * stored densely if at most `max_dense_codes_per_probability` codes per entry of `probabilities` are needed.
+     */
+    static constexpr size_t min_dense_codes = 64;
+    static constexpr size_t max_dense_codes_per_probability = 4;
+
+    /**
+     * The probability of every code with an entry. This is a read-only view, use set_probabilities to change them.
+     */
+    const std::map<int, double> &probabilities = probability_map;
 
     explicit DiscreteDistribution(const AbstractVariablePtr_t &variable) {
         this->variable = variable;
-        probabilities = std::map<int, double>();
     }
 
     DiscreteDistribution(const AbstractVariablePtr_t &variable, std::map<int, double> probabilities) {
         this->variable = variable;
-        this->probabilities = std::move(probabilities);
+        probability_map = std::move(probabilities);
+        update_dense_probabilities();
+    }
+
+    /**
+     * Copy the probabilities of another distribution. The view `probabilities` refers to the copy, the alias table
+     * is rebuilt lazily.
+     */
+    DiscreteDistribution(const DiscreteDistribution &other) : UnivariateDistribution(other),
+                                                              probability_map(other.probability_map) {
+        update_dense_probabilities();
+    }
+
+    DiscreteDistribution &operator=(const DiscreteDistribution &other) {
+        UnivariateDistribution::operator=(other);
+        probability_map = other.probability_map;
+        update_dense_probabilities();
+        std::atomic_store(&alias_table_cache, std::shared_ptr<const CodeAliasTable>());
+        return *this;
+    }
+
+    /**
+     * Replace the probabilities and rebuild all representations that are derived from them.
+     * @param probabilities The probability of every code with an entry.
+     */
+    void set_probabilities(std::map<int, double> probabilities) {
+        probability_map = std::move(probabilities);
+        reset_caches();
     }
 
     double log_likelihood(const FullEvidencePtr_t &event) const override {
+        PROFILE_NODE_EVALUATION(1);
+        if (is_dense()) {
+            return log_pmf_of_dense_code((long) (int) event->at(0) - dense_first_code);
+        }
         return log(pmf(event->at(0)));
     }
 
+    /**
+     * Gather the log-probabilities of a column of codes from the dense representation.
+     */
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto values = columns[0];
+        if (!is_dense()) {
+            for (size_t row = 0; row < n_rows; row++) {
+                out[row] = log(pmf((int) values[row]));
+            }
+            return;
+        }
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = log_pmf_of_dense_code((long) (int) values[row] - dense_first_code);
+        }
+    }
+
     double pmf(int value) const {
-        auto key = probabilities.find(value);
-        if (key == probabilities.end()) {
+        if (is_dense()) {
+            auto code = (long) value - dense_first_code;
+            bool is_inside = code >= 0 && code < (long) dense_probability_values.size();
+            return is_inside ? dense_probability_values[code] : 0.;
+        }
+        auto key = probability_map.find(value);
+        if (key == probability_map.end()) {
             return 0;
         }
         return key->second;
     }
 
+    /**
+     * @return Whether the probabilities are stored densely.
+     */
+    bool is_dense() const {
+        return !dense_probability_values.empty();
+    }
+
+    /**
+     * @return The smallest code of the dense representation.
+     */
+    int first_code() const {
+        return dense_first_code;
+    }
+
+    /**
+     * @return The probabilities of all codes from first_code() to the largest code, empty if the codes are too sparse
+     * for a dense representation.
+     */
+    const std::vector<double> &dense_probabilities() const {
+        return dense_probability_values;
+    }
+
+    /**
+     * @return The logarithms of dense_probabilities().
+     */
+    const std::vector<double> &dense_log_probabilities() const {
+        return dense_log_probability_values;
+    }
+
+    /**
+     * @return The code with the highest probability, the smallest one if there are multiple.
+     */
+    double mode() const override {
+        if (probability_map.empty()) {
+            throw std::logic_error("The mode of a discrete distribution without probabilities is undefined.");
+        }
+        auto most_probable = std::max_element(probability_map.begin(), probability_map.end(),
+                                              [](const std::pair<const int, double> &left,
+                                                 const std::pair<const int, double> &right) {
+                                                  return left.second < right.second;
+                                              });
+        return most_probable->first;
+    }
+
+    /**
+     * One count per code of the dense representation, or per entry of `probabilities` if it is not dense.
+     */
+    size_t number_of_expected_counts() const override {
+        return is_dense() ? dense_probability_values.size() : probability_map.size();
+    }
+
+    void accumulate_expected_counts(const ColumnPointers &columns, size_t n_rows, const double * /*log_likelihoods*/,
+                                    const double *flows, const ColumnPointers & /*sub_circuit_log_likelihoods*/,
+                                    const SampleColumnPointers & /*sub_circuit_flows*/,
+                                    double *expected_counts) const override {
+        auto values = columns[0];
+        if (is_dense()) {
+            auto number_of_codes = (long) dense_probability_values.size();
+            for (size_t row = 0; row < n_rows; row++) {
+                auto code = (long) (int) values[row] - dense_first_code;
+                if (code >= 0 && code < number_of_codes) {
+                    expected_counts[code] += flows[row];
+                }
+            }
+            return;
+        }
+
+        // the position of a code in the sorted codes is its position in the map
+        std::vector<int> codes;
+        codes.reserve(probability_map.size());
+        for (auto &entry: probability_map) {
+            codes.push_back(entry.first);
+        }
+        for (size_t row = 0; row < n_rows; row++) {
+            auto code = std::lower_bound(codes.begin(), codes.end(), (int) values[row]);
+            if (code != codes.end() && *code == (int) values[row]) {
+                expected_counts[code - codes.begin()] += flows[row];
+            }
+        }
+    }
+
+    void maximize_expected_counts(const double *expected_counts) override {
+        auto total = std::accumulate(expected_counts, expected_counts + number_of_expected_counts(), 0.);
+        if (total <= 0) {
+            return;
+        }
+        size_t index = 0;
+        for (auto &[code, probability]: probability_map) {
+            probability = expected_counts[is_dense() ? code - dense_first_code : index++] / total;
+        }
+        reset_caches();
+    }
+
+    /**
+     * The codes of a discrete distribution and the alias table of their probabilities.
+     */
+    struct CodeAliasTable {
+        std::vector<int> codes;
+        AliasTable table;
+    };
+
+    /**
+     * Get the alias table of the probabilities.
+     *
+     * The table is built on first use and cached until the probabilities are set again.
+     * Concurrent calls are safe, at worst the table is built more than once.
+     *
+     * @return The codes and their alias table.
+     */
+    std::shared_ptr<const CodeAliasTable> alias_table() const {
+        auto result = std::atomic_load(&alias_table_cache);
+        if (result) {
+            return result;
+        }
+        std::vector<int> codes;
+        std::vector<double> code_probabilities;
+        for (auto &[code, probability]: probability_map) {
+            codes.push_back(code);
+            code_probabilities.push_back(probability);
+        }
+        result = std::make_shared<const CodeAliasTable>(CodeAliasTable{std::move(codes),
+                                                                        AliasTable(code_probabilities)});
+        std::atomic_store(&alias_table_cache, result);
+        return result;
+    }
+
+    void sample_rows(const size_t *rows, size_t n_rows, const SampleColumnPointers &columns,
+                     RandomGenerator_t &generator) const override {
+        auto code_alias_table = alias_table();
+        auto values = columns[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            values[rows[row]] = code_alias_table->codes[code_alias_table->table.draw(generator)];
+        }
+    }
+
+    void reset_caches() override {
+        update_dense_probabilities();
+        std::atomic_store(&alias_table_cache, std::shared_ptr<const CodeAliasTable>());
+    }
+
+private:
+
+    /**
+     * The probability of every code with an entry. It is private such that the dense representation and the alias
+     * table cannot get out of sync with it.
+     */
+    std::map<int, double> probability_map;
+
+    /**
+     * The dense representation of `probability_map`, kept in sync with it by the constructors, set_probabilities and
+     * reset_caches.
+     */
+    int dense_first_code = 0;
+    std::vector<double> dense_probability_values;
+    std::vector<double> dense_log_probability_values;
+
+    mutable std::shared_ptr<const CodeAliasTable> alias_table_cache;
+
+    /**
+     * Rebuild the dense representation from `probability_map`.
+     */
+    void update_dense_probabilities() {
+        dense_probability_values.clear();
+        dense_log_probability_values.clear();
+        if (probability_map.empty()) {
+            return;
+        }
+        dense_first_code = probability_map.begin()->first;
+        auto number_of_codes = (size_t) ((long) probability_map.rbegin()->first - dense_first_code + 1);
+        if (number_of_codes > min_dense_codes &&
+            number_of_codes > max_dense_codes_per_probability * probability_map.size()) {
+            return;
+        }
+        dense_probability_values.assign(number_of_codes, 0.);
+        for (auto &[code, probability]: probability_map) {
+            dense_probability_values[code - dense_first_code] = probability;
+        }
+        dense_log_probability_values.resize(number_of_codes);
+        std::transform(dense_probability_values.begin(), dense_probability_values.end(),
+                       dense_log_probability_values.begin(), [](double probability) { return log(probability); });
+    }
+
+    /**
+     * @param code The code minus `dense_first_code`.
+     * @return The log-probability of the code, -inf for codes outside of the dense representation.
+     */
+    double log_pmf_of_dense_code(long code) const {
+        bool is_inside = code >= 0 && code < (long) dense_log_probability_values.size();
+        return is_inside ? dense_log_probability_values[is_inside ? code : 0]
+                         : -std::numeric_limits<double>::infinity();
+    }
+
 };
 
 /**
@@ -99,6 +419,14 @@ public:
         return result;
     }
 
+    double probability_of_set(const AbstractCompositeSetPtr_t &set) const override {
+        double result = 0;
+        for (auto &simple_set: *set->simple_sets) {
+            result += pmf(std::static_pointer_cast<SetElement>(simple_set)->element_index);
+        }
+        return result;
+    }
+
     std::string distribution_representation() const override{
         std::string result = "Nominal(";
         for (auto &[value, probability]: probabilities) {
@@ -129,6 +457,25 @@ public:
         return result;
     }
 
+    /**
+     * Sum the probabilities of the values inside every simple interval of the set.
+     */
+    double probability_of_set(const AbstractCompositeSetPtr_t &set) const override {
+        double result = 0;
+        for (auto &simple_set: *set->simple_sets) {
+            auto interval = std::static_pointer_cast<SimpleInterval<int>>(simple_set);
+            for (auto value = probabilities.lower_bound(interval->lower);
+                 value != probabilities.end() && value->first <= interval->upper; value++) {
+                bool inside_left = interval->left == BorderType::CLOSED || value->first > interval->lower;
+                bool inside_right = interval->right == BorderType::CLOSED || value->first < interval->upper;
+                if (inside_left && inside_right) {
+                    result += value->second;
+                }
+            }
+        }
+        return result;
+    }
+
     std::string distribution_representation() const override{
         std::string result = "Ordinal(";
         for (auto &[value, probability]: probabilities) {
@@ -152,11 +499,46 @@ public:
     ContinuousSupportPtr_t support = reals();
 
     double log_likelihood(const FullEvidencePtr_t &event) const override {
+        PROFILE_NODE_EVALUATION(1);
         return log_pdf(event->at(0));
     }
 
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto values = columns[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = log_pdf(values[row]);
+        }
+    }
+
     virtual double log_pdf(double value) const = 0;
 
+    /**
+     * The derivative of the logarithmic density.
+     *
+     * By default this method returns 0, which is correct almost everywhere for piecewise constant densities like
+     * the uniform and Dirac delta distributions. Distributions with smooth densities have to overload it.
+     * @param value The value.
+     * @return The derivative of log_pdf at the value.
+     */
+    virtual double log_pdf_derivative(double /*value*/) const {
+        return 0;
+    }
+
+    /**
+     * Add the derivative of the log-density weighted by the flow of every row.
+     */
+    void accumulate_gradients(const ColumnPointers &columns, size_t n_rows, const double * /*log_likelihoods*/,
+                              const double *flows, const ColumnPointers & /*sub_circuit_log_likelihoods*/,
+                              double * /*weight_gradients*/,
+                              const SampleColumnPointers &input_gradients) const override {
+        auto values = columns[0];
+        auto gradients = input_gradients[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            gradients[row] += flows[row] > 0 ? flows[row] * log_pdf_derivative(values[row]) : 0.;
+        }
+    }
+
     AbstractCompositeSetPtr_t get_support() const override {
         return support;
     }
@@ -183,10 +565,46 @@ public:
         return value == location ? density_cap : 0;
     }
 
+    double mode() const override {
+        return location;
+    }
+
     double log_pdf(double value) const override {
         return log(pdf(value));
     }
 
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+        auto values = columns[0];
+        auto log_density_cap = log(density_cap);
+        auto minus_infinity = -std::numeric_limits<double>::infinity();
+        for (size_t row = 0; row < n_rows; row++) {
+            out[row] = values[row] == location ? log_density_cap : minus_infinity;
+        }
+    }
+
+    void sample_rows(const size_t *rows, size_t n_rows, const SampleColumnPointers &columns,
+                     RandomGenerator_t & /*generator*/) const override {
+        auto values = columns[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            values[rows[row]] = location;
+        }
+    }
+
+    double probability_of_set(const AbstractCompositeSetPtr_t &set) const override {
+        for (auto &simple_set: *set->simple_sets) {
+            auto interval = std::static_pointer_cast<SimpleInterval<double>>(simple_set);
+            bool inside_left = interval->left == BorderType::CLOSED ? location >= interval->lower :
+                               location > interval->lower;
+            bool inside_right = interval->right == BorderType::CLOSED ? location <= interval->upper :
+                                location < interval->upper;
+            if (inside_left && inside_right) {
+                return 1.;
+            }
+        }
+        return 0.;
+    }
+
     AbstractCompositeSetPtr_t get_support() const override {
         return singleton(location);
     }
@@ -216,6 +634,14 @@ public:
         return 1 / (support->upper() - this->support->lower());
     }
 
+    /**
+     * @return The center of the first interval of the support, the density is the same everywhere in the support.
+     */
+    double mode() const override {
+        auto interval = std::static_pointer_cast<SimpleInterval<double>>(*support->simple_sets->begin());
+        return (interval->lower + interval->upper) / 2;
+    }
+
     double log_pdf(double value) const override {
         if (support->contains(value)) {
             return log(pdf_value());
@@ -223,6 +649,87 @@ public:
         return -std::numeric_limits<double>::infinity();
     }
 
+    void log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const override {
+        PROFILE_NODE_EVALUATION(n_rows);
+
+        // fall back to the generic containment check for supports made of multiple intervals
+        if (support->simple_sets->size() != 1) {
+            ContinuousDistribution::log_likelihood_of_columns(columns, n_rows, out);
+            return;
+        }
+
+        auto interval = std::static_pointer_cast<SimpleInterval<double>>(*support->simple_sets->begin());
+        auto lower = interval->lower;
+        auto upper = interval->upper;
+        auto left_closed = interval->left == BorderType::CLOSED;
+        auto right_closed = interval->right == BorderType::CLOSED;
+        auto log_density = log(pdf_value());
+        auto minus_infinity = -std::numeric_limits<double>::infinity();
+
+        auto values = columns[0];
+        for (size_t row = 0; row < n_rows; row++) {
+            auto value = values[row];
+            bool inside_left = left_closed ? value >= lower : value > lower;
+            bool inside_right = right_closed ? value <= upper : value < upper;
+            out[row] = inside_left && inside_right ? log_density : minus_infinity;
+        }
+    }
+
+    /**
+     * Calculate the length of the intersection of the support and the set in one sweep over both sorted lists of
+     * simple intervals and multiply it with the density.
+     */
+    double probability_of_set(const AbstractCompositeSetPtr_t &set) const override {
+        auto support_interval = support->simple_sets->begin();
+        auto set_interval = set->simple_sets->begin();
+        double intersection_length = 0;
+        while (support_interval != support->simple_sets->end() && set_interval != set->simple_sets->end()) {
+            auto support_simple_interval = std::static_pointer_cast<SimpleInterval<double>>(*support_interval);
+            auto set_simple_interval = std::static_pointer_cast<SimpleInterval<double>>(*set_interval);
+            auto lower = std::max(support_simple_interval->lower, set_simple_interval->lower);
+            auto upper = std::min(support_simple_interval->upper, set_simple_interval->upper);
+            intersection_length += std::max(0., upper - lower);
+
+            // advance the interval that ends first
+            if (support_simple_interval->upper < set_simple_interval->upper) {
+                support_interval++;
+            } else {
+                set_interval++;
+            }
+        }
+        return intersection_length * pdf_value();
+    }
+
+    /**
+     * Draw uniformly from the support. For supports made of multiple intervals, an interval is drawn with a
+     * probability proportional to its length first.
+     */
+    void sample_rows(const size_t *rows, size_t n_rows, const SampleColumnPointers &columns,
+                     RandomGenerator_t &generator) const override {
+        std::vector<double> lowers;
+        std::vector<double> lengths;
+        for (auto &simple_set: *support->simple_sets) {
+            auto interval = std::static_pointer_cast<SimpleInterval<double>>(simple_set);
+            lowers.push_back(interval->lower);
+            lengths.push_back(interval->upper - interval->lower);
+        }
+
+        auto values = columns[0];
+        std::uniform_real_distribution<double> uniform(0., 1.);
+        if (lowers.size() == 1) {
+            for (size_t row = 0; row < n_rows; row++) {
+                values[rows[row]] = lowers[0] + lengths[0] * uniform(generator);
+            }
+            return;
+        }
+
+        AliasTable table(lengths);
+        for (size_t row = 0; row < n_rows; row++) {
+            auto index = table.draw(generator);
+            values[rows[row]] = lowers[index] + lengths[index] * uniform(generator);
+        }
+    }
+
     std::string distribution_representation() const override
     {
         return "U(" + *support->to_string() + ")";
@@ -0,0 +1,49 @@
+#include <include/alias_table.h>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+AliasTable::AliasTable(const std::vector<double> &weights) : acceptance_probabilities(weights.size()),
+                                                              aliases(weights.size()) {
+    auto total = std::accumulate(weights.begin(), weights.end(), 0.);
+    if (weights.empty() || !(total > 0) || std::isinf(total)) {
+        throw std::invalid_argument("The weights of an alias table must have a positive, finite sum.");
+    }
+
+    // scale the weights such that the average bucket holds a probability of 1
+    std::vector<double> scaled(weights.size());
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (uint32_t index = 0; index < weights.size(); index++) {
+        if (weights[index] < 0) {
+            throw std::invalid_argument("The weights of an alias table must not be negative.");
+        }
+        scaled[index] = weights[index] * (double) weights.size() / total;
+        (scaled[index] < 1. ? small : large).push_back(index);
+    }
+
+    // fill every underfull bucket with the excess of an overfull one
+    while (!small.empty() && !large.empty()) {
+        auto underfull = small.back();
+        small.pop_back();
+        auto overfull = large.back();
+
+        acceptance_probabilities[underfull] = scaled[underfull];
+        aliases[underfull] = overfull;
+        scaled[overfull] -= 1. - scaled[underfull];
+        if (scaled[overfull] < 1.) {
+            large.pop_back();
+            small.push_back(overfull);
+        }
+    }
+
+    // the remaining buckets are full up to rounding errors
+    for (auto index: small) {
+        acceptance_probabilities[index] = 1.;
+        aliases[index] = index;
+    }
+    for (auto index: large) {
+        acceptance_probabilities[index] = 1.;
+        aliases[index] = index;
+    }
+}
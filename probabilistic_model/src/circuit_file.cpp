@@ -0,0 +1,275 @@
+#include <include/circuit_file.h>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char CircuitFileHeader::expected_magic[8];
+
+namespace {
+
+    enum VariableKind : uint32_t {
+        CONTINUOUS = 0,
+        INTEGER = 1,
+        SYMBOLIC = 2,
+    };
+
+    uint64_t aligned(uint64_t offset) {
+        return (offset + 7) & ~uint64_t(7);
+    }
+
+    void append_uint32(std::vector<char> &buffer, uint32_t value) {
+        auto bytes = reinterpret_cast<const char *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+    }
+
+    void append_string(std::vector<char> &buffer, const std::string &value) {
+        append_uint32(buffer, (uint32_t) value.size());
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    /**
+     * Reader for the variable table that checks every read against the end of the table.
+     */
+    class VariableTableReader {
+    public:
+        VariableTableReader(const char *position, const char *end) : position(position), end(end) {}
+
+        uint32_t read_uint32() {
+            uint32_t result;
+            require(sizeof(result));
+            std::memcpy(&result, position, sizeof(result));
+            position += sizeof(result);
+            return result;
+        }
+
+        std::string read_string() {
+            auto length = read_uint32();
+            require(length);
+            std::string result(position, length);
+            position += length;
+            return result;
+        }
+
+    private:
+        const char *position;
+        const char *end;
+
+        void require(size_t bytes) const {
+            if ((size_t) (end - position) < bytes) {
+                throw std::runtime_error("The variable table of the circuit file is truncated.");
+            }
+        }
+    };
+
+    template<typename T>
+    void write_section(std::ofstream &file, const std::vector<T> &values, uint64_t offset) {
+        static const char padding[8] = {};
+        auto position = (uint64_t) file.tellp();
+        file.write(padding, (std::streamsize) (offset - position));
+        file.write(reinterpret_cast<const char *>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+    }
+
+}
+
+void CompiledCircuit::save(const std::string &path) const {
+    std::vector<char> variable_table;
+    for (auto &variable: variables) {
+        if (std::dynamic_pointer_cast<Symbolic>(variable)) {
+            append_uint32(variable_table, SYMBOLIC);
+            append_string(variable_table, *variable->name);
+            auto all_elements = std::static_pointer_cast<Set>(variable->get_domain())->all_elements;
+            append_uint32(variable_table, (uint32_t) all_elements->size());
+            for (auto &element: *all_elements) {
+                append_string(variable_table, element);
+            }
+        } else if (std::dynamic_pointer_cast<Integer>(variable)) {
+            append_uint32(variable_table, INTEGER);
+            append_string(variable_table, *variable->name);
+        } else if (std::dynamic_pointer_cast<Continuous>(variable)) {
+            append_uint32(variable_table, CONTINUOUS);
+            append_string(variable_table, *variable->name);
+        } else {
+            throw std::invalid_argument("Cannot save variable " + *variable->name + " of unknown type.");
+        }
+    }
+
+    CircuitFileHeader header{};
+    std::memcpy(header.magic, CircuitFileHeader::expected_magic, sizeof(header.magic));
+    header.version = CircuitFileHeader::current_version;
+    header.byte_order_mark = CircuitFileHeader::expected_byte_order_mark;
+    header.number_of_nodes = kinds.size();
+    header.number_of_variables = variables.size();
+    header.number_of_edges = children.size();
+    header.number_of_parameters = parameters.size();
+
+    header.variables_offset = aligned(sizeof(CircuitFileHeader));
+    header.variables_size = variable_table.size();
+    header.kinds_offset = aligned(header.variables_offset + variable_table.size());
+    header.children_begin_offset = aligned(header.kinds_offset + kinds.size() * sizeof(NodeKind));
+    header.children_offset = aligned(header.children_begin_offset + children_begin.size() * sizeof(uint32_t));
+    header.edge_log_weights_offset = aligned(header.children_offset + children.size() * sizeof(uint32_t));
+    header.variable_indices_offset = aligned(header.edge_log_weights_offset + edge_log_weights.size() * sizeof(double));
+    header.parameters_begin_offset = aligned(header.variable_indices_offset + variable_indices.size() * sizeof(uint32_t));
+    header.parameters_offset = aligned(header.parameters_begin_offset + parameters_begin.size() * sizeof(uint32_t));
+    header.file_size = header.parameters_offset + parameters.size() * sizeof(double);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    write_section(file, variable_table, header.variables_offset);
+    write_section(file, kinds, header.kinds_offset);
+    write_section(file, children_begin, header.children_begin_offset);
+    write_section(file, children, header.children_offset);
+    write_section(file, edge_log_weights, header.edge_log_weights_offset);
+    write_section(file, variable_indices, header.variable_indices_offset);
+    write_section(file, parameters_begin, header.parameters_begin_offset);
+    write_section(file, parameters, header.parameters_offset);
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Could not write the circuit file " + path + ".");
+    }
+}
+
+MappedCircuit::MappedCircuit(const std::string &path) {
+    auto descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Could not open the circuit file " + path + ".");
+    }
+    struct stat file_status{};
+    if (fstat(descriptor, &file_status) != 0 || (size_t) file_status.st_size < sizeof(CircuitFileHeader)) {
+        close(descriptor);
+        throw std::runtime_error("The circuit file " + path + " is truncated.");
+    }
+    size = (size_t) file_status.st_size;
+    address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (address == MAP_FAILED) {
+        address = nullptr;
+        throw std::runtime_error("Could not map the circuit file " + path + ".");
+    }
+
+    try {
+        auto base = static_cast<const char *>(address);
+        CircuitFileHeader header{};
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, CircuitFileHeader::expected_magic, sizeof(header.magic)) != 0) {
+            throw std::runtime_error(path + " is not a circuit file.");
+        }
+        if (header.byte_order_mark != CircuitFileHeader::expected_byte_order_mark) {
+            throw std::runtime_error("The circuit file " + path + " was written with another byte order.");
+        }
+        if (header.version != CircuitFileHeader::current_version) {
+            throw std::runtime_error("The circuit file " + path + " has version " + std::to_string(header.version) +
+                                     ", expected " + std::to_string(CircuitFileHeader::current_version) + ".");
+        }
+        if (header.file_size != size || header.number_of_nodes == 0) {
+            throw std::runtime_error("The circuit file " + path + " is truncated.");
+        }
+
+        // every section has to be aligned and inside the file
+        auto section = [&](uint64_t offset, uint64_t bytes) {
+            if (offset % 8 != 0 || offset > size || bytes > size - offset) {
+                throw std::runtime_error("The circuit file " + path + " is corrupted.");
+            }
+            return base + offset;
+        };
+        auto nodes = header.number_of_nodes;
+        auto edges = header.number_of_edges;
+        circuit_tape.number_of_nodes = nodes;
+        circuit_tape.number_of_variables = header.number_of_variables;
+        auto variable_table = section(header.variables_offset, header.variables_size);
+        circuit_tape.kinds = reinterpret_cast<const NodeKind *>(section(header.kinds_offset, nodes));
+        circuit_tape.children_begin = reinterpret_cast<const uint32_t *>(
+                section(header.children_begin_offset, (nodes + 1) * sizeof(uint32_t)));
+        circuit_tape.children = reinterpret_cast<const uint32_t *>(
+                section(header.children_offset, edges * sizeof(uint32_t)));
+        circuit_tape.edge_log_weights = reinterpret_cast<const double *>(
+                section(header.edge_log_weights_offset, edges * sizeof(double)));
+        circuit_tape.variable_indices = reinterpret_cast<const uint32_t *>(
+                section(header.variable_indices_offset, nodes * sizeof(uint32_t)));
+        circuit_tape.parameters_begin = reinterpret_cast<const uint32_t *>(
+                section(header.parameters_begin_offset, (nodes + 1) * sizeof(uint32_t)));
+        circuit_tape.parameters = reinterpret_cast<const double *>(
+                section(header.parameters_offset, header.number_of_parameters * sizeof(double)));
+
+        // the evaluation trusts the tape, hence every index is checked once
+        if (circuit_tape.children_begin[nodes] != edges ||
+            circuit_tape.parameters_begin[nodes] != header.number_of_parameters) {
+            throw std::runtime_error("The circuit file " + path + " is corrupted.");
+        }
+        for (size_t node = 0; node < nodes; node++) {
+            auto first_edge = circuit_tape.children_begin[node];
+            auto last_edge = circuit_tape.children_begin[node + 1];
+            auto first_parameter = circuit_tape.parameters_begin[node];
+            auto last_parameter = circuit_tape.parameters_begin[node + 1];
+            auto kind = circuit_tape.kinds[node];
+            bool is_leaf = kind == NodeKind::UNIFORM || kind == NodeKind::DIRAC_DELTA || kind == NodeKind::DISCRETE;
+            bool is_valid = first_edge <= last_edge && first_parameter <= last_parameter &&
+                            (uint8_t) kind <= (uint8_t) NodeKind::DISCRETE &&
+                            (!is_leaf || circuit_tape.variable_indices[node] < header.number_of_variables) &&
+                            (kind != NodeKind::UNIFORM || last_parameter - first_parameter == 5) &&
+                            (kind != NodeKind::DIRAC_DELTA || last_parameter - first_parameter == 2) &&
+                            (kind != NodeKind::DISCRETE || last_parameter - first_parameter >= 1);
+            for (auto edge = first_edge; is_valid && edge < last_edge; edge++) {
+                is_valid = circuit_tape.children[edge] < node;
+            }
+            if (!is_valid) {
+                throw std::runtime_error("The circuit file " + path + " is corrupted.");
+            }
+        }
+
+        VariableTableReader reader(variable_table, variable_table + header.variables_size);
+        for (size_t index = 0; index < header.number_of_variables; index++) {
+            auto kind = reader.read_uint32();
+            auto name = reader.read_string();
+            if (kind == SYMBOLIC) {
+                std::set<std::string> elements;
+                auto number_of_elements = reader.read_uint32();
+                for (size_t element = 0; element < number_of_elements; element++) {
+                    elements.insert(reader.read_string());
+                }
+                variables.push_back(make_shared_symbolic(std::make_shared<std::string>(name),
+                                                         make_shared_all_elements(elements)));
+            } else if (kind == INTEGER) {
+                variables.push_back(make_shared_integer(name));
+            } else if (kind == CONTINUOUS) {
+                variables.push_back(make_shared_continuous(name));
+            } else {
+                throw std::runtime_error("The circuit file " + path + " contains a variable of unknown type.");
+            }
+        }
+    } catch (...) {
+        munmap(address, size);
+        throw;
+    }
+}
+
+MappedCircuit::~MappedCircuit() {
+    if (address != nullptr) {
+        munmap(address, size);
+    }
+}
+
+double MappedCircuit::log_likelihood(const FullEvidencePtr_t &event) const {
+    ColumnPointers columns(event->size());
+    for (size_t column = 0; column < event->size(); column++) {
+        columns[column] = event->data() + column;
+    }
+    double result;
+    log_likelihood_of_columns(columns, 1, &result);
+    return result;
+}
+
+void MappedCircuit::log_likelihood_batch(const double *data, size_t n_rows, double *out) const {
+    PROFILE_NODE_EVALUATION(n_rows);
+    circuit_tape.log_likelihood_batch(data, n_rows, out);
+}
+
+void MappedCircuit::log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const {
+    PROFILE_NODE_EVALUATION(n_rows);
+    std::vector<double> scratch(circuit_tape.scratch_size(n_rows));
+    circuit_tape.log_likelihood_of_columns(columns, n_rows, out, scratch.data());
+}
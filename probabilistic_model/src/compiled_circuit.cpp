@@ -0,0 +1,257 @@
+#include <include/compiled_circuit.h>
+#include <include/univariate.h>
+#include <include/log_sum_exp.h>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+CompiledCircuit::CompiledCircuit(const ProbabilisticCircuitPtr_t &circuit) {
+    auto variable_set = circuit->get_variables();
+    variables.assign(variable_set->begin(), variable_set->end());
+    children_begin.push_back(0);
+    parameters_begin.push_back(0);
+
+    // iterative post-order traversal such that deep circuits do not exhaust the stack
+    std::unordered_map<const ProbabilisticCircuit *, uint32_t> compiled_indices;
+    std::vector<std::pair<const ProbabilisticCircuit *, bool>> stack{{circuit.get(), false}};
+    while (!stack.empty()) {
+        auto [node, children_are_compiled] = stack.back();
+        stack.pop_back();
+        if (compiled_indices.count(node) > 0) {
+            continue;
+        }
+
+        if (!children_are_compiled) {
+            stack.emplace_back(node, true);
+            for (auto child = node->sub_circuits.rbegin(); child != node->sub_circuits.rend(); child++) {
+                if (compiled_indices.count(child->get()) == 0) {
+                    stack.emplace_back(child->get(), false);
+                }
+            }
+            continue;
+        }
+
+        std::vector<uint32_t> child_indices;
+        child_indices.reserve(node->sub_circuits.size());
+        for (auto &child: node->sub_circuits) {
+            child_indices.push_back(compiled_indices.at(child.get()));
+        }
+        append_node(*node, child_indices);
+        compiled_indices[node] = (uint32_t) kinds.size() - 1;
+    }
+}
+
+void CompiledCircuit::append_node(const ProbabilisticCircuit &node, const std::vector<uint32_t> &child_indices) {
+
+    if (auto sum = dynamic_cast<const SmoothSumUnit *>(&node)) {
+        kinds.push_back(NodeKind::SUM);
+        for (size_t index = 0; index < child_indices.size(); index++) {
+            children.push_back(child_indices[index]);
+            edge_log_weights.push_back(log(sum->weights[index]));
+        }
+        variable_indices.push_back(0);
+
+    } else if (dynamic_cast<const DecomposableProductUnit *>(&node)) {
+        kinds.push_back(NodeKind::PRODUCT);
+        children.insert(children.end(), child_indices.begin(), child_indices.end());
+        edge_log_weights.insert(edge_log_weights.end(), child_indices.size(), 0.);
+        variable_indices.push_back(0);
+
+    } else if (auto leaf = dynamic_cast<const UnivariateDistribution *>(&node)) {
+
+        // find the column of the variable of the leaf
+        auto column = std::lower_bound(variables.begin(), variables.end(), leaf->variable,
+                                       PointerLess<AbstractVariablePtr_t>());
+        variable_indices.push_back((uint32_t) (column - variables.begin()));
+
+        if (auto uniform = dynamic_cast<const UniformDistribution *>(leaf)) {
+            if (uniform->support->simple_sets->size() != 1) {
+                throw std::invalid_argument("Cannot compile uniform distributions with a support made of multiple "
+                                            "intervals: " + node.representation());
+            }
+            auto interval = std::static_pointer_cast<SimpleInterval<double>>(*uniform->support->simple_sets->begin());
+            kinds.push_back(NodeKind::UNIFORM);
+            parameters.insert(parameters.end(), {interval->lower, interval->upper, log(uniform->pdf_value()),
+                                                 interval->left == BorderType::CLOSED ? 1. : 0.,
+                                                 interval->right == BorderType::CLOSED ? 1. : 0.});
+
+        } else if (auto dirac_delta = dynamic_cast<const DiracDeltaDistribution *>(leaf)) {
+            kinds.push_back(NodeKind::DIRAC_DELTA);
+            parameters.insert(parameters.end(), {dirac_delta->location, log(dirac_delta->density_cap)});
+
+        } else if (auto discrete = dynamic_cast<const DiscreteDistribution *>(leaf)) {
+            kinds.push_back(NodeKind::DISCRETE);
+            if (discrete->probabilities.empty()) {
+                parameters.push_back(0.);
+            } else if (discrete->is_dense()) {
+                parameters.push_back((double) discrete->first_code());
+                auto &log_probabilities = discrete->dense_log_probabilities();
+                parameters.insert(parameters.end(), log_probabilities.begin(), log_probabilities.end());
+            } else {
+                // the tape stores every code between the smallest and largest one, which may not fit into memory
+                throw std::invalid_argument("Cannot compile discrete distributions whose codes are too sparse for a "
+                                            "dense representation: " + node.representation());
+            }
+
+        } else {
+            throw std::invalid_argument("Cannot compile leaf " + node.representation());
+        }
+
+    } else {
+        throw std::invalid_argument("Cannot compile node " + node.representation());
+    }
+
+    if (children.size() > std::numeric_limits<uint32_t>::max() ||
+        parameters.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("Cannot compile circuits with more than 2^32 edges or parameters.");
+    }
+    children_begin.push_back((uint32_t) children.size());
+    parameters_begin.push_back((uint32_t) parameters.size());
+}
+
+CircuitTape CompiledCircuit::tape() const {
+    CircuitTape result;
+    result.number_of_nodes = kinds.size();
+    result.number_of_variables = variables.size();
+    result.kinds = kinds.data();
+    result.children_begin = children_begin.data();
+    result.children = children.data();
+    result.edge_log_weights = edge_log_weights.data();
+    result.variable_indices = variable_indices.data();
+    result.parameters_begin = parameters_begin.data();
+    result.parameters = parameters.data();
+    return result;
+}
+
+double CompiledCircuit::log_likelihood(const FullEvidencePtr_t &event) const {
+    ColumnPointers columns(event->size());
+    for (size_t column = 0; column < event->size(); column++) {
+        columns[column] = event->data() + column;
+    }
+    double result;
+    log_likelihood_of_columns(columns, 1, &result);
+    return result;
+}
+
+void CompiledCircuit::log_likelihood_batch(const double *data, size_t n_rows, double *out) const {
+    PROFILE_NODE_EVALUATION(n_rows);
+    tape().log_likelihood_batch(data, n_rows, out);
+}
+
+void CompiledCircuit::log_likelihood_of_columns(const ColumnPointers &columns, size_t n_rows, double *out) const {
+    PROFILE_NODE_EVALUATION(n_rows);
+    auto circuit_tape = tape();
+    std::vector<double> scratch(circuit_tape.scratch_size(n_rows));
+    circuit_tape.log_likelihood_of_columns(columns, n_rows, out, scratch.data());
+}
+
+template<typename Scalar>
+void BasicCircuitTape<Scalar>::log_likelihood_of_columns(const Columns &columns, size_t n_rows, Scalar *out,
+                                                         Scalar *scratch) const {
+    evaluate(columns, n_rows, scratch);
+    auto root = scratch + (number_of_nodes - 1) * n_rows;
+    std::copy(root, root + n_rows, out);
+}
+
+template<typename Scalar>
+void BasicCircuitTape<Scalar>::log_likelihood_batch(const Scalar *data, size_t n_rows, Scalar *out) const {
+    auto block_size = std::min(ProbabilisticModel::batch_block_size, n_rows);
+    std::vector<Scalar> scratch(scratch_size(block_size));
+    Columns columns(number_of_variables);
+    for (size_t block_begin = 0; block_begin < n_rows; block_begin += block_size) {
+        auto rows = std::min(block_size, n_rows - block_begin);
+        for (size_t column = 0; column < columns.size(); column++) {
+            columns[column] = data + column * n_rows + block_begin;
+        }
+        log_likelihood_of_columns(columns, rows, out + block_begin, scratch.data());
+    }
+}
+
+template<typename Scalar>
+void BasicCircuitTape<Scalar>::evaluate(const Columns &columns, size_t n_rows, Scalar *scratch) const {
+    const auto minus_infinity = -std::numeric_limits<Scalar>::infinity();
+    auto accumulator = scratch + number_of_nodes * n_rows;
+
+    for (size_t node = 0; node < number_of_nodes; node++) {
+        auto out = scratch + node * n_rows;
+        auto node_parameters = parameters + parameters_begin[node];
+        auto first_edge = children_begin[node];
+        auto last_edge = children_begin[node + 1];
+
+        switch (kinds[node]) {
+            case NodeKind::SUM: {
+
+                // shift by the maximum such that the exponentials cannot underflow
+                std::fill(out, out + n_rows, minus_infinity);
+                for (auto edge = first_edge; edge < last_edge; edge++) {
+                    auto child = scratch + children[edge] * n_rows;
+                    auto log_weight = edge_log_weights[edge];
+                    for (size_t row = 0; row < n_rows; row++) {
+                        out[row] = std::max(out[row], child[row] + log_weight);
+                    }
+                }
+                std::fill(accumulator, accumulator + n_rows, Scalar(0));
+                for (auto edge = first_edge; edge < last_edge; edge++) {
+                    auto child = scratch + children[edge] * n_rows;
+                    auto log_weight = edge_log_weights[edge];
+                    for (size_t row = 0; row < n_rows; row++) {
+                        accumulator[row] += vectorizable_exp(child[row] + log_weight - out[row]);
+                    }
+                }
+                // rows whose maximum is infinite keep it, like weighted_log_sum_exp
+                for (size_t row = 0; row < n_rows; row++) {
+                    out[row] = std::isinf(out[row]) ? out[row] : out[row] + std::log(accumulator[row]);
+                }
+                break;
+            }
+            case NodeKind::PRODUCT: {
+                std::fill(out, out + n_rows, Scalar(0));
+                for (auto edge = first_edge; edge < last_edge; edge++) {
+                    auto child = scratch + children[edge] * n_rows;
+                    for (size_t row = 0; row < n_rows; row++) {
+                        out[row] += child[row];
+                    }
+                }
+                break;
+            }
+            case NodeKind::UNIFORM: {
+                auto values = columns[variable_indices[node]];
+                auto lower = node_parameters[0];
+                auto upper = node_parameters[1];
+                auto log_density = node_parameters[2];
+                bool left_closed = node_parameters[3] != 0;
+                bool right_closed = node_parameters[4] != 0;
+                for (size_t row = 0; row < n_rows; row++) {
+                    auto value = values[row];
+                    bool inside_left = left_closed ? value >= lower : value > lower;
+                    bool inside_right = right_closed ? value <= upper : value < upper;
+                    out[row] = inside_left && inside_right ? log_density : minus_infinity;
+                }
+                break;
+            }
+            case NodeKind::DIRAC_DELTA: {
+                auto values = columns[variable_indices[node]];
+                auto location = node_parameters[0];
+                auto log_density_cap = node_parameters[1];
+                for (size_t row = 0; row < n_rows; row++) {
+                    out[row] = values[row] == location ? log_density_cap : minus_infinity;
+                }
+                break;
+            }
+            case NodeKind::DISCRETE: {
+                auto values = columns[variable_indices[node]];
+                auto first_code = (long) node_parameters[0];
+                auto number_of_codes = (long) (parameters_begin[node + 1] - parameters_begin[node]) - 1;
+                auto log_probabilities = node_parameters + 1;
+                for (size_t row = 0; row < n_rows; row++) {
+                    auto code = (long) (int) values[row] - first_code;
+                    out[row] = code >= 0 && code < number_of_codes ? log_probabilities[code] : minus_infinity;
+                }
+                break;
+            }
+        }
+    }
+}
+
+template struct BasicCircuitTape<double>;
+template struct BasicCircuitTape<float>;
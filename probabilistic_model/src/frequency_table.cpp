@@ -0,0 +1,228 @@
+#include <include/frequency_table.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+void radix_sort(std::vector<double> &values) {
+    const size_t bits_per_digit = 11;
+    const size_t number_of_buckets = 1 << bits_per_digit;
+    const uint64_t sign_bit = 1ull << 63;
+
+    std::vector<uint64_t> keys(values.size());
+    for (size_t index = 0; index < values.size(); index++) {
+        uint64_t bits;
+        std::memcpy(&bits, &values[index], sizeof(double));
+        keys[index] = bits & sign_bit ? ~bits : bits | sign_bit;
+    }
+
+    std::vector<uint64_t> buffer(values.size());
+    std::vector<size_t> bucket_begin(number_of_buckets);
+    for (size_t shift = 0; shift < 64; shift += bits_per_digit) {
+        std::fill(bucket_begin.begin(), bucket_begin.end(), 0);
+        for (auto key: keys) {
+            bucket_begin[(key >> shift) & (number_of_buckets - 1)]++;
+        }
+
+        // all keys in one bucket, the pass would not change the order
+        if (!keys.empty() && bucket_begin[(keys[0] >> shift) & (number_of_buckets - 1)] == keys.size()) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (auto &begin: bucket_begin) {
+            auto count = begin;
+            begin = offset;
+            offset += count;
+        }
+        for (auto key: keys) {
+            buffer[bucket_begin[(key >> shift) & (number_of_buckets - 1)]++] = key;
+        }
+        keys.swap(buffer);
+    }
+
+    for (size_t index = 0; index < values.size(); index++) {
+        auto key = keys[index];
+        uint64_t bits = key & sign_bit ? key & ~sign_bit : ~key;
+        std::memcpy(&values[index], &bits, sizeof(double));
+    }
+}
+
+FrequencyTable FrequencyTable::from_samples(std::vector<double> &samples) {
+    if (samples.size() >= radix_sort_threshold) {
+        radix_sort(samples);
+    } else {
+        std::sort(samples.begin(), samples.end());
+    }
+    FrequencyTable result;
+    for (auto sample: samples) {
+        result.append(sample, 1.);
+    }
+    return result;
+}
+
+FrequencyTable FrequencyTable::merge(const FrequencyTable &left, const FrequencyTable &right) {
+    FrequencyTable result;
+    result.values.reserve(left.size() + right.size());
+    result.weights.reserve(left.size() + right.size());
+
+    size_t left_index = 0;
+    size_t right_index = 0;
+    while (left_index < left.size() || right_index < right.size()) {
+        bool take_left = right_index == right.size() ||
+                         (left_index < left.size() && left.values[left_index] <= right.values[right_index]);
+        if (take_left) {
+            result.append(left.values[left_index], left.weights[left_index]);
+            left_index++;
+        } else {
+            result.append(right.values[right_index], right.weights[right_index]);
+            right_index++;
+        }
+    }
+    return result;
+}
+
+ExternalFrequencyAggregator::~ExternalFrequencyAggregator() {
+    for (auto run: runs) {
+        std::fclose(run);
+    }
+}
+
+void ExternalFrequencyAggregator::add_chunk(std::vector<double> &chunk) {
+    tables.push_back(FrequencyTable::from_samples(chunk));
+
+    // merge while the newest table is at least half as large as the one below it, such that the sizes at least
+    // double towards the bottom and every entry takes part in a logarithmic number of merges
+    while (tables.size() > 1 && 2 * tables.back().size() >= tables[tables.size() - 2].size()) {
+        auto newest = std::move(tables.back());
+        tables.pop_back();
+        tables.back() = FrequencyTable::merge(tables.back(), newest);
+    }
+
+    size_t bytes = 0;
+    for (auto &pending: tables) {
+        bytes += pending.bytes();
+    }
+    if (bytes > memory_budget) {
+        spill();
+    }
+}
+
+FrequencyTable ExternalFrequencyAggregator::merge_tables() {
+    FrequencyTable result;
+    while (!tables.empty()) {
+        result = FrequencyTable::merge(tables.back(), result);
+        tables.pop_back();
+    }
+    return result;
+}
+
+void ExternalFrequencyAggregator::spill() {
+    auto run = std::tmpfile();
+    if (run == nullptr) {
+        throw std::runtime_error("Could not create a temporary file to spill the frequency table to.");
+    }
+    runs.push_back(run);
+    auto table = merge_tables();
+
+    // interleave values and weights such that a run can be read sequentially
+    std::vector<double> entries(2 * table.size());
+    for (size_t index = 0; index < table.size(); index++) {
+        entries[2 * index] = table.values[index];
+        entries[2 * index + 1] = table.weights[index];
+    }
+    if (std::fwrite(entries.data(), sizeof(double), entries.size(), run) != entries.size()) {
+        throw std::runtime_error("Could not spill the frequency table to disk.");
+    }
+    std::rewind(run);
+}
+
+namespace {
+
+    /**
+     * Buffered reader for a run of interleaved (value, weight) pairs.
+     */
+    class RunReader {
+    public:
+        explicit RunReader(std::FILE *file, size_t buffer_entries) : file(file), buffer(2 * buffer_entries) {
+            refill();
+        }
+
+        bool exhausted() const {
+            return position == end;
+        }
+
+        double value() const {
+            return buffer[position];
+        }
+
+        double weight() const {
+            return buffer[position + 1];
+        }
+
+        void advance() {
+            position += 2;
+            if (position == end) {
+                refill();
+            }
+        }
+
+    private:
+        std::FILE *file;
+        std::vector<double> buffer;
+        size_t position = 0;
+        size_t end = 0;
+
+        void refill() {
+            position = 0;
+            end = std::fread(buffer.data(), sizeof(double), buffer.size(), file);
+            end -= end % 2;
+        }
+    };
+
+}
+
+FrequencyTable ExternalFrequencyAggregator::finish() {
+    if (runs.empty()) {
+        return merge_tables();
+    }
+    spill();
+
+    // split the budget between the read buffers of the runs
+    auto buffer_entries = std::max<size_t>(1024, memory_budget / (2 * sizeof(double) * runs.size()));
+    std::vector<RunReader> readers;
+    readers.reserve(runs.size());
+    for (auto run: runs) {
+        readers.emplace_back(run, buffer_entries);
+    }
+
+    // k-way merge with a heap ordered by the current value of every reader
+    auto greater_value = [&readers](size_t left, size_t right) {
+        return readers[left].value() > readers[right].value();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater_value)> heap(greater_value);
+    for (size_t index = 0; index < readers.size(); index++) {
+        if (!readers[index].exhausted()) {
+            heap.push(index);
+        }
+    }
+
+    FrequencyTable result;
+    while (!heap.empty()) {
+        auto index = heap.top();
+        heap.pop();
+        result.append(readers[index].value(), readers[index].weight());
+        readers[index].advance();
+        if (!readers[index].exhausted()) {
+            heap.push(index);
+        }
+    }
+
+    for (auto run: runs) {
+        std::fclose(run);
+    }
+    runs.clear();
+    return result;
+}
@@ -0,0 +1,637 @@
+#include <include/joint_probability_tree.h>
+#include <include/thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+    enum class VariableKind {
+        CONTINUOUS,
+        INTEGER,
+        SYMBOLIC
+    };
+
+    /**
+     * The sufficient statistics of a set of rows for the impurities of all variables.
+     *
+     * For ordinal variables, `sums` and `sums_of_squares` hold the sum and the sum of squares of the values relative
+     * to their mean in the entire data. For symbolic variables, `counts` holds the number of rows of every symbol
+     * and `sums_of_squares` the sum of the squared counts.
+     */
+    struct PartitionStatistics {
+        double number_of_rows = 0;
+        std::vector<double> sums;
+        std::vector<double> sums_of_squares;
+        std::vector<double> counts;
+    };
+
+    /**
+     * A partition of the rows, which is the same range in the sorted rows of every variable.
+     */
+    struct Partition {
+        size_t begin;
+        size_t end;
+        size_t depth;
+
+        size_t size() const {
+            return end - begin;
+        }
+    };
+
+    /**
+     * The best split of a partition at one variable.
+     */
+    struct Split {
+
+        /**
+         * The mean impurity of both children weighted by their number of rows, infinity if there is no valid split.
+         */
+        double impurity = std::numeric_limits<double>::infinity();
+
+        size_t variable = 0;
+
+        /**
+         * The largest value of the left child for ordinal variables, the symbol of the left child for symbolic ones.
+         */
+        double value = 0;
+    };
+
+    /**
+     * The state of one fit of a joint probability tree.
+     */
+    class TreeInduction {
+    public:
+
+        TreeInduction(const JointProbabilityTree &tree, const double *data, size_t n_rows);
+
+        JointProbabilityTreePtr_t fit();
+
+    private:
+
+        /**
+         * The results of searching for the best split at every variable in parallel.
+         */
+        struct ParallelSplitSearch {
+            Partition partition;
+            PartitionStatistics statistics;
+            std::vector<Split> splits;
+            std::atomic<size_t> remaining_variables;
+        };
+
+        const JointProbabilityTree &tree;
+        const double *data;
+        const size_t n_rows;
+        const size_t min_samples_per_leaf;
+
+        std::vector<AbstractVariablePtr_t> variables;
+        std::vector<VariableKind> kinds;
+
+        /**
+         * The index of the count of the first symbol of every symbolic variable in PartitionStatistics::counts.
+         */
+        std::vector<size_t> count_offsets;
+        std::vector<size_t> number_of_symbols;
+        size_t total_number_of_symbols = 0;
+
+        /**
+         * The mean of every ordinal variable, subtracted from its values to calculate the variance accurately.
+         */
+        std::vector<double> shifts;
+
+        /**
+         * The impurity of every variable in the entire data. Variables with an impurity of 0 are ignored.
+         */
+        std::vector<double> root_impurities;
+        size_t number_of_impure_variables = 0;
+
+        /**
+         * The indices of all rows sorted by every variable, shared by all partitions.
+         */
+        std::vector<std::vector<size_t>> sorted_rows;
+
+        /**
+         * Whether a row goes to the left child when its partition is split.
+         */
+        std::vector<uint8_t> goes_left;
+
+        /**
+         * The buffer for the rows of the right children when partitions are split.
+         */
+        std::vector<size_t> right_rows;
+
+        std::vector<Partition> leaves;
+        std::mutex leaves_mutex;
+
+        /**
+         * The tasks that are not executed yet if there is no thread pool.
+         */
+        std::vector<Task_t> sequential_tasks;
+
+        std::unique_ptr<ThreadPool> thread_pool;
+
+        const double *column(size_t variable) const {
+            return data + variable * n_rows;
+        }
+
+        /**
+         * Execute a task on the thread pool, or later by run_tasks if there is none.
+         */
+        void schedule(Task_t task);
+
+        /**
+         * Execute all scheduled tasks and the tasks they schedule.
+         */
+        void run_tasks();
+
+        void sort_rows(size_t variable);
+
+        PartitionStatistics empty_statistics() const;
+
+        PartitionStatistics statistics_of(const Partition &partition) const;
+
+        void add_row(PartitionStatistics &statistics, size_t row) const;
+
+        void remove_row(PartitionStatistics &statistics, size_t row) const;
+
+        /**
+         * @return The mean impurity of all impure variables relative to their impurity in the entire data.
+         */
+        double impurity(const PartitionStatistics &statistics) const;
+
+        /**
+         * @return The Gini impurity of a symbolic variable or the variance of an ordinal one.
+         */
+        double variable_impurity(const PartitionStatistics &statistics, size_t variable) const;
+
+        double weighted_impurity(const PartitionStatistics &left, const PartitionStatistics &right) const;
+
+        Split best_split(const Partition &partition, size_t variable, const PartitionStatistics &statistics) const;
+
+        Split best_ordinal_split(const Partition &partition, size_t variable,
+                                 const PartitionStatistics &statistics) const;
+
+        Split best_symbolic_split(const Partition &partition, size_t variable,
+                                  const PartitionStatistics &statistics) const;
+
+        /**
+         * Split partitions depth first, starting at `root`. Children that are large enough for parallel processing
+         * are handed to other tasks.
+         */
+        void induce(const Partition &root);
+
+        /**
+         * Apply the best of the splits if it improves the impurity sufficiently, record the partition as leaf
+         * otherwise.
+         * @return The children if the partition was split.
+         */
+        std::optional<std::pair<Partition, Partition>>
+        apply_best_split(const Partition &partition, const std::vector<Split> &splits, double impurity);
+
+        /**
+         * Reorder the range of the partition in the sorted rows of every variable such that the rows of the left
+         * child come first. The rows keep their relative order.
+         * @return The index of the first row of the right child.
+         */
+        size_t partition_rows(const Partition &partition, const Split &split);
+
+        void add_leaf(const Partition &partition);
+
+        ProbabilisticCircuitPtr_t fit_leaf_distribution(const Partition &leaf, size_t variable) const;
+
+    };
+
+    TreeInduction::TreeInduction(const JointProbabilityTree &tree, const double *data, size_t n_rows) :
+            tree(tree), data(data), n_rows(n_rows),
+            min_samples_per_leaf(std::max<size_t>(1, tree.min_samples_per_leaf)),
+            variables(tree.variables->begin(), tree.variables->end()) {
+
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            auto values = column(variable);
+            if (std::any_of(values, values + n_rows, [](double value) { return std::isnan(value); })) {
+                throw std::invalid_argument("The data of a joint probability tree must not contain NaN.");
+            }
+
+            count_offsets.push_back(total_number_of_symbols);
+            if (std::dynamic_pointer_cast<Continuous>(variables[variable])) {
+                kinds.push_back(VariableKind::CONTINUOUS);
+                number_of_symbols.push_back(0);
+            } else if (std::dynamic_pointer_cast<Integer>(variables[variable])) {
+                kinds.push_back(VariableKind::INTEGER);
+                number_of_symbols.push_back(0);
+            } else if (auto symbolic = std::dynamic_pointer_cast<Symbolic>(variables[variable])) {
+                kinds.push_back(VariableKind::SYMBOLIC);
+                number_of_symbols.push_back(symbolic->all_elements->size());
+                auto size = (double) number_of_symbols.back();
+                if (std::any_of(values, values + n_rows, [size](double value) {
+                    return value < 0 || value >= size || value != std::floor(value);
+                })) {
+                    throw std::invalid_argument("The values of the symbolic variable " + *variables[variable]->name +
+                                                " must be indices of its elements.");
+                }
+            } else {
+                throw std::invalid_argument("Joint probability trees do not support the variable " +
+                                            *variables[variable]->name + ".");
+            }
+            total_number_of_symbols += number_of_symbols.back();
+
+            shifts.push_back(kinds.back() == VariableKind::SYMBOLIC ? 0. :
+                             std::accumulate(values, values + n_rows, 0.) / (double) n_rows);
+        }
+
+        // the impurities of the entire data normalize the impurities of the partitions
+        auto root_statistics = empty_statistics();
+        for (size_t row = 0; row < n_rows; row++) {
+            add_row(root_statistics, row);
+        }
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            root_impurities.push_back(variable_impurity(root_statistics, variable));
+            if (root_impurities.back() > 0) {
+                number_of_impure_variables++;
+            }
+        }
+
+        if (tree.number_of_threads > 1) {
+            thread_pool = std::make_unique<ThreadPool>(tree.number_of_threads);
+        }
+    }
+
+    void TreeInduction::schedule(Task_t task) {
+        if (thread_pool) {
+            thread_pool->submit(std::move(task));
+        } else {
+            sequential_tasks.push_back(std::move(task));
+        }
+    }
+
+    void TreeInduction::run_tasks() {
+        if (thread_pool) {
+            thread_pool->wait();
+            return;
+        }
+        while (!sequential_tasks.empty()) {
+            auto task = std::move(sequential_tasks.back());
+            sequential_tasks.pop_back();
+            task();
+        }
+    }
+
+    void TreeInduction::sort_rows(size_t variable) {
+        auto &rows = sorted_rows[variable];
+        rows.resize(n_rows);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        // ties are broken by the row index such that the order does not depend on the sorting algorithm
+        auto values = column(variable);
+        std::sort(rows.begin(), rows.end(), [values](size_t left, size_t right) {
+            return values[left] < values[right] || (values[left] == values[right] && left < right);
+        });
+    }
+
+    PartitionStatistics TreeInduction::empty_statistics() const {
+        PartitionStatistics result;
+        result.sums.assign(variables.size(), 0.);
+        result.sums_of_squares.assign(variables.size(), 0.);
+        result.counts.assign(total_number_of_symbols, 0.);
+        return result;
+    }
+
+    PartitionStatistics TreeInduction::statistics_of(const Partition &partition) const {
+        auto result = empty_statistics();
+        auto &rows = sorted_rows[0];
+        for (auto index = partition.begin; index < partition.end; index++) {
+            add_row(result, rows[index]);
+        }
+        return result;
+    }
+
+    void TreeInduction::add_row(PartitionStatistics &statistics, size_t row) const {
+        statistics.number_of_rows++;
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            auto value = column(variable)[row];
+            if (kinds[variable] == VariableKind::SYMBOLIC) {
+                auto &count = statistics.counts[count_offsets[variable] + (size_t) value];
+                statistics.sums_of_squares[variable] += 2 * count + 1;
+                count++;
+            } else {
+                auto shifted_value = value - shifts[variable];
+                statistics.sums[variable] += shifted_value;
+                statistics.sums_of_squares[variable] += shifted_value * shifted_value;
+            }
+        }
+    }
+
+    void TreeInduction::remove_row(PartitionStatistics &statistics, size_t row) const {
+        statistics.number_of_rows--;
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            auto value = column(variable)[row];
+            if (kinds[variable] == VariableKind::SYMBOLIC) {
+                auto &count = statistics.counts[count_offsets[variable] + (size_t) value];
+                count--;
+                statistics.sums_of_squares[variable] -= 2 * count + 1;
+            } else {
+                auto shifted_value = value - shifts[variable];
+                statistics.sums[variable] -= shifted_value;
+                statistics.sums_of_squares[variable] -= shifted_value * shifted_value;
+            }
+        }
+    }
+
+    double TreeInduction::impurity(const PartitionStatistics &statistics) const {
+        auto number_of_rows = statistics.number_of_rows;
+        if (number_of_rows == 0 || number_of_impure_variables == 0) {
+            return 0;
+        }
+        double result = 0;
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            if (root_impurities[variable] > 0) {
+                result += variable_impurity(statistics, variable) / root_impurities[variable];
+            }
+        }
+        return result / (double) number_of_impure_variables;
+    }
+
+    double TreeInduction::variable_impurity(const PartitionStatistics &statistics, size_t variable) const {
+        auto number_of_rows = statistics.number_of_rows;
+        if (kinds[variable] == VariableKind::SYMBOLIC) {
+            return std::max(0., 1 - statistics.sums_of_squares[variable] / (number_of_rows * number_of_rows));
+        }
+        auto mean = statistics.sums[variable] / number_of_rows;
+        return std::max(0., statistics.sums_of_squares[variable] / number_of_rows - mean * mean);
+    }
+
+    double TreeInduction::weighted_impurity(const PartitionStatistics &left, const PartitionStatistics &right) const {
+        return (left.number_of_rows * impurity(left) + right.number_of_rows * impurity(right)) /
+               (left.number_of_rows + right.number_of_rows);
+    }
+
+    Split TreeInduction::best_split(const Partition &partition, size_t variable,
+                                    const PartitionStatistics &statistics) const {
+        if (kinds[variable] == VariableKind::SYMBOLIC) {
+            return best_symbolic_split(partition, variable, statistics);
+        }
+        return best_ordinal_split(partition, variable, statistics);
+    }
+
+    Split TreeInduction::best_ordinal_split(const Partition &partition, size_t variable,
+                                            const PartitionStatistics &statistics) const {
+        Split result;
+        result.variable = variable;
+        auto &rows = sorted_rows[variable];
+        auto values = column(variable);
+
+        // move the rows from the right to the left child in ascending order of the values
+        auto left = empty_statistics();
+        auto right = statistics;
+        for (auto index = partition.begin; index + 1 < partition.end; index++) {
+            auto row = rows[index];
+            add_row(left, row);
+            remove_row(right, row);
+            if ((size_t) right.number_of_rows < min_samples_per_leaf) {
+                break;
+            }
+            if ((size_t) left.number_of_rows < min_samples_per_leaf || values[row] == values[rows[index + 1]]) {
+                continue;
+            }
+            auto split_impurity = weighted_impurity(left, right);
+            if (split_impurity < result.impurity) {
+                result.impurity = split_impurity;
+                result.value = values[row];
+            }
+        }
+        return result;
+    }
+
+    Split TreeInduction::best_symbolic_split(const Partition &partition, size_t variable,
+                                             const PartitionStatistics &statistics) const {
+        Split result;
+        result.variable = variable;
+        auto &rows = sorted_rows[variable];
+        auto values = column(variable);
+
+        // the rows are sorted by symbol, hence every symbol is one run of rows
+        auto run_begin = partition.begin;
+        while (run_begin < partition.end) {
+            auto symbol = values[rows[run_begin]];
+            auto left = empty_statistics();
+            auto right = statistics;
+            auto run_end = run_begin;
+            for (; run_end < partition.end && values[rows[run_end]] == symbol; run_end++) {
+                add_row(left, rows[run_end]);
+                remove_row(right, rows[run_end]);
+            }
+            run_begin = run_end;
+
+            if ((size_t) left.number_of_rows < min_samples_per_leaf ||
+                (size_t) right.number_of_rows < min_samples_per_leaf) {
+                continue;
+            }
+            auto split_impurity = weighted_impurity(left, right);
+            if (split_impurity < result.impurity) {
+                result.impurity = split_impurity;
+                result.value = symbol;
+            }
+        }
+        return result;
+    }
+
+    void TreeInduction::induce(const Partition &root) {
+        std::vector<Partition> partitions{root};
+        while (!partitions.empty()) {
+            auto partition = partitions.back();
+            partitions.pop_back();
+
+            if (partition.depth >= tree.max_depth || partition.size() < 2 * min_samples_per_leaf) {
+                add_leaf(partition);
+                continue;
+            }
+
+            // large partitions search for the best split of every variable in its own task, the last task to finish
+            // applies the best one
+            if (thread_pool && partition.size() >= tree.min_samples_per_parallel_task && variables.size() > 1) {
+                auto search = std::make_shared<ParallelSplitSearch>();
+                search->partition = partition;
+                search->statistics = statistics_of(partition);
+                search->splits.resize(variables.size());
+                search->remaining_variables = variables.size();
+                for (size_t variable = 0; variable < variables.size(); variable++) {
+                    schedule([this, search, variable] {
+                        search->splits[variable] = best_split(search->partition, variable, search->statistics);
+                        if (search->remaining_variables.fetch_sub(1) > 1) {
+                            return;
+                        }
+                        auto children = apply_best_split(search->partition, search->splits,
+                                                         impurity(search->statistics));
+                        if (children.has_value()) {
+                            auto [left, right] = children.value();
+                            schedule([this, right = right] { induce(right); });
+                            schedule([this, left = left] { induce(left); });
+                        }
+                    });
+                }
+                continue;
+            }
+
+            auto statistics = statistics_of(partition);
+            std::vector<Split> splits(variables.size());
+            for (size_t variable = 0; variable < variables.size(); variable++) {
+                splits[variable] = best_split(partition, variable, statistics);
+            }
+            auto children = apply_best_split(partition, splits, impurity(statistics));
+            if (!children.has_value()) {
+                continue;
+            }
+
+            // push the right child first such that the left one is processed first
+            auto [left, right] = children.value();
+            for (auto &child: {right, left}) {
+                if (thread_pool && child.size() >= tree.min_samples_per_parallel_task) {
+                    schedule([this, child] { induce(child); });
+                } else {
+                    partitions.push_back(child);
+                }
+            }
+        }
+    }
+
+    std::optional<std::pair<Partition, Partition>>
+    TreeInduction::apply_best_split(const Partition &partition, const std::vector<Split> &splits, double impurity) {
+        auto best_split = std::min_element(splits.begin(), splits.end(), [](const Split &left, const Split &right) {
+            return left.impurity < right.impurity;
+        });
+        if (best_split->impurity == std::numeric_limits<double>::infinity() ||
+            impurity - best_split->impurity < tree.min_impurity_improvement) {
+            add_leaf(partition);
+            return std::nullopt;
+        }
+        auto right_begin = partition_rows(partition, *best_split);
+        return std::make_pair(Partition{partition.begin, right_begin, partition.depth + 1},
+                              Partition{right_begin, partition.end, partition.depth + 1});
+    }
+
+    size_t TreeInduction::partition_rows(const Partition &partition, const Split &split) {
+        auto values = column(split.variable);
+        bool is_symbolic = kinds[split.variable] == VariableKind::SYMBOLIC;
+        auto &first_rows = sorted_rows[0];
+        for (auto index = partition.begin; index < partition.end; index++) {
+            auto row = first_rows[index];
+            goes_left[row] = is_symbolic ? values[row] == split.value : values[row] <= split.value;
+        }
+
+        // compact the left rows in place and buffer the right ones in the range of the partition
+        size_t right_begin = partition.begin;
+        for (auto &rows: sorted_rows) {
+            auto left_end = partition.begin;
+            auto right_end = partition.begin;
+            for (auto index = partition.begin; index < partition.end; index++) {
+                auto row = rows[index];
+                if (goes_left[row]) {
+                    rows[left_end++] = row;
+                } else {
+                    right_rows[right_end++] = row;
+                }
+            }
+            std::copy(right_rows.begin() + (long) partition.begin, right_rows.begin() + (long) right_end,
+                      rows.begin() + (long) left_end);
+            right_begin = left_end;
+        }
+        return right_begin;
+    }
+
+    void TreeInduction::add_leaf(const Partition &partition) {
+        std::lock_guard<std::mutex> lock(leaves_mutex);
+        leaves.push_back(partition);
+    }
+
+    ProbabilisticCircuitPtr_t TreeInduction::fit_leaf_distribution(const Partition &leaf, size_t variable) const {
+        auto &rows = sorted_rows[variable];
+        auto values = column(variable);
+
+        if (kinds[variable] == VariableKind::CONTINUOUS) {
+            FrequencyTable table;
+            for (auto index = leaf.begin; index < leaf.end; index++) {
+                table.append(values[rows[index]], 1.);
+            }
+            NygaDistribution distribution(std::static_pointer_cast<Continuous>(variables[variable]),
+                                          tree.min_samples_per_quantile, tree.min_likelihood_improvement);
+            return distribution.fit_frequency_table(table);
+        }
+
+        // the rows are sorted, hence the codes are inserted in ascending order
+        std::map<int, double> probabilities;
+        for (auto index = leaf.begin; index < leaf.end; index++) {
+            auto code = (int) values[rows[index]];
+            auto probability = probabilities.emplace_hint(probabilities.end(), code, 0.);
+            probability->second++;
+        }
+        for (auto &[code, probability]: probabilities) {
+            probability /= (double) leaf.size();
+        }
+        if (kinds[variable] == VariableKind::SYMBOLIC) {
+            return std::make_shared<SymbolicDistribution>(std::static_pointer_cast<Symbolic>(variables[variable]),
+                                                          std::move(probabilities));
+        }
+        return std::make_shared<IntegerDistribution>(std::static_pointer_cast<Integer>(variables[variable]),
+                                                     std::move(probabilities));
+    }
+
+    JointProbabilityTreePtr_t TreeInduction::fit() {
+        sorted_rows.resize(variables.size());
+        for (size_t variable = 0; variable < variables.size(); variable++) {
+            schedule([this, variable] { sort_rows(variable); });
+        }
+        run_tasks();
+
+        goes_left.resize(n_rows);
+        right_rows.resize(n_rows);
+        schedule([this] { induce(Partition{0, n_rows, 0}); });
+        run_tasks();
+
+        // the leaves cover disjoint ranges, sorting them by their ranges makes the result reproducible
+        std::sort(leaves.begin(), leaves.end(), [](const Partition &left, const Partition &right) {
+            return left.begin < right.begin;
+        });
+        std::vector<std::vector<ProbabilisticCircuitPtr_t>> leaf_distributions(
+                leaves.size(), std::vector<ProbabilisticCircuitPtr_t>(variables.size()));
+        for (size_t leaf = 0; leaf < leaves.size(); leaf++) {
+            for (size_t variable = 0; variable < variables.size(); variable++) {
+                schedule([this, &leaf_distributions, leaf, variable] {
+                    leaf_distributions[leaf][variable] = fit_leaf_distribution(leaves[leaf], variable);
+                });
+            }
+        }
+        run_tasks();
+
+        auto result = JointProbabilityTree::make_shared(tree.variables, tree.min_samples_per_leaf,
+                                                        tree.min_impurity_improvement);
+        result->max_depth = tree.max_depth;
+        result->min_samples_per_quantile = tree.min_samples_per_quantile;
+        result->min_likelihood_improvement = tree.min_likelihood_improvement;
+        result->number_of_threads = tree.number_of_threads;
+        result->min_samples_per_parallel_task = tree.min_samples_per_parallel_task;
+        for (size_t leaf = 0; leaf < leaves.size(); leaf++) {
+            auto product = std::make_shared<DecomposableProductUnit>();
+            for (auto &distribution: leaf_distributions[leaf]) {
+                product->add_subcircuit(distribution);
+            }
+            result->add_subcircuit((double) leaves[leaf].size() / (double) n_rows, product);
+        }
+        return result;
+    }
+
+}
+
+JointProbabilityTreePtr_t JointProbabilityTree::fit(const double *data, size_t n_rows) const {
+    if (variables->empty()) {
+        throw std::invalid_argument("Cannot fit a joint probability tree without variables.");
+    }
+    if (n_rows == 0) {
+        throw std::invalid_argument("Cannot fit a joint probability tree without data.");
+    }
+    TreeInduction induction(*this, data, n_rows);
+    return induction.fit();
+}
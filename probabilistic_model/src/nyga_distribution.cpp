@@ -2,6 +2,9 @@
 // Created by tom_sch on 15.05.24.
 //
 #include <include/nyga_distribution.h>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 
 NygaDistribution::NygaDistribution(const ContinuousPtr_t &variable, size_t min_samples_per_quantile,
                                    double min_likelihood_improvement) {
@@ -12,47 +15,79 @@ NygaDistribution::NygaDistribution(const ContinuousPtr_t &variable, size_t min_s
 }
 
 NygaDistributionPtr_t  NygaDistribution::fit(const DataVectorPtr_t &data_p) {
+    FrequencyTable table;
+    {
+        PROFILE_FIT_PHASE(FitPhase::SORT);
+        table = FrequencyTable::from_samples(*data_p);
+    }
+    return fit_frequency_table(table);
+}
 
-    auto result = NygaDistribution::make_shared(variable, min_samples_per_quantile, min_likelihood_improvement);
-
-    // sort the data
-    std::sort(data_p->begin(), data_p->end());
-
-    // create a map that maps from unique values to the frequency
-    auto frequencies = std::map<double, int>();
+NygaDistributionPtr_t NygaDistribution::fit_weighted(const DataVector &values, const WeightsVector &weights) {
+    if (values.size() != weights.size()) {
+        throw std::invalid_argument("The values and weights of a weighted fit must have the same size.");
+    }
+    if (std::any_of(weights.begin(), weights.end(), [](double weight) { return !(weight >= 0); })) {
+        throw std::invalid_argument("The weights of a weighted fit must not be negative.");
+    }
 
-    // initialize the previous element to a value that is not in the data
-    double previous_element = data_p->at(0) - 1;
+    FrequencyTable table;
+    {
+        PROFILE_FIT_PHASE(FitPhase::AGGREGATION);
+
+        // sort the indices if the values are not sorted already
+        std::vector<size_t> order(values.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (!std::is_sorted(values.begin(), values.end())) {
+            std::sort(order.begin(), order.end(), [&values](size_t left, size_t right) {
+                return values[left] < values[right];
+            });
+        }
 
-    // for every data point, update the frequencies
-    for (auto &data_point: *data_p) {
-        if (data_point == previous_element) {
-            frequencies[data_point]++;
-        } else {
-            frequencies[data_point] = 1;
-            previous_element = data_point;
+        table.values.reserve(values.size());
+        table.weights.reserve(values.size());
+        for (auto index: order) {
+            if (weights[index] > 0) {
+                table.append(values[index], weights[index]);
+            }
         }
     }
+    return fit_frequency_table(table);
+}
+
+NygaDistributionPtr_t NygaDistribution::fit_frequency_table(const FrequencyTable &table) {
+    if (table.size() == 0) {
+        throw std::invalid_argument("Cannot fit a Nyga Distribution without data.");
+    }
+    PROFILE_FIT();
+
+    // the quantiles and induction steps of the result live in its arena
+    auto result_arena = allocate_in_arena ? std::make_shared<Arena>() : ArenaPtr_t();
+    auto result = make_shared_in<NygaDistribution>(result_arena, variable, min_samples_per_quantile,
+                                                   min_likelihood_improvement);
+    result->allocate_in_arena = allocate_in_arena;
+    result->arena = result_arena;
 
-    if (frequencies.size() == 1) {
-        auto distribution = DiracDeltaDistribution::make_shared(variable, data_p->at(0));
+    if (table.size() == 1) {
+        auto distribution = make_shared_in<DiracDeltaDistribution>(result->arena, variable, table.values[0]);
         result->add_subcircuit(1., distribution);
         return result;
     }
 
     // create the data and weights vector
-    auto weights_p = new WeightsVector();
-    auto sorted_unique_data = new DataVector();
-    sorted_unique_data->reserve(frequencies.size());
-    weights_p->reserve(frequencies.size());
-
-    // write data and weights to new vectors
-    for (auto &[value, weight]: frequencies) {
-        weights_p->emplace_back(log(frequencies[value]));
-        sorted_unique_data->emplace_back(value);
+    auto weights_p = new WeightsVector(table.size());
+    auto sorted_unique_data = new DataVector(table.values);
+    InductionStepPtr_t initial_induction_step;
+    {
+        PROFILE_FIT_PHASE(FitPhase::AGGREGATION);
+        std::transform(table.weights.begin(), table.weights.end(), weights_p->begin(), [](double weight) {
+            return log(weight);
+        });
+        initial_induction_step = make_shared_in<InductionStep>(result->arena, sorted_unique_data, weights_p,
+                                                               InductionStep::cumulative_sums(*weights_p),
+                                                               InductionStep::cumulative_sums(table.weights), 0,
+                                                               table.size(), result);
     }
-
-    auto initial_induction_step = InductionStep::make_shared(data_p, weights_p, 0, frequencies.size(), result);
     result = fit_with_initial_induction_step(initial_induction_step);
 
     // clean up
@@ -62,24 +97,236 @@ NygaDistributionPtr_t  NygaDistribution::fit(const DataVectorPtr_t &data_p) {
     return result;
 }
 
+NygaDistributionPtr_t NygaDistribution::fit_streaming(const ChunkSource_t &next_chunk, size_t memory_budget) {
+    FrequencyTable table;
+    {
+        PROFILE_FIT_PHASE(FitPhase::AGGREGATION);
+        ExternalFrequencyAggregator aggregator(memory_budget);
+        DataVector chunk;
+        while (next_chunk(chunk)) {
+            aggregator.add_chunk(chunk);
+            chunk.clear();
+        }
+        table = aggregator.finish();
+    }
+    return fit_frequency_table(table);
+}
+
 NygaDistributionPtr_t  NygaDistribution::fit_with_initial_induction_step(const InductionStepPtr_t &initial_induction_step) {
-    auto induction_steps = std::queue<InductionStepPtr_t>();
-    induction_steps.push(initial_induction_step);
+    if (number_of_threads > 1) {
+        return fit_with_initial_induction_step_in_parallel(initial_induction_step);
+    }
+
+    // the steps and their depths
+    auto induction_steps = std::stack<std::pair<InductionStepPtr_t, size_t>>();
+    induction_steps.emplace(initial_induction_step, 0);
 
     while (!induction_steps.empty()) {
-        auto induction_step = induction_steps.front();
+        auto [induction_step, depth] = induction_steps.top();
         induction_steps.pop();
+        PROFILE_INDUCTION_STEP(depth);
         auto result = induction_step->induce();
         if (result.has_value()) {
             auto [left, right] = result.value();
-            induction_steps.push(left);
-            induction_steps.push(right);
+            // push the right step first such that the left one is processed first
+            induction_steps.emplace(right, depth + 1);
+            induction_steps.emplace(left, depth + 1);
+        }
+
+    }
+
+    return initial_induction_step->nyga_distribution_p;
+
+}
+
+NygaDistributionPtr_t
+NygaDistribution::fit_with_initial_induction_step_in_parallel(const InductionStepPtr_t &initial_induction_step) {
+    ThreadPool thread_pool(number_of_threads);
+
+    // the index ranges of the quantiles found by all tasks
+    std::vector<std::pair<size_t, size_t>> quantiles;
+    std::mutex quantiles_mutex;
+
+    std::function<void(const InductionStepPtr_t &, size_t)> process_subtree = [&](
+            const InductionStepPtr_t &subtree_root, size_t subtree_depth) {
+        auto induction_steps = std::stack<std::pair<InductionStepPtr_t, size_t>>();
+        induction_steps.emplace(subtree_root, subtree_depth);
+        std::vector<std::pair<size_t, size_t>> local_quantiles;
+
+        while (!induction_steps.empty()) {
+            auto [induction_step, depth] = induction_steps.top();
+            induction_steps.pop();
+            PROFILE_INDUCTION_STEP(depth);
+
+            auto split_index = induction_step->split_index_if_beneficial();
+            if (!split_index.has_value()) {
+                local_quantiles.emplace_back(induction_step->begin_index, induction_step->end_index);
+                continue;
+            }
+
+            auto right = induction_step->construct_right_induction_step(split_index.value());
+            if (right->number_of_samples() >= min_samples_per_parallel_task) {
+                thread_pool.submit([&process_subtree, right, depth = depth] { process_subtree(right, depth + 1); });
+            } else {
+                induction_steps.emplace(right, depth + 1);
+            }
+            induction_steps.emplace(induction_step->construct_left_induction_step(split_index.value()), depth + 1);
         }
 
+        std::lock_guard<std::mutex> lock(quantiles_mutex);
+        quantiles.insert(quantiles.end(), local_quantiles.begin(), local_quantiles.end());
+    };
+
+    thread_pool.submit([&process_subtree, &initial_induction_step] { process_subtree(initial_induction_step, 0); });
+    thread_pool.wait();
+
+    // mount the quantiles sequentially and in ascending order to get a reproducible model
+    std::sort(quantiles.begin(), quantiles.end());
+    for (auto [begin_index, end_index]: quantiles) {
+        initial_induction_step->mount_distribution_from_indices(begin_index, end_index);
     }
 
     return initial_induction_step->nyga_distribution_p;
+}
+
+std::pair<double, size_t>
+CumulativeMassTable::cumulative_mass(double value, bool inclusive, size_t first_quantile) const {
+
+    // the number of quantiles that start before the value, or at it if the value is included
+    auto end = inclusive ? std::upper_bound(lowers.begin() + (long) first_quantile, lowers.end(), value) :
+               std::lower_bound(lowers.begin() + (long) first_quantile, lowers.end(), value);
+    auto number_of_quantiles = (size_t) (end - lowers.begin());
+    if (number_of_quantiles == 0) {
+        return {0., 0};
+    }
+
+    // the last of these quantiles may only be covered partially
+    auto index = number_of_quantiles - 1;
+    auto width = uppers[index] - lowers[index];
+    double covered_fraction;
+    if (width > 0) {
+        covered_fraction = std::min(1., (value - lowers[index]) / width);
+    } else {
+        covered_fraction = 1.;
+    }
+    auto mass = cumulative_masses[index + 1] - cumulative_masses[index];
+    return {cumulative_masses[index] + covered_fraction * mass, index};
+}
+
+CumulativeMassTablePtr_t NygaDistribution::cumulative_mass_table() const {
+    auto result = std::atomic_load(&cumulative_mass_table_cache);
+    if (result && result->number_of_sub_circuits == sub_circuits.size()) {
+        return result;
+    }
+    if (sub_circuits.empty()) {
+        throw std::logic_error("Cannot query a Nyga Distribution without quantiles.");
+    }
+
+    std::vector<std::tuple<double, double, double>> quantiles;
+    quantiles.reserve(sub_circuits.size());
+    for (size_t index = 0; index < sub_circuits.size(); index++) {
+        if (auto uniform = dynamic_cast<const UniformDistribution *>(sub_circuits[index].get())) {
+            if (uniform->support->simple_sets->size() != 1) {
+                throw std::logic_error("Cannot query quantiles with supports made of multiple intervals.");
+            }
+            quantiles.emplace_back(uniform->support->lower(), uniform->support->upper(), weights[index]);
+        } else if (auto dirac_delta = dynamic_cast<const DiracDeltaDistribution *>(sub_circuits[index].get())) {
+            quantiles.emplace_back(dirac_delta->location, dirac_delta->location, weights[index]);
+        } else {
+            throw std::logic_error("Cannot query quantile " + sub_circuits[index]->representation());
+        }
+    }
+    std::sort(quantiles.begin(), quantiles.end());
+
+    auto table = std::make_shared<CumulativeMassTable>();
+    table->number_of_sub_circuits = sub_circuits.size();
+    table->cumulative_masses.push_back(0.);
+    for (auto &[lower, upper, weight]: quantiles) {
+        table->lowers.push_back(lower);
+        table->uppers.push_back(upper);
+        table->cumulative_masses.push_back(table->cumulative_masses.back() + weight);
+    }
+    auto total = table->cumulative_masses.back();
+    for (auto &cumulative_mass: table->cumulative_masses) {
+        cumulative_mass /= total;
+    }
+
+    result = table;
+    std::atomic_store(&cumulative_mass_table_cache, result);
+    return result;
+}
+
+double NygaDistribution::cdf(double value) const {
+    return cumulative_mass_table()->cumulative_mass(value, true).first;
+}
+
+void NygaDistribution::cdf(const double *values, size_t n, double *out) const {
+    auto table = cumulative_mass_table();
+    for (size_t index = 0; index < n; index++) {
+        out[index] = table->cumulative_mass(values[index], true).first;
+    }
+}
+
+double NygaDistribution::quantile(double probability) const {
+    double result;
+    quantile(&probability, 1, &result);
+    return result;
+}
+
+void NygaDistribution::quantile(const double *probabilities, size_t n, double *out) const {
+    auto table = cumulative_mass_table();
+    auto &cumulative_masses = table->cumulative_masses;
+    for (size_t index = 0; index < n; index++) {
+        auto probability = probabilities[index];
+        if (!(probability >= 0. && probability <= 1.)) {
+            throw std::invalid_argument("The probability of a quantile must be in [0, 1], got " +
+                                        std::to_string(probability) + ".");
+        }
+
+        // the first quantile whose cumulative mass reaches the probability
+        auto quantile_index = (size_t) (std::lower_bound(cumulative_masses.begin() + 1, cumulative_masses.end() - 1,
+                                                         probability) - cumulative_masses.begin()) - 1;
+        auto mass = cumulative_masses[quantile_index + 1] - cumulative_masses[quantile_index];
+        auto covered_fraction = mass > 0 ? (probability - cumulative_masses[quantile_index]) / mass : 0.;
+        covered_fraction = std::max(0., std::min(1., covered_fraction));
+        out[index] = table->lowers[quantile_index] +
+                     covered_fraction * (table->uppers[quantile_index] - table->lowers[quantile_index]);
+    }
+}
+
+double NygaDistribution::probability(const ContinuousSupportPtr_t &event) const {
+    auto table = cumulative_mass_table();
+    double result = 0;
+    size_t first_quantile = 0;
+    for (auto &simple_set: *event->simple_sets) {
+        auto interval = std::static_pointer_cast<SimpleInterval<double>>(simple_set);
+        auto [lower_mass, lower_quantile] = table->cumulative_mass(interval->lower,
+                                                                   interval->left == BorderType::OPEN, first_quantile);
+        auto [upper_mass, upper_quantile] = table->cumulative_mass(interval->upper,
+                                                                   interval->right == BorderType::CLOSED,
+                                                                   lower_quantile);
+        result += upper_mass - lower_mass;
+        first_quantile = upper_quantile;
+    }
+    return result;
+}
 
+void NygaDistribution::probability_of_events(const std::vector<ProductEvent> &events, const ProbabilityMemo & /*memo*/,
+                                             double *out) const {
+    for (size_t index = 0; index < events.size(); index++) {
+        auto constraint = events[index].find(variable);
+        out[index] = constraint == events[index].end() ? 1. :
+                     probability(std::static_pointer_cast<Interval<double>>(constraint->second));
+    }
+}
+
+void NygaDistribution::probability(const double *lowers, const double *uppers, size_t n, double *out) const {
+    auto table = cumulative_mass_table();
+    for (size_t index = 0; index < n; index++) {
+        auto [lower_mass, lower_quantile] = table->cumulative_mass(lowers[index], false);
+        auto upper_mass = table->cumulative_mass(uppers[index], false, lower_quantile).first;
+        out[index] = std::max(0., upper_mass - lower_mass);
+    }
 }
 
 double InductionStep::left_connecting_point_from_index(size_t index) const {
@@ -117,7 +364,7 @@ InductionStep::create_uniform_distribution_from_indices(size_t begin_index_, siz
                                right_connecting_point_from_index(end_index_));
     }
     auto variable = std::static_pointer_cast<Continuous>(nyga_distribution_p->variable);
-    return UniformDistribution::make_shared(variable, interval);
+    return make_shared_in<UniformDistribution>(nyga_distribution_p->arena, variable, interval);
 }
 
 UniformDistributionPtr_t InductionStep::create_uniform_distribution() const {
@@ -126,6 +373,7 @@ UniformDistributionPtr_t InductionStep::create_uniform_distribution() const {
 
 
 std::tuple<double, int> InductionStep::compute_best_split() const {
+    PROFILE_FIT_PHASE(FitPhase::SPLIT_SEARCH);
     double maximum_log_likelihood = -std::numeric_limits<double>::infinity();
     int best_split_index = -1;
 
@@ -152,31 +400,53 @@ std::tuple<double, int> InductionStep::compute_best_split() const {
         }
 
     }
+    PROFILE_CANDIDATE_SPLITS(number_of_candidate_splits());
     return std::make_tuple(maximum_log_likelihood, best_split_index);
 }
 
+size_t InductionStep::number_of_candidate_splits() const {
+    auto min_samples_per_quantile = nyga_distribution_p->min_samples_per_quantile;
+    if (end_index + 1 < begin_index + 2 * min_samples_per_quantile) {
+        return 0;
+    }
+    return end_index + 1 - begin_index - 2 * min_samples_per_quantile;
+}
+
 InductionStepPtr_t InductionStep::construct_left_induction_step(size_t split_index) const {
-    return InductionStep::make_shared(data_p, log_weights_p, begin_index, split_index, nyga_distribution_p);
+    return make_shared_in<InductionStep>(nyga_distribution_p->arena, data_p, log_weights_p, cumulative_log_weights_p,
+                                         cumulative_weights_p, begin_index, split_index, nyga_distribution_p);
 }
 
 InductionStepPtr_t InductionStep::construct_right_induction_step(size_t split_index) const {
-    return InductionStep::make_shared(data_p, log_weights_p, split_index, end_index, nyga_distribution_p);
+    return make_shared_in<InductionStep>(nyga_distribution_p->arena, data_p, log_weights_p, cumulative_log_weights_p,
+                                         cumulative_weights_p, split_index, end_index, nyga_distribution_p);
 }
 
-std::optional<std::pair<InductionStepPtr_t, InductionStepPtr_t>> InductionStep::induce() {
-    double summed_weights = sum_weights();
+std::optional<size_t> InductionStep::split_index_if_beneficial() const {
     double log_pdf = -log(right_connecting_point() - left_connecting_point());
-    double log_likelihood_without_split = log_pdf + summed_weights;
+    double log_likelihood_without_split = log_pdf + sum_weights();
 
     auto [best_log_likelihood, best_split_index] = compute_best_split();
     if (best_log_likelihood > log_likelihood_without_split +  log(1. + nyga_distribution_p->min_likelihood_improvement)) {
-        return std::make_pair(construct_left_induction_step(best_split_index),
-                              construct_right_induction_step(best_split_index));
+        return best_split_index;
+    }
+    return std::nullopt;
+}
+
+void InductionStep::mount_distribution_from_indices(size_t begin_index_, size_t end_index_) const {
+    auto distribution = create_uniform_distribution_from_indices(begin_index_, end_index_);
+    nyga_distribution_p->add_subcircuit(probability_from_indices(begin_index_, end_index_), distribution);
+}
+
+std::optional<std::pair<InductionStepPtr_t, InductionStepPtr_t>> InductionStep::induce() {
+    auto split_index = split_index_if_beneficial();
+    if (split_index.has_value()) {
+        return std::make_pair(construct_left_induction_step(split_index.value()),
+                              construct_right_induction_step(split_index.value()));
     }
 
     // create uniform distribution and mount it into the nyga distribution
-    auto distribution = create_uniform_distribution();
-    nyga_distribution_p->add_subcircuit(summed_weights, distribution);
+    mount_distribution_from_indices(begin_index, end_index);
     return std::nullopt;
 }
 
@@ -185,10 +455,25 @@ double InductionStep::sum_weights() const {
 }
 
 double InductionStep::sum_weights_from_indices(size_t begin_index_, size_t end_index_) const {
-    double result = 0;
-    for (size_t i = begin_index_; i < end_index_; i++) {
-        result += (*log_weights_p)[i];
-    }
+    return (*cumulative_log_weights_p)[end_index_] - (*cumulative_log_weights_p)[begin_index_];
+}
+
+double InductionStep::probability_from_indices(size_t begin_index_, size_t end_index_) const {
+    return ((*cumulative_weights_p)[end_index_] - (*cumulative_weights_p)[begin_index_]) / cumulative_weights_p->back();
+}
+
+std::shared_ptr<const WeightsVector> InductionStep::cumulative_sums_of_exponentials(const WeightsVector &log_weights) {
+    WeightsVector weights(log_weights.size());
+    std::transform(log_weights.begin(), log_weights.end(), weights.begin(), [](double log_weight) {
+        return exp(log_weight);
+    });
+    return cumulative_sums(weights);
+}
+
+std::shared_ptr<const WeightsVector> InductionStep::cumulative_sums(const WeightsVector &weights) {
+    auto result = std::make_shared<WeightsVector>(weights.size() + 1);
+    (*result)[0] = 0;
+    std::partial_sum(weights.begin(), weights.end(), result->begin() + 1);
     return result;
 }
 
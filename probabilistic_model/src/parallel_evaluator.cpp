@@ -0,0 +1,62 @@
+#include <include/parallel_evaluator.h>
+#include <stdexcept>
+
+ParallelEvaluator::ParallelEvaluator(std::shared_ptr<const ProbabilisticModel> model, const CircuitTape &circuit_tape,
+                                     size_t number_of_threads, int numa_node, size_t block_size) :
+        block_size(block_size), model(std::move(model)), circuit_tape(circuit_tape) {
+    if (block_size == 0) {
+        throw std::invalid_argument("The block size must be positive");
+    }
+    std::vector<size_t> cpus;
+    if (numa_node >= 0) {
+        cpus = cpus_of_numa_node((size_t) numa_node);
+        if (number_of_threads == 0) {
+            number_of_threads = cpus.size();
+        }
+    }
+    thread_pool = ThreadPool::make_shared(number_of_threads);
+    if (!cpus.empty()) {
+        thread_pool->pin_workers(cpus);
+    }
+    worker_scratches.resize(thread_pool->size());
+}
+
+ParallelEvaluator::ParallelEvaluator(const ProbabilisticCircuitPtr_t &circuit, size_t number_of_threads,
+                                     int numa_node, size_t block_size) :
+        ParallelEvaluator(nullptr, CircuitTape(), number_of_threads, numa_node, block_size) {
+    auto compiled = CompiledCircuit::make_shared(circuit);
+    circuit_tape = compiled->tape();
+    model = compiled;
+}
+
+void ParallelEvaluator::log_likelihood_batch(const double *data, size_t n_rows, double *out) {
+    std::lock_guard<std::mutex> lock(evaluation_mutex);
+    std::atomic<size_t> next_block{0};
+    for (size_t worker = 0; worker < thread_pool->size(); worker++) {
+        thread_pool->submit([this, data, n_rows, out, &next_block] {
+            evaluate_blocks(data, n_rows, out, next_block);
+        });
+    }
+    thread_pool->wait();
+}
+
+void ParallelEvaluator::evaluate_blocks(const double *data, size_t n_rows, double *out,
+                                        std::atomic<size_t> &next_block) {
+
+    // a worker runs one task at a time, hence its buffers are never used concurrently
+    auto &worker = worker_scratches[thread_pool->current_worker_index()];
+    if (worker.scratch.empty()) {
+        worker.scratch.resize(circuit_tape.scratch_size(block_size));
+        worker.columns.resize(circuit_tape.number_of_variables);
+    }
+
+    size_t block_begin;
+    while ((block_begin = next_block.fetch_add(1, std::memory_order_relaxed) * block_size) < n_rows) {
+        auto rows = std::min(block_size, n_rows - block_begin);
+        for (size_t column = 0; column < worker.columns.size(); column++) {
+            worker.columns[column] = data + column * n_rows + block_begin;
+        }
+        PROFILE_NODE_EVALUATION(rows);
+        circuit_tape.log_likelihood_of_columns(worker.columns, rows, out + block_begin, worker.scratch.data());
+    }
+}
@@ -0,0 +1,458 @@
+#include <include/probabilistic_circuit.h>
+#include <include/univariate.h>
+#include <include/thread_pool.h>
+#include <functional>
+#include <numeric>
+#include <unordered_set>
+
+namespace {
+
+    /**
+     * The distinct nodes of a circuit in post order, the columns of their variables in the data of the root and the
+     * positions of their subcircuits in the order.
+     */
+    struct CircuitLayout {
+        std::vector<const ProbabilisticCircuit *> nodes;
+        std::vector<std::vector<size_t>> column_indices;
+        std::vector<std::vector<size_t>> sub_circuit_indices;
+        size_t number_of_columns;
+
+        explicit CircuitLayout(const ProbabilisticCircuit &root) : nodes(root.nodes_in_post_order()),
+                                                                   column_indices(nodes.size()),
+                                                                   sub_circuit_indices(nodes.size()) {
+            auto variables = root.get_variables();
+            std::vector<AbstractVariablePtr_t> ordered_variables(variables->begin(), variables->end());
+            number_of_columns = ordered_variables.size();
+            std::unordered_map<const ProbabilisticCircuit *, size_t> node_indices;
+            for (size_t index = 0; index < nodes.size(); index++) {
+                node_indices.emplace(nodes[index], index);
+            }
+            for (size_t index = 0; index < nodes.size(); index++) {
+                auto node_variables = nodes[index]->get_variables();
+                for (auto &variable: *node_variables) {
+                    auto position = std::lower_bound(ordered_variables.begin(), ordered_variables.end(), variable,
+                                                     PointerLess<AbstractVariablePtr_t>());
+                    column_indices[index].push_back((size_t) (position - ordered_variables.begin()));
+                }
+                for (auto &sub_circuit: nodes[index]->sub_circuits) {
+                    sub_circuit_indices[index].push_back(node_indices.at(sub_circuit.get()));
+                }
+            }
+        }
+
+        /**
+         * Point to the columns of a node in a block of column-major data.
+         */
+        template<typename Pointers, typename Scalar>
+        void block_columns(size_t index, Scalar *data, size_t n_rows, size_t block_begin, Pointers &columns) const {
+            columns.clear();
+            for (auto column: column_indices[index]) {
+                columns.push_back(data + column * n_rows + block_begin);
+            }
+        }
+    };
+
+    /**
+     * The buffers of the bottom-up and top-down passes over the blocks of one thread.
+     *
+     * The flow of a node is the derivative of the log-likelihood of the root with respect to the log-likelihood of the
+     * node, i.e. the posterior probability that a row passes through the node.
+     */
+    struct FlowBuffers {
+        size_t block_size = 0;
+        std::vector<double> log_likelihoods;
+        std::vector<double> flows;
+        std::vector<double> scratch;
+        std::vector<std::vector<double>> expected_counts;
+
+        /**
+         * The sum of the log-likelihoods of the possible rows.
+         */
+        double log_likelihood = 0;
+
+        ColumnPointers node_columns;
+        ColumnPointers sub_circuit_log_likelihoods;
+        SampleColumnPointers sub_circuit_flows;
+
+        /**
+         * Allocate the buffers for blocks of a size and reset the expected counts.
+         */
+        void reset(const CircuitLayout &layout, size_t new_block_size) {
+            auto &nodes = layout.nodes;
+            block_size = new_block_size;
+            log_likelihoods.resize(nodes.size() * block_size);
+            flows.resize(nodes.size() * block_size);
+            scratch.resize(block_size);
+            expected_counts.resize(nodes.size());
+            for (size_t index = 0; index < nodes.size(); index++) {
+                expected_counts[index].assign(nodes[index]->number_of_expected_counts(), 0.);
+            }
+            log_likelihood = 0;
+        }
+
+        double *node_log_likelihoods(size_t index) {
+            return log_likelihoods.data() + index * block_size;
+        }
+
+        double *node_flows(size_t index) {
+            return flows.data() + index * block_size;
+        }
+
+        /**
+         * Point to the log-likelihoods and flows of the subcircuits of a node.
+         */
+        void point_to_sub_circuits(const CircuitLayout &layout, size_t index) {
+            sub_circuit_log_likelihoods.clear();
+            sub_circuit_flows.clear();
+            for (auto sub_circuit_index: layout.sub_circuit_indices[index]) {
+                sub_circuit_log_likelihoods.push_back(node_log_likelihoods(sub_circuit_index));
+                sub_circuit_flows.push_back(node_flows(sub_circuit_index));
+            }
+        }
+
+        /**
+         * Evaluate all nodes for a block bottom-up, then propagate the flows top-down and accumulate the expected
+         * counts.
+         */
+        void propagate(const CircuitLayout &layout, const double *data, size_t n_rows, size_t block_begin,
+                       size_t block_rows) {
+            auto &nodes = layout.nodes;
+            auto root_index = nodes.size() - 1;
+
+            for (size_t index = 0; index < nodes.size(); index++) {
+                layout.block_columns(index, data, n_rows, block_begin, node_columns);
+                point_to_sub_circuits(layout, index);
+                nodes[index]->log_likelihood_of_sub_circuits(node_columns, block_rows, sub_circuit_log_likelihoods,
+                                                             node_log_likelihoods(index), scratch.data());
+            }
+
+            // every possible row enters the root with a flow of 1
+            auto root_log_likelihoods = node_log_likelihoods(root_index);
+            auto root_flows = node_flows(root_index);
+            std::fill(flows.data(), root_flows, 0.);
+            for (size_t row = 0; row < block_rows; row++) {
+                bool is_possible = root_log_likelihoods[row] > -std::numeric_limits<double>::infinity();
+                root_flows[row] = is_possible ? 1. : 0.;
+                log_likelihood += is_possible ? root_log_likelihoods[row] : 0.;
+            }
+
+            // the parents of every node come before it in reverse post order
+            for (size_t index = nodes.size(); index-- > 0;) {
+                layout.block_columns(index, data, n_rows, block_begin, node_columns);
+                point_to_sub_circuits(layout, index);
+                nodes[index]->accumulate_expected_counts(node_columns, block_rows, node_log_likelihoods(index),
+                                                         node_flows(index), sub_circuit_log_likelihoods,
+                                                         sub_circuit_flows, expected_counts[index].data());
+            }
+        }
+    };
+
+    /**
+     * Accumulate the expected counts of a range of blocks.
+     */
+    void expectation_step(const CircuitLayout &layout, const double *data, size_t n_rows, size_t block_size,
+                          size_t first_block, size_t last_block, FlowBuffers &shard) {
+        shard.reset(layout, block_size);
+        for (size_t block = first_block; block < last_block; block++) {
+            auto block_begin = block * block_size;
+            shard.propagate(layout, data, n_rows, block_begin, std::min(block_size, n_rows - block_begin));
+        }
+    }
+}
+
+std::vector<const ProbabilisticCircuit *>
+ProbabilisticCircuit::nodes_in_post_order(const std::function<bool(const ProbabilisticCircuit &)> &descend) const {
+    std::vector<const ProbabilisticCircuit *> result;
+    std::unordered_set<const ProbabilisticCircuit *> visited;
+
+    // iterative traversal such that deep circuits do not exhaust the stack
+    std::vector<std::pair<const ProbabilisticCircuit *, bool>> stack{{this, false}};
+    while (!stack.empty()) {
+        auto [node, sub_circuits_are_visited] = stack.back();
+        stack.pop_back();
+        if (visited.count(node) > 0) {
+            continue;
+        }
+        if (sub_circuits_are_visited || (descend && !descend(*node))) {
+            visited.insert(node);
+            result.push_back(node);
+            continue;
+        }
+        stack.emplace_back(node, true);
+        for (auto sub_circuit = node->sub_circuits.rbegin(); sub_circuit != node->sub_circuits.rend(); sub_circuit++) {
+            if (visited.count(sub_circuit->get()) == 0) {
+                stack.emplace_back(sub_circuit->get(), false);
+            }
+        }
+    }
+    return result;
+}
+
+void ProbabilisticCircuit::probability(const std::vector<ProductEvent> &events, double *out) const {
+    ProbabilityMemo memo;
+    auto nodes = nodes_in_post_order([](const ProbabilisticCircuit &node) {
+        return node.probability_uses_sub_circuits();
+    });
+    for (auto node: nodes) {
+        auto &node_probabilities = memo[node];
+        node_probabilities.resize(events.size());
+        node->probability_of_events(events, memo, node_probabilities.data());
+    }
+    auto &root_probabilities = memo.at(this);
+    std::copy(root_probabilities.begin(), root_probabilities.end(), out);
+}
+
+ProbabilisticCircuitPtr_t
+ProbabilisticCircuit::marginal(const AbstractVariableSetPtr_t &variables, MarginalCache &cache) const {
+    auto own_variables = get_variables();
+    std::vector<AbstractVariablePtr_t> kept_variables;
+    std::set_intersection(own_variables->begin(), own_variables->end(), variables->begin(), variables->end(),
+                          std::back_inserter(kept_variables), PointerLess<AbstractVariablePtr_t>());
+    if (kept_variables.empty()) {
+        return nullptr;
+    }
+    if (kept_variables.size() == own_variables->size()) {
+        if (auto self = weak_from_this().lock()) {
+            return std::const_pointer_cast<ProbabilisticCircuit>(self);
+        }
+    }
+
+    auto key = std::make_pair(this, std::move(kept_variables));
+    auto cached = cache.find(key);
+    if (cached != cache.end()) {
+        return cached->second;
+    }
+
+    std::vector<ProbabilisticCircuitPtr_t> sub_circuit_marginals;
+    sub_circuit_marginals.reserve(sub_circuits.size());
+    for (auto &sub_circuit: sub_circuits) {
+        sub_circuit_marginals.push_back(sub_circuit->marginal(variables, cache));
+    }
+    auto result = marginal_from_sub_circuits(sub_circuit_marginals);
+    cache.emplace(std::move(key), result);
+    return result;
+}
+
+void ProbabilisticCircuit::most_probable_explanation(const double *data, size_t n_rows, double *assignments,
+                                                     double *max_log_likelihoods) const {
+    if (n_rows == 0) {
+        return;
+    }
+    CircuitLayout layout(*this);
+    auto &nodes = layout.nodes;
+
+    // one block of maxima and choices per node, reused for every block of rows
+    auto block_size = std::min(batch_block_size, n_rows);
+    std::vector<double> maxima(nodes.size() * block_size);
+    std::vector<uint32_t> argmaxes(nodes.size() * block_size);
+    std::vector<double> scratch(block_size);
+    std::vector<std::vector<size_t>> node_rows(nodes.size());
+    ColumnPointers node_columns;
+    ColumnPointers sub_circuit_maxima;
+    SampleColumnPointers node_assignment_columns;
+    std::vector<std::vector<size_t> *> sub_circuit_rows;
+
+    for (size_t block_begin = 0; block_begin < n_rows; block_begin += block_size) {
+        auto block_rows = std::min(block_size, n_rows - block_begin);
+
+        // bottom-up max-product pass
+        for (size_t index = 0; index < nodes.size(); index++) {
+            layout.block_columns(index, data, n_rows, block_begin, node_columns);
+            sub_circuit_maxima.clear();
+            for (auto sub_circuit_index: layout.sub_circuit_indices[index]) {
+                sub_circuit_maxima.push_back(maxima.data() + sub_circuit_index * block_size);
+            }
+            nodes[index]->max_log_likelihood_of_columns(node_columns, block_rows, sub_circuit_maxima,
+                                                        maxima.data() + index * block_size,
+                                                        argmaxes.data() + index * block_size, scratch.data());
+        }
+        if (max_log_likelihoods != nullptr) {
+            auto root_maxima = maxima.data() + (nodes.size() - 1) * block_size;
+            std::copy(root_maxima, root_maxima + block_rows, max_log_likelihoods + block_begin);
+        }
+
+        // top-down backtracking, the parents of every node come before it in reverse post order
+        for (size_t column = 0; column < layout.number_of_columns; column++) {
+            std::copy(data + column * n_rows + block_begin, data + column * n_rows + block_begin + block_rows,
+                      assignments + column * n_rows + block_begin);
+        }
+        for (auto &rows: node_rows) {
+            rows.clear();
+        }
+        node_rows.back().resize(block_rows);
+        std::iota(node_rows.back().begin(), node_rows.back().end(), 0);
+        for (size_t index = nodes.size(); index-- > 0;) {
+            if (node_rows[index].empty()) {
+                continue;
+            }
+            layout.block_columns(index, assignments, n_rows, block_begin, node_assignment_columns);
+            sub_circuit_rows.clear();
+            for (auto sub_circuit_index: layout.sub_circuit_indices[index]) {
+                sub_circuit_rows.push_back(&node_rows[sub_circuit_index]);
+            }
+            nodes[index]->most_probable_rows(node_rows[index].data(), node_rows[index].size(),
+                                             argmaxes.data() + index * block_size, sub_circuit_rows,
+                                             node_assignment_columns);
+        }
+    }
+}
+
+std::vector<double> ProbabilisticCircuit::expectation_maximization(const double *data, size_t n_rows,
+                                                                   size_t number_of_iterations,
+                                                                   size_t number_of_threads) {
+    std::vector<double> result;
+    if (n_rows == 0) {
+        return result;
+    }
+    CircuitLayout layout(*this);
+    auto block_size = std::min(batch_block_size, n_rows);
+    auto number_of_blocks = (n_rows + block_size - 1) / block_size;
+    std::vector<FlowBuffers> shards(std::max((size_t) 1, std::min(number_of_threads, number_of_blocks)));
+    auto thread_pool = shards.size() > 1 ? ThreadPool::make_shared(shards.size()) : nullptr;
+
+    for (size_t iteration = 0; iteration < number_of_iterations; iteration++) {
+        for (size_t shard = 0; shard < shards.size(); shard++) {
+            auto first_block = shard * number_of_blocks / shards.size();
+            auto last_block = (shard + 1) * number_of_blocks / shards.size();
+            auto task = [&layout, &shards, data, n_rows, block_size, shard, first_block, last_block] {
+                expectation_step(layout, data, n_rows, block_size, first_block, last_block, shards[shard]);
+            };
+            if (thread_pool) {
+                thread_pool->submit(task);
+            } else {
+                task();
+            }
+        }
+        if (thread_pool) {
+            thread_pool->wait();
+        }
+
+        // reduce into the first shard in the order of the shards
+        auto &expected_counts = shards[0].expected_counts;
+        auto log_likelihood = shards[0].log_likelihood;
+        for (size_t shard = 1; shard < shards.size(); shard++) {
+            log_likelihood += shards[shard].log_likelihood;
+            for (size_t index = 0; index < layout.nodes.size(); index++) {
+                std::transform(expected_counts[index].begin(), expected_counts[index].end(),
+                               shards[shard].expected_counts[index].begin(), expected_counts[index].begin(),
+                               std::plus<>());
+            }
+        }
+        result.push_back(log_likelihood);
+
+        // the nodes are reachable from this circuit, which is not const
+        for (size_t index = 0; index < layout.nodes.size(); index++) {
+            const_cast<ProbabilisticCircuit *>(layout.nodes[index])->maximize_expected_counts(
+                    expected_counts[index].data());
+        }
+    }
+    return result;
+}
+
+size_t ProbabilisticCircuit::number_of_sum_weights() const {
+    size_t result = 0;
+    for (auto node: nodes_in_post_order()) {
+        result += node->number_of_weights();
+    }
+    return result;
+}
+
+void ProbabilisticCircuit::log_likelihood_gradient(const double *data, size_t n_rows, double *log_likelihoods,
+                                                   double *weight_gradients, double *input_gradients) const {
+    CircuitLayout layout(*this);
+    std::vector<size_t> weight_offsets(layout.nodes.size() + 1, 0);
+    for (size_t index = 0; index < layout.nodes.size(); index++) {
+        weight_offsets[index + 1] = weight_offsets[index] + layout.nodes[index]->number_of_weights();
+    }
+    std::vector<double> discarded_weight_gradients;
+    if (weight_gradients == nullptr) {
+        discarded_weight_gradients.resize(weight_offsets.back());
+        weight_gradients = discarded_weight_gradients.data();
+    }
+    std::fill(weight_gradients, weight_gradients + weight_offsets.back(), 0.);
+    if (input_gradients != nullptr) {
+        std::fill(input_gradients, input_gradients + layout.number_of_columns * n_rows, 0.);
+    }
+    if (n_rows == 0) {
+        return;
+    }
+
+    auto block_size = std::min(batch_block_size, n_rows);
+    FlowBuffers buffers;
+    buffers.reset(layout, block_size);
+    std::vector<double> discarded_input_gradients(input_gradients == nullptr ? block_size : 0);
+    SampleColumnPointers input_gradient_columns;
+    auto root_index = layout.nodes.size() - 1;
+
+    for (size_t block_begin = 0; block_begin < n_rows; block_begin += block_size) {
+        auto block_rows = std::min(block_size, n_rows - block_begin);
+        buffers.propagate(layout, data, n_rows, block_begin, block_rows);
+        if (log_likelihoods != nullptr) {
+            std::copy_n(buffers.node_log_likelihoods(root_index), block_rows, log_likelihoods + block_begin);
+        }
+
+        for (size_t index = 0; index < layout.nodes.size(); index++) {
+            if (input_gradients != nullptr) {
+                layout.block_columns(index, input_gradients, n_rows, block_begin, input_gradient_columns);
+            } else {
+                input_gradient_columns.assign(layout.column_indices[index].size(), discarded_input_gradients.data());
+            }
+            layout.block_columns(index, data, n_rows, block_begin, buffers.node_columns);
+            buffers.point_to_sub_circuits(layout, index);
+            layout.nodes[index]->accumulate_gradients(buffers.node_columns, block_rows,
+                                                      buffers.node_log_likelihoods(index), buffers.node_flows(index),
+                                                      buffers.sub_circuit_log_likelihoods,
+                                                      weight_gradients + weight_offsets[index],
+                                                      input_gradient_columns);
+        }
+    }
+}
+
+IntervalIndexPtr_t DeterministicSumUnit::build_interval_index() const {
+    auto result = std::make_shared<IntervalIndex>();
+    result->number_of_sub_circuits = sub_circuits.size();
+    if (sub_circuits.empty()) {
+        return result;
+    }
+
+    std::vector<std::shared_ptr<SimpleInterval<double>>> intervals;
+    intervals.reserve(sub_circuits.size());
+    for (auto &sub_circuit: sub_circuits) {
+        auto uniform = dynamic_cast<const UniformDistribution *>(sub_circuit.get());
+        if (uniform == nullptr || uniform->support->simple_sets->size() != 1 ||
+            uniform->variable != std::static_pointer_cast<UniformDistribution>(sub_circuits[0])->variable) {
+            return result;
+        }
+        intervals.push_back(std::static_pointer_cast<SimpleInterval<double>>(*uniform->support->simple_sets->begin()));
+    }
+
+    std::vector<size_t> order(sub_circuits.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&intervals](size_t left, size_t right) {
+        return std::make_pair(intervals[left]->lower, intervals[left]->upper) <
+               std::make_pair(intervals[right]->lower, intervals[right]->upper);
+    });
+
+    // consecutive intervals may touch but must not share a point
+    for (size_t position = 1; position < order.size(); position++) {
+        auto &previous = intervals[order[position - 1]];
+        auto &current = intervals[order[position]];
+        bool share_border = previous->upper == current->lower && previous->right == BorderType::CLOSED &&
+                            current->left == BorderType::CLOSED;
+        if (previous->upper > current->lower || share_border) {
+            return result;
+        }
+    }
+
+    for (auto index: order) {
+        auto &interval = intervals[index];
+        auto uniform = std::static_pointer_cast<UniformDistribution>(sub_circuits[index]);
+        result->lowers.push_back(interval->lower);
+        result->uppers.push_back(interval->upper);
+        result->left_closed.push_back(interval->left == BorderType::CLOSED);
+        result->right_closed.push_back(interval->right == BorderType::CLOSED);
+        result->log_values.push_back(log_weights()[index] + log(uniform->pdf_value()));
+    }
+    result->is_applicable = true;
+    return result;
+}
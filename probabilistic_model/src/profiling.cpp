@@ -0,0 +1,193 @@
+#include <include/profiling.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <map>
+#include <memory>
+#include <sstream>
+
+thread_local const void *NodeEvaluationTimer::current_node = nullptr;
+
+namespace {
+
+    std::string demangle(const std::type_index &type) {
+        int status = 0;
+        std::unique_ptr<char, void (*)(void *)> name(abi::__cxa_demangle(type.name(), nullptr, nullptr, &status),
+                                                     std::free);
+        return status == 0 ? std::string(name.get()) : std::string(type.name());
+    }
+
+    void sort_by_descending_time(std::vector<NodeProfile> &profiles) {
+        std::stable_sort(profiles.begin(), profiles.end(), [](const NodeProfile &left, const NodeProfile &right) {
+            return left.seconds > right.seconds;
+        });
+    }
+
+    std::string escape_json(const std::string &text) {
+        std::string result;
+        for (auto character: text) {
+            if (character == '"' || character == '\\') {
+                result += '\\';
+            }
+            result += character;
+        }
+        return result;
+    }
+
+    std::string node_address(const void *node) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%p", node);
+        return buffer;
+    }
+
+    void write_json(std::ostringstream &stream, const NodeProfile &profile) {
+        stream << "{";
+        if (profile.node != nullptr) {
+            stream << "\"node\": \"" << node_address(profile.node) << "\", ";
+        }
+        stream << "\"type\": \"" << escape_json(profile.type) << "\", \"evaluations\": " << profile.evaluations
+               << ", \"rows\": " << profile.rows << ", \"seconds\": " << profile.seconds << "}";
+    }
+
+    void write_json(std::ostringstream &stream, const std::vector<NodeProfile> &profiles) {
+        stream << "[";
+        for (size_t index = 0; index < profiles.size(); index++) {
+            stream << (index == 0 ? "" : ", ");
+            write_json(stream, profiles[index]);
+        }
+        stream << "]";
+    }
+
+    void write_text(std::ostringstream &stream, const std::vector<NodeProfile> &profiles) {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-18s %12s %14s %12s  %s\n", "node", "evaluations", "rows", "seconds",
+                      "type");
+        stream << line;
+        for (auto &profile: profiles) {
+            std::snprintf(line, sizeof(line), "%-18s %12zu %14zu %12.6f  ",
+                          profile.node != nullptr ? node_address(profile.node).c_str() : "-", profile.evaluations,
+                          profile.rows, profile.seconds);
+            stream << line << profile.type << "\n";
+        }
+    }
+
+}
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::record_node_evaluation(const void *node, std::type_index type, size_t rows, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = nodes.try_emplace(node, type, NodeProfile()).first;
+    auto &profile = entry->second.second;
+    profile.node = node;
+    profile.evaluations++;
+    profile.rows += rows;
+    profile.seconds += seconds;
+    if (node_evaluation_callback) {
+        node_evaluation_callback(NodeEvaluation{node, type, rows, seconds});
+    }
+}
+
+void Profiler::record_fit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    fitting.fits++;
+}
+
+void Profiler::record_induction_step(size_t depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fitting.induction_steps++;
+    fitting.max_depth = std::max(fitting.max_depth, depth);
+}
+
+void Profiler::record_candidate_splits(size_t number_of_candidate_splits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fitting.candidate_splits += number_of_candidate_splits;
+}
+
+void Profiler::record_fit_phase(FitPhase phase, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    switch (phase) {
+        case FitPhase::SORT:
+            fitting.sort_seconds += seconds;
+            break;
+        case FitPhase::AGGREGATION:
+            fitting.aggregation_seconds += seconds;
+            break;
+        case FitPhase::SPLIT_SEARCH:
+            fitting.split_search_seconds += seconds;
+            break;
+    }
+}
+
+void Profiler::set_node_evaluation_callback(NodeEvaluationCallback_t callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    node_evaluation_callback = std::move(callback);
+}
+
+ProfileReport Profiler::report() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ProfileReport result;
+    result.fitting = fitting;
+
+    // the type names are demangled once per type
+    std::map<std::type_index, NodeProfile> node_types;
+    for (auto &[node, typed_profile]: nodes) {
+        auto &[type, profile] = typed_profile;
+        auto type_profile = node_types.find(type);
+        if (type_profile == node_types.end()) {
+            type_profile = node_types.emplace(type, NodeProfile()).first;
+            type_profile->second.type = demangle(type);
+        }
+        type_profile->second.evaluations += profile.evaluations;
+        type_profile->second.rows += profile.rows;
+        type_profile->second.seconds += profile.seconds;
+        result.nodes.push_back(profile);
+        result.nodes.back().type = type_profile->second.type;
+    }
+    for (auto &[type, profile]: node_types) {
+        result.node_types.push_back(profile);
+    }
+    sort_by_descending_time(result.node_types);
+    sort_by_descending_time(result.nodes);
+    return result;
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    nodes.clear();
+    fitting = FitProfile();
+}
+
+std::string ProfileReport::to_json() const {
+    std::ostringstream stream;
+    stream << "{\"node_types\": ";
+    write_json(stream, node_types);
+    stream << ", \"nodes\": ";
+    write_json(stream, nodes);
+    stream << ", \"fitting\": {\"fits\": " << fitting.fits << ", \"induction_steps\": " << fitting.induction_steps
+           << ", \"candidate_splits\": " << fitting.candidate_splits << ", \"max_depth\": " << fitting.max_depth
+           << ", \"sort_seconds\": " << fitting.sort_seconds << ", \"aggregation_seconds\": "
+           << fitting.aggregation_seconds << ", \"split_search_seconds\": " << fitting.split_search_seconds << "}}";
+    return stream.str();
+}
+
+std::string ProfileReport::to_text() const {
+    std::ostringstream stream;
+    stream << "Node types\n";
+    write_text(stream, node_types);
+    stream << "\nNodes\n";
+    write_text(stream, nodes);
+    stream << "\nFitting\n"
+           << "fits                 " << fitting.fits << "\n"
+           << "induction steps      " << fitting.induction_steps << "\n"
+           << "candidate splits     " << fitting.candidate_splits << "\n"
+           << "max depth            " << fitting.max_depth << "\n"
+           << "sort seconds         " << fitting.sort_seconds << "\n"
+           << "aggregation seconds  " << fitting.aggregation_seconds << "\n"
+           << "split search seconds " << fitting.split_search_seconds << "\n";
+    return stream.str();
+}
@@ -0,0 +1,60 @@
+#include <include/single_precision_circuit.h>
+#include <cmath>
+#include <stdexcept>
+
+SinglePrecisionCircuit::SinglePrecisionCircuit(std::shared_ptr<const ProbabilisticModel> model,
+                                               const CircuitTape &circuit_tape) :
+        model(std::move(model)), circuit_tape(circuit_tape) {
+    convert();
+}
+
+SinglePrecisionCircuit::SinglePrecisionCircuit(const ProbabilisticCircuitPtr_t &circuit) {
+    auto compiled = CompiledCircuit::make_shared(circuit);
+    circuit_tape = compiled->tape();
+    model = compiled;
+    convert();
+}
+
+void SinglePrecisionCircuit::convert() {
+
+    // floats represent every integer up to 2^24 exactly
+    const double max_exact_code = 16777216.;
+
+    auto number_of_edges = circuit_tape.children_begin[circuit_tape.number_of_nodes];
+    edge_log_weights.assign(circuit_tape.edge_log_weights, circuit_tape.edge_log_weights + number_of_edges);
+
+    auto number_of_parameters = circuit_tape.parameters_begin[circuit_tape.number_of_nodes];
+    parameters.assign(circuit_tape.parameters, circuit_tape.parameters + number_of_parameters);
+
+    for (size_t node = 0; node < circuit_tape.number_of_nodes; node++) {
+        if (circuit_tape.kinds[node] != NodeKind::DISCRETE) {
+            continue;
+        }
+        auto first_parameter = circuit_tape.parameters_begin[node];
+        auto number_of_codes = circuit_tape.parameters_begin[node + 1] - first_parameter - 1;
+        auto first_code = circuit_tape.parameters[first_parameter];
+        if (std::abs(first_code) > max_exact_code || std::abs(first_code + number_of_codes) > max_exact_code) {
+            throw std::invalid_argument("Cannot represent the codes of discrete leaf " + std::to_string(node) +
+                                        " in single precision");
+        }
+    }
+}
+
+FloatCircuitTape SinglePrecisionCircuit::tape() const {
+    FloatCircuitTape result;
+    result.number_of_nodes = circuit_tape.number_of_nodes;
+    result.number_of_variables = circuit_tape.number_of_variables;
+    result.kinds = circuit_tape.kinds;
+    result.children_begin = circuit_tape.children_begin;
+    result.children = circuit_tape.children;
+    result.edge_log_weights = edge_log_weights.data();
+    result.variable_indices = circuit_tape.variable_indices;
+    result.parameters_begin = circuit_tape.parameters_begin;
+    result.parameters = parameters.data();
+    return result;
+}
+
+void SinglePrecisionCircuit::log_likelihood_batch(const float *data, size_t n_rows, float *out) const {
+    PROFILE_NODE_EVALUATION(n_rows);
+    tape().log_likelihood_batch(data, n_rows, out);
+}
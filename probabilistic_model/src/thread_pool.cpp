@@ -0,0 +1,199 @@
+#include <include/thread_pool.h>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+    /**
+     * The pool and the worker index of the calling thread, if it is a worker.
+     */
+    thread_local const ThreadPool *current_pool = nullptr;
+    thread_local size_t current_index = 0;
+
+}
+
+ThreadPool::ThreadPool(size_t number_of_threads) {
+    if (number_of_threads == 0) {
+        number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues.reserve(number_of_threads);
+    for (size_t i = 0; i < number_of_threads; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    threads.reserve(number_of_threads);
+    for (size_t i = 0; i < number_of_threads; i++) {
+        threads.emplace_back(&ThreadPool::run_worker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        all_tasks_done.wait(lock, [this] { return pending_tasks == 0; });
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::current_worker_index() const {
+    return current_pool == this ? current_index : size();
+}
+
+void ThreadPool::pin_workers(const std::vector<size_t> &cpus) {
+    if (cpus.empty()) {
+        throw std::invalid_argument("Cannot pin workers to an empty set of CPUs");
+    }
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu: cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            throw std::invalid_argument("CPU " + std::to_string(cpu) + " exceeds the size of a CPU set");
+        }
+        CPU_SET(cpu, &cpu_set);
+    }
+    for (auto &thread: threads) {
+        if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set) != 0) {
+            throw std::runtime_error("Cannot set the CPU affinity of a worker");
+        }
+    }
+#else
+    throw std::runtime_error("Pinning workers is only supported on Linux");
+#endif
+}
+
+void ThreadPool::submit(Task_t task) {
+    auto worker_index = current_worker_index();
+    if (worker_index == size()) {
+        worker_index = next_queue++ % size();
+    }
+
+    pending_tasks++;
+    queued_tasks++;
+    {
+        std::lock_guard<std::mutex> lock(queues[worker_index]->mutex);
+        queues[worker_index]->tasks.push_back(std::move(task));
+    }
+
+    // take the state lock such that a worker cannot miss the notification between checking and sleeping
+    { std::lock_guard<std::mutex> lock(state_mutex); }
+    work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    all_tasks_done.wait(lock, [this] { return pending_tasks == 0; });
+    if (first_exception) {
+        auto exception = first_exception;
+        first_exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+bool ThreadPool::try_pop(size_t worker_index, Task_t &task) {
+
+    // own queue first, newest task first
+    {
+        auto &own_queue = *queues[worker_index];
+        std::lock_guard<std::mutex> lock(own_queue.mutex);
+        if (!own_queue.tasks.empty()) {
+            task = std::move(own_queue.tasks.back());
+            own_queue.tasks.pop_back();
+            queued_tasks--;
+            return true;
+        }
+    }
+
+    // steal the oldest task of another worker
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        auto &other_queue = *queues[(worker_index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(other_queue.mutex);
+        if (!other_queue.tasks.empty()) {
+            task = std::move(other_queue.tasks.front());
+            other_queue.tasks.pop_front();
+            queued_tasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run_worker(size_t worker_index) {
+    current_pool = this;
+    current_index = worker_index;
+
+    while (true) {
+        Task_t task;
+        if (try_pop(worker_index, task)) {
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                if (!first_exception) {
+                    first_exception = std::current_exception();
+                }
+            }
+            if (--pending_tasks == 0) {
+                { std::lock_guard<std::mutex> lock(state_mutex); }
+                all_tasks_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(state_mutex);
+        work_available.wait(lock, [this] { return stopping || queued_tasks > 0; });
+        if (stopping && queued_tasks == 0) {
+            return;
+        }
+    }
+}
+
+std::vector<size_t> parse_cpu_list(const std::string &cpu_list) {
+    std::vector<size_t> result;
+    size_t position = 0;
+    while (position < cpu_list.size() && cpu_list[position] != '\n') {
+        size_t length;
+        auto first = std::stoul(cpu_list.substr(position), &length);
+        position += length;
+        auto last = first;
+        if (position < cpu_list.size() && cpu_list[position] == '-') {
+            position++;
+            last = std::stoul(cpu_list.substr(position), &length);
+            position += length;
+        }
+        if (last < first) {
+            throw std::invalid_argument("Malformed CPU list " + cpu_list);
+        }
+        for (auto cpu = first; cpu <= last; cpu++) {
+            result.push_back(cpu);
+        }
+        if (position < cpu_list.size() && cpu_list[position] == ',') {
+            position++;
+        } else if (position < cpu_list.size() && cpu_list[position] != '\n') {
+            throw std::invalid_argument("Malformed CPU list " + cpu_list);
+        }
+    }
+    return result;
+}
+
+std::vector<size_t> cpus_of_numa_node(size_t numa_node) {
+    auto path = "/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist";
+    std::ifstream file(path);
+    std::string cpu_list;
+    if (!file || !std::getline(file, cpu_list)) {
+        throw std::invalid_argument("NUMA node " + std::to_string(numa_node) + " does not exist");
+    }
+    auto result = parse_cpu_list(cpu_list);
+    if (result.empty()) {
+        throw std::invalid_argument("NUMA node " + std::to_string(numa_node) + " has no CPUs");
+    }
+    return result;
+}
@@ -0,0 +1,80 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "arena.h"
+#include "nyga_distribution.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+TEST(Arena, ObjectsKeepTheArenaAlive) {
+    auto arena = std::make_shared<Arena>();
+    auto variable_x = make_shared_continuous("x");
+    auto leaf = make_shared_in<DiracDeltaDistribution>(arena, variable_x, 1., 2.);
+    EXPECT_EQ(arena->number_of_allocations(), 1);
+
+    std::weak_ptr<Arena> weak_arena = arena;
+    arena.reset();
+    EXPECT_FALSE(weak_arena.expired());
+    EXPECT_DOUBLE_EQ(leaf->pdf(1.), 2.);
+    leaf.reset();
+    EXPECT_TRUE(weak_arena.expired());
+}
+
+TEST(Arena, WithoutArenaUsesTheHeap) {
+    auto leaf = make_shared_in<DiracDeltaDistribution>(nullptr, make_shared_continuous("x"), 1., 2.);
+    EXPECT_DOUBLE_EQ(leaf->pdf(1.), 2.);
+}
+
+class ArenaNygaDistributionTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    DataVector samples;
+
+    ArenaNygaDistributionTest() {
+        std::mt19937_64 generator(69);
+        std::normal_distribution<double> normal(0, 1);
+        samples.resize(20000);
+        std::generate(samples.begin(), samples.end(), [&]() { return normal(generator); });
+    }
+
+    static void expect_equal_distributions(const NygaDistributionPtr_t &left, const NygaDistributionPtr_t &right) {
+        ASSERT_EQ(left->sub_circuits.size(), right->sub_circuits.size());
+        EXPECT_EQ(left->weights, right->weights);
+        for (size_t index = 0; index < left->sub_circuits.size(); index++) {
+            EXPECT_EQ(left->sub_circuits[index]->representation(), right->sub_circuits[index]->representation());
+        }
+    }
+};
+
+TEST_F(ArenaNygaDistributionTest, FitInArenaMatchesFitOnHeap) {
+    auto model = NygaDistribution::make_shared(variable_x, 20, 0.01);
+    auto data = samples;
+    auto expected = model->fit(&data);
+    EXPECT_EQ(expected->arena, nullptr);
+
+    model->allocate_in_arena = true;
+    data = samples;
+    auto result = model->fit(&data);
+    ASSERT_NE(result->arena, nullptr);
+    expect_equal_distributions(result, expected);
+
+    // the distribution, every quantile and every induction step come from the arena
+    EXPECT_GE(result->arena->number_of_allocations(), 1 + 2 * result->sub_circuits.size());
+
+    // quantiles outlive the distribution they were allocated for
+    auto quantile = result->sub_circuits[0];
+    result.reset();
+    EXPECT_EQ(quantile->representation(), expected->sub_circuits[0]->representation());
+}
+
+TEST_F(ArenaNygaDistributionTest, FitInArenaInParallel) {
+    auto model = NygaDistribution::make_shared(variable_x, 20, 0.01);
+    auto data = samples;
+    auto expected = model->fit(&data);
+
+    model->allocate_in_arena = true;
+    model->number_of_threads = 4;
+    model->min_samples_per_parallel_task = 256;
+    data = samples;
+    expect_equal_distributions(model->fit(&data), expected);
+}
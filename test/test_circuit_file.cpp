@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include "gtest/gtest.h"
+#include "circuit_file.h"
+#include "compiled_circuit.h"
+#include "nyga_distribution.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class CircuitFileTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    IntegerPtr_t variable_i = make_shared_integer("i");
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+    std::string path = testing::TempDir() + "circuit_file_test.bin";
+
+    CircuitFileTest() {
+        std::mt19937_64 generator(69);
+        std::normal_distribution<double> normal(0, 1);
+        DataVector samples(500);
+        std::generate(samples.begin(), samples.end(), [&]() { return normal(generator); });
+        auto nyga_distribution = NygaDistribution::make_shared(variable_x, 10, 0.01)->fit(&samples);
+
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{0, 0.2}, {1, 0.8}}));
+        product_1->add_subcircuit(nyga_distribution);
+        product_1->add_subcircuit(std::make_shared<IntegerDistribution>(variable_i,
+                                                                        std::map<int, double>{{-1, 0.5}, {3, 0.5}}));
+
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{2, 1.}}));
+        product_2->add_subcircuit(nyga_distribution);
+        product_2->add_subcircuit(std::make_shared<IntegerDistribution>(variable_i, std::map<int, double>{{0, 1.}}));
+
+        root->add_subcircuit(0.3, product_1);
+        root->add_subcircuit(0.7, product_2);
+    }
+
+    ~CircuitFileTest() override {
+        std::remove(path.c_str());
+    }
+};
+
+TEST_F(CircuitFileTest, MappedCircuitMatchesCompiledCircuit) {
+    auto compiled = CompiledCircuit(root);
+    compiled.save(path);
+    auto mapped = MappedCircuit(path);
+
+    ASSERT_EQ(mapped.number_of_nodes(), compiled.number_of_nodes());
+    ASSERT_EQ(mapped.variables.size(), 3);
+    EXPECT_EQ(*mapped.variables[0]->name, "a");
+    EXPECT_TRUE(std::dynamic_pointer_cast<Symbolic>(mapped.variables[0]));
+    EXPECT_EQ(*std::static_pointer_cast<Set>(mapped.variables[0]->get_domain())->all_elements,
+              (std::set<std::string>{"r", "g", "b"}));
+    EXPECT_TRUE(std::dynamic_pointer_cast<Integer>(mapped.variables[1]));
+    EXPECT_TRUE(std::dynamic_pointer_cast<Continuous>(mapped.variables[2]));
+
+    size_t n_rows = ProbabilisticModel::batch_block_size + 300;
+    std::mt19937_64 generator(42);
+    std::uniform_int_distribution<int> symbol(0, 2);
+    std::uniform_int_distribution<int> integer(-1, 3);
+    std::normal_distribution<double> normal(0, 1.5);
+    std::vector<double> data(3 * n_rows);
+    for (size_t row = 0; row < n_rows; row++) {
+        data[row] = symbol(generator);
+        data[n_rows + row] = integer(generator);
+        data[2 * n_rows + row] = normal(generator);
+    }
+
+    std::vector<double> expected(n_rows);
+    std::vector<double> out(n_rows);
+    compiled.log_likelihood_batch(data.data(), n_rows, expected.data());
+    mapped.log_likelihood_batch(data.data(), n_rows, out.data());
+    EXPECT_EQ(out, expected);
+
+    auto event = std::make_shared<FullEvidence>(FullEvidence{data[0], data[n_rows], data[2 * n_rows]});
+    EXPECT_EQ(mapped.log_likelihood(event), expected[0]);
+}
+
+TEST_F(CircuitFileTest, RejectsOtherVersions) {
+    CompiledCircuit(root).save(path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t version = CircuitFileHeader::current_version + 1;
+        file.seekp(offsetof(CircuitFileHeader, version));
+        file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+    EXPECT_THROW(MappedCircuit{path}, std::runtime_error);
+}
+
+TEST_F(CircuitFileTest, RejectsCorruptedFiles) {
+    EXPECT_THROW(MappedCircuit{path}, std::runtime_error);
+
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not a circuit";
+    }
+    EXPECT_THROW(MappedCircuit{path}, std::runtime_error);
+
+    // truncate a valid file
+    CompiledCircuit(root).save(path);
+    std::vector<char> content;
+    {
+        std::ifstream file(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), (std::streamsize) content.size() - 8);
+    }
+    EXPECT_THROW(MappedCircuit{path}, std::runtime_error);
+}
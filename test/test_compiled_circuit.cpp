@@ -0,0 +1,121 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "compiled_circuit.h"
+#include "nyga_distribution.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class CompiledCircuitTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"a", "b", "c"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    ContinuousPtr_t variable_y = make_shared_continuous("y");
+
+    std::shared_ptr<SmoothSumUnit> shared_sum = std::make_shared<SmoothSumUnit>();
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+
+    CompiledCircuitTest() {
+        shared_sum->add_subcircuit(0.3, UniformDistribution::make_shared(variable_x, closed<double>(0, 1)));
+        shared_sum->add_subcircuit(0.7, UniformDistribution::make_shared(variable_x, closed_open<double>(0.5, 4)));
+
+        // two products that share the sum over x
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{0, 0.2}, {1, 0.8}}));
+        product_1->add_subcircuit(shared_sum);
+        product_1->add_subcircuit(DiracDeltaDistribution::make_shared(variable_y, 2., 5.));
+
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{1, 0.5}, {2, 0.5}}));
+        product_2->add_subcircuit(shared_sum);
+        product_2->add_subcircuit(UniformDistribution::make_shared(variable_y, closed<double>(1, 3)));
+
+        root->add_subcircuit(0.4, product_1);
+        root->add_subcircuit(0.6, product_2);
+    }
+};
+
+TEST_F(CompiledCircuitTest, SharedNodesAreCompiledOnce) {
+    auto compiled = CompiledCircuit(root);
+    // 2 leaves of the shared sum + the shared sum + 2 leaves per product + 2 products + root
+    ASSERT_EQ(compiled.number_of_nodes(), 10);
+    ASSERT_EQ(compiled.kinds.back(), NodeKind::SUM);
+    ASSERT_EQ(compiled.variables.size(), 3);
+}
+
+TEST_F(CompiledCircuitTest, LogLikelihoodMatchesCircuit) {
+    auto compiled = CompiledCircuit(root);
+    // the last block is shorter than the others and reuses the scratch buffer of the first one
+    size_t n_rows = ProbabilisticModel::batch_block_size + 600;
+    std::vector<double> data(3 * n_rows);
+    for (size_t row = 0; row < n_rows; row++) {
+        data[row] = (double) (row % 3);
+        data[n_rows + row] = (double) (row % 50) / 10.;
+        data[2 * n_rows + row] = row % 4 == 0 ? 1.5 : 2.;
+    }
+
+    std::vector<double> result(n_rows);
+    compiled.log_likelihood_batch(data.data(), n_rows, result.data());
+    for (size_t row = 0; row < n_rows; row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row], data[n_rows + row],
+                                                                 data[2 * n_rows + row]});
+        auto expected = root->log_likelihood(event);
+        if (std::isinf(expected)) {
+            EXPECT_EQ(result[row], expected);
+        } else {
+            EXPECT_NEAR(result[row], expected, 1e-12);
+        }
+        EXPECT_EQ(compiled.log_likelihood(event), result[row]);
+    }
+}
+
+TEST(CompiledCircuit, NygaDistribution) {
+    auto variable = make_shared_continuous("x");
+    auto normal = std::normal_distribution<double>(0, 1);
+    std::default_random_engine generator(69);
+    auto data = new DataVector(1000);
+    std::generate(data->begin(), data->end(), [&](){return normal(generator);});
+
+    auto nyga = NygaDistribution::make_shared(variable, 20, 0.01)->fit(data);
+    auto compiled = CompiledCircuit(nyga);
+    ASSERT_EQ(compiled.number_of_nodes(), nyga->sub_circuits.size() + 1);
+
+    for (auto value: {-1.5, -0.1, 0., 0.3, 2.}) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{value});
+        auto expected = nyga->log_likelihood(event);
+        if (std::isinf(expected)) {
+            EXPECT_EQ(compiled.log_likelihood(event), expected);
+        } else {
+            EXPECT_NEAR(compiled.log_likelihood(event), expected, 1e-9);
+        }
+    }
+    delete data;
+}
+
+TEST(CompiledCircuit, InfiniteDensity) {
+    auto variable_x = make_shared_continuous("x");
+    auto model = std::make_shared<SmoothSumUnit>();
+    model->add_subcircuit(0.5, std::make_shared<DiracDeltaDistribution>(variable_x, 1.));
+    model->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+    auto compiled = CompiledCircuit::make_shared(model);
+
+    std::vector<double> data{1., 1.5, 3.};
+    std::vector<double> result(data.size());
+    std::vector<double> expected(data.size());
+    compiled->log_likelihood_batch(data.data(), data.size(), result.data());
+    model->log_likelihood_batch(data.data(), data.size(), expected.data());
+    ASSERT_EQ(result, expected);
+    ASSERT_EQ(result[0], std::numeric_limits<double>::infinity());
+}
+
+TEST(CompiledCircuit, SparseDiscreteDistribution) {
+    auto variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                           make_shared_all_elements(std::set<std::string>{"a", "b"}));
+    auto sparse = std::make_shared<SymbolicDistribution>(
+            variable_a, std::map<int, double>{{0, 0.5}, {std::numeric_limits<int>::max(), 0.5}});
+    ASSERT_FALSE(sparse->is_dense());
+    ASSERT_THROW(CompiledCircuit::make_shared(sparse), std::invalid_argument);
+}
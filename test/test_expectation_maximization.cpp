@@ -0,0 +1,149 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "nyga_distribution.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class ExpectationMaximizationTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    std::shared_ptr<SmoothSumUnit> root;
+    std::shared_ptr<SymbolicDistribution> symbolic_1;
+    std::shared_ptr<SymbolicDistribution> symbolic_2;
+
+    ExpectationMaximizationTest() {
+        root = mixture(symbolic_1, symbolic_2);
+    }
+
+    /**
+     * A mixture of two products over a and x. The supports of x overlap in [2, 3].
+     */
+    std::shared_ptr<SmoothSumUnit> mixture(std::shared_ptr<SymbolicDistribution> &mixture_symbolic_1,
+                                           std::shared_ptr<SymbolicDistribution> &mixture_symbolic_2) {
+        mixture_symbolic_1 = std::make_shared<SymbolicDistribution>(
+                variable_a, std::map<int, double>{{0, 0.4}, {1, 0.3}, {2, 0.3}});
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(mixture_symbolic_1);
+        product_1->add_subcircuit(UniformDistribution::make_shared(variable_x, closed<double>(0, 3)));
+
+        mixture_symbolic_2 = std::make_shared<SymbolicDistribution>(
+                variable_a, std::map<int, double>{{0, 0.2}, {1, 0.2}, {2, 0.6}});
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(mixture_symbolic_2);
+        product_2->add_subcircuit(UniformDistribution::make_shared(variable_x, closed<double>(2, 4)));
+
+        auto result = std::make_shared<SmoothSumUnit>();
+        result->add_subcircuit(0.5, product_1);
+        result->add_subcircuit(0.5, product_2);
+        return result;
+    }
+
+    /**
+     * Column-major rows over a and x, a depends on the side of x.
+     */
+    std::vector<double> rows(size_t n_rows) {
+        std::mt19937_64 generator(69);
+        std::uniform_real_distribution<double> value(0, 4);
+        std::discrete_distribution<int> left_code{0.7, 0.2, 0.1};
+        std::discrete_distribution<int> right_code{0.1, 0.1, 0.8};
+        std::vector<double> data(2 * n_rows);
+        for (size_t row = 0; row < n_rows; row++) {
+            data[n_rows + row] = value(generator);
+            data[row] = data[n_rows + row] < 2 ? left_code(generator) : right_code(generator);
+        }
+        return data;
+    }
+};
+
+TEST_F(ExpectationMaximizationTest, SeparatedComponents) {
+
+    // the rows with x < 2 belong to the first component and rows with x > 3 to the second one
+    std::vector<double> data{0, 0, 1, 2, 2, 2,
+                             0.5, 1, 1.5, 3.5, 3.5, 4};
+    auto log_likelihoods = root->expectation_maximization(data.data(), 6, 1);
+    ASSERT_EQ(log_likelihoods.size(), 1);
+    ASSERT_NEAR(log_likelihoods[0], 3 * log(0.5 / 3) + 2 * log(0.4) + log(0.3) + 3 * log(0.5 / 2) + 3 * log(0.6),
+                1e-12);
+    ASSERT_NEAR(root->weights[0], 0.5, 1e-12);
+    ASSERT_NEAR(root->log_weights()[1], log(0.5), 1e-12);
+    ASSERT_NEAR(symbolic_1->pmf(0), 2. / 3, 1e-12);
+    ASSERT_NEAR(symbolic_1->pmf(1), 1. / 3, 1e-12);
+    ASSERT_EQ(symbolic_1->pmf(2), 0);
+    ASSERT_NEAR(symbolic_2->pmf(2), 1, 1e-12);
+    ASSERT_EQ(symbolic_2->probabilities.size(), 3);
+}
+
+TEST_F(ExpectationMaximizationTest, LogLikelihoodIncreases) {
+    size_t n_rows = 3 * ProbabilisticModel::batch_block_size + 11;
+    auto data = rows(n_rows);
+
+    // an impossible row is ignored
+    data[n_rows + 7] = 5;
+
+    auto log_likelihoods = root->expectation_maximization(data.data(), n_rows, 10);
+    ASSERT_EQ(log_likelihoods.size(), 10);
+    ASSERT_TRUE(std::isfinite(log_likelihoods[0]));
+    for (size_t iteration = 1; iteration < log_likelihoods.size(); iteration++) {
+        ASSERT_GE(log_likelihoods[iteration], log_likelihoods[iteration - 1] - 1e-9);
+    }
+    ASSERT_GT(log_likelihoods.back(), log_likelihoods.front());
+    ASSERT_NEAR(root->weights[0] + root->weights[1], 1, 1e-12);
+    ASSERT_GT(symbolic_1->pmf(0), 0.5);
+    ASSERT_GT(symbolic_2->pmf(2), 0.5);
+}
+
+TEST_F(ExpectationMaximizationTest, ThreadsAgree) {
+    size_t n_rows = 5 * ProbabilisticModel::batch_block_size + 3;
+    auto data = rows(n_rows);
+
+    std::shared_ptr<SymbolicDistribution> parallel_symbolic_1;
+    std::shared_ptr<SymbolicDistribution> parallel_symbolic_2;
+    auto parallel_root = mixture(parallel_symbolic_1, parallel_symbolic_2);
+    auto log_likelihoods = root->expectation_maximization(data.data(), n_rows, 3, 1);
+    auto parallel_log_likelihoods = parallel_root->expectation_maximization(data.data(), n_rows, 3, 4);
+    for (size_t iteration = 0; iteration < 3; iteration++) {
+        ASSERT_NEAR(log_likelihoods[iteration], parallel_log_likelihoods[iteration], 1e-9);
+    }
+    ASSERT_NEAR(root->weights[0], parallel_root->weights[0], 1e-12);
+    for (int code = 0; code < 3; code++) {
+        ASSERT_NEAR(symbolic_1->pmf(code), parallel_symbolic_1->pmf(code), 1e-12);
+        ASSERT_NEAR(symbolic_2->pmf(code), parallel_symbolic_2->pmf(code), 1e-12);
+    }
+}
+
+TEST_F(ExpectationMaximizationTest, RefitNygaDistribution) {
+    auto data = new DataVector{0, 1, 2, 3, 10, 11, 12, 13};
+    auto nyga = NygaDistribution::make_shared(variable_x, 1, 0.1)->fit(data);
+    delete data;
+    ASSERT_GT(nyga->sub_circuits.size(), 1);
+
+    // all new values fall into the first quantile
+    auto first_quantile = std::static_pointer_cast<UniformDistribution>(nyga->sub_circuits[0]);
+    auto interval = std::static_pointer_cast<SimpleInterval<double>>(*first_quantile->support->simple_sets->begin());
+    std::vector<double> drifted(4, (interval->lower + interval->upper) / 2);
+    nyga->expectation_maximization(drifted.data(), drifted.size(), 1);
+    ASSERT_EQ(nyga->weights[0], 1);
+    ASSERT_EQ(nyga->weights[1], 0);
+    auto event = std::make_shared<FullEvidence>(FullEvidence{drifted[0]});
+    ASSERT_NEAR(nyga->log_likelihood(event), log(first_quantile->pdf_value()), 1e-12);
+}
+
+TEST_F(ExpectationMaximizationTest, DiracDeltaKeepsItsPointMass) {
+    // a Nyga distribution fitted on a constant column is a Dirac delta with an infinite density
+    auto constant = new DataVector{1, 1, 1};
+    auto dirac_delta = NygaDistribution::make_shared(variable_x, 1, 0.1)->fit(constant);
+    delete constant;
+
+    auto mixture = std::make_shared<SmoothSumUnit>();
+    mixture->add_subcircuit(0.5, dirac_delta);
+    mixture->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+
+    std::vector<double> data{1, 1.5, 0.5};
+    auto log_likelihoods = mixture->expectation_maximization(data.data(), data.size(), 1);
+    ASSERT_EQ(log_likelihoods[0], std::numeric_limits<double>::infinity());
+    ASSERT_NEAR(mixture->weights[0], 1. / 3, 1e-12);
+    ASSERT_NEAR(mixture->weights[1], 2. / 3, 1e-12);
+}
@@ -0,0 +1,98 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "frequency_table.h"
+#include <numeric>
+
+
+TEST(FrequencyTable, FromSamples) {
+    std::vector<double> samples{3, 1, 2, 3, 1, 3};
+    auto table = FrequencyTable::from_samples(samples);
+    EXPECT_EQ(table.values, (std::vector<double>{1, 2, 3}));
+    EXPECT_EQ(table.weights, (std::vector<double>{2, 1, 3}));
+}
+
+TEST(FrequencyTable, Merge) {
+    FrequencyTable left;
+    left.append(1, 2);
+    left.append(4, 1);
+    FrequencyTable right;
+    right.append(0, 1);
+    right.append(4, 3);
+    right.append(5, 1);
+    auto merged = FrequencyTable::merge(left, right);
+    EXPECT_EQ(merged.values, (std::vector<double>{0, 1, 4, 5}));
+    EXPECT_EQ(merged.weights, (std::vector<double>{1, 2, 4, 1}));
+}
+
+TEST(ExternalFrequencyAggregator, SpillsAndMerges) {
+    std::default_random_engine generator(7);
+    auto uniform = std::uniform_int_distribution<int>(0, 999);
+
+    std::vector<double> all_samples;
+    // a budget of 100 entries forces a spill after almost every chunk
+    ExternalFrequencyAggregator aggregator(100 * 2 * sizeof(double));
+    for (int chunk_index = 0; chunk_index < 20; chunk_index++) {
+        std::vector<double> chunk(500);
+        std::generate(chunk.begin(), chunk.end(), [&]() { return (double) uniform(generator); });
+        all_samples.insert(all_samples.end(), chunk.begin(), chunk.end());
+        aggregator.add_chunk(chunk);
+    }
+    EXPECT_GT(aggregator.number_of_runs(), 1);
+
+    auto table = aggregator.finish();
+    auto expected = FrequencyTable::from_samples(all_samples);
+    EXPECT_EQ(table.values, expected.values);
+    EXPECT_EQ(table.weights, expected.weights);
+    EXPECT_EQ(aggregator.number_of_runs(), 0);
+}
+
+TEST(ExternalFrequencyAggregator, ManySmallChunks) {
+    std::default_random_engine generator(7);
+    auto uniform = std::uniform_int_distribution<int>(0, 99999);
+
+    std::vector<double> all_samples;
+    ExternalFrequencyAggregator aggregator(1 << 30);
+    for (int chunk_index = 0; chunk_index < 1000; chunk_index++) {
+        std::vector<double> chunk(chunk_index % 13);
+        std::generate(chunk.begin(), chunk.end(), [&]() { return (double) uniform(generator); });
+        all_samples.insert(all_samples.end(), chunk.begin(), chunk.end());
+        aggregator.add_chunk(chunk);
+    }
+    EXPECT_EQ(aggregator.number_of_runs(), 0);
+
+    auto table = aggregator.finish();
+    auto expected = FrequencyTable::from_samples(all_samples);
+    EXPECT_EQ(table.values, expected.values);
+    EXPECT_EQ(table.weights, expected.weights);
+}
+
+TEST(FrequencyTable, RadixSort) {
+    std::default_random_engine generator(3);
+    auto normal = std::normal_distribution<double>(0, 1e3);
+    std::vector<double> values(100000);
+    std::generate(values.begin(), values.end(), [&]() { return normal(generator); });
+    values[0] = -0.;
+    values[1] = 0.;
+    values[2] = std::numeric_limits<double>::infinity();
+    values[3] = -std::numeric_limits<double>::infinity();
+    values[4] = 1e-310;
+
+    auto expected = values;
+    std::sort(expected.begin(), expected.end());
+    radix_sort(values);
+    EXPECT_EQ(values, expected);
+}
+
+TEST(FrequencyTable, FromSamplesWithRadixSort) {
+    std::default_random_engine generator(5);
+    auto uniform = std::uniform_int_distribution<int>(-500, 500);
+    std::vector<double> samples(FrequencyTable::radix_sort_threshold + 10);
+    std::generate(samples.begin(), samples.end(), [&]() { return (double) uniform(generator) / 4.; });
+
+    auto copy = samples;
+    std::sort(copy.begin(), copy.end());
+    auto table = FrequencyTable::from_samples(samples);
+    EXPECT_EQ(samples, copy);
+    EXPECT_EQ(table.size(), 1001);
+    EXPECT_EQ(std::accumulate(table.weights.begin(), table.weights.end(), 0.), (double) samples.size());
+}
@@ -0,0 +1,115 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "joint_probability_tree.h"
+#include "variable.h"
+
+
+class JointProbabilityTreeTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    IntegerPtr_t variable_n = make_shared_integer("n");
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    AbstractVariableSetPtr_t variables = make_shared_variable_set();
+
+    JointProbabilityTreeTest() {
+        variables->insert(variable_a);
+        variables->insert(variable_n);
+        variables->insert(variable_x);
+    }
+
+    /**
+     * Two clusters, one with symbol 0, small integers and x in [0, 1], one with symbol 1, large integers and x in
+     * [10, 11]. The columns are ordered a, n, x.
+     */
+    std::vector<double> clustered_data(size_t n_rows) const {
+        std::mt19937_64 generator(69);
+        std::uniform_real_distribution<double> unit(0, 1);
+        std::uniform_int_distribution<int> small(0, 3);
+        std::vector<double> data(3 * n_rows);
+        for (size_t row = 0; row < n_rows; row++) {
+            bool second_cluster = row % 2 == 1;
+            data[row] = second_cluster;
+            data[n_rows + row] = small(generator) + (second_cluster ? 10 : 0);
+            data[2 * n_rows + row] = unit(generator) + (second_cluster ? 10 : 0);
+        }
+        return data;
+    }
+};
+
+TEST_F(JointProbabilityTreeTest, FitSeparatesClusters) {
+    auto data = clustered_data(2000);
+    auto tree = JointProbabilityTree::make_shared(variables, 100, 0.1);
+    auto result = tree->fit(data.data(), 2000);
+
+    ASSERT_EQ(result->sub_circuits.size(), 2);
+    ASSERT_EQ(result->weights, (std::vector<double>{0.5, 0.5}));
+    ASSERT_EQ(*result->get_variables(), *variables);
+    for (auto &leaf: result->sub_circuits) {
+        ASSERT_EQ(leaf->sub_circuits.size(), 3);
+        ASSERT_NE(std::dynamic_pointer_cast<SymbolicDistribution>(leaf->sub_circuits[0]), nullptr);
+        ASSERT_NE(std::dynamic_pointer_cast<IntegerDistribution>(leaf->sub_circuits[1]), nullptr);
+        ASSERT_NE(std::dynamic_pointer_cast<NygaDistribution>(leaf->sub_circuits[2]), nullptr);
+    }
+
+    auto in_first_cluster = std::make_shared<FullEvidence>(FullEvidence{0, 2, 0.5});
+    auto in_second_cluster = std::make_shared<FullEvidence>(FullEvidence{1, 12, 10.5});
+    auto mixed = std::make_shared<FullEvidence>(FullEvidence{1, 2, 0.5});
+    ASSERT_GT(result->likelihood(in_first_cluster), 0);
+    ASSERT_GT(result->likelihood(in_second_cluster), 0);
+    ASSERT_EQ(result->likelihood(mixed), 0);
+}
+
+TEST_F(JointProbabilityTreeTest, FitWithMaxDepthZero) {
+    auto data = clustered_data(100);
+    auto tree = JointProbabilityTree::make_shared(variables);
+    tree->max_depth = 0;
+    auto result = tree->fit(data.data(), 100);
+
+    ASSERT_EQ(result->sub_circuits.size(), 1);
+    ASSERT_EQ(result->weights, std::vector<double>{1.});
+    auto symbolic = std::static_pointer_cast<SymbolicDistribution>(result->sub_circuits[0]->sub_circuits[0]);
+    ASSERT_EQ(symbolic->probabilities, (std::map<int, double>{{0, 0.5}, {1, 0.5}}));
+}
+
+TEST_F(JointProbabilityTreeTest, FitInParallel) {
+    size_t n_rows = 20000;
+    std::mt19937_64 generator(69);
+    std::normal_distribution<double> normal(0, 1);
+    std::uniform_int_distribution<int> symbol(0, 2);
+    std::vector<double> data(3 * n_rows);
+    for (size_t row = 0; row < n_rows; row++) {
+        data[row] = symbol(generator);
+        data[2 * n_rows + row] = normal(generator) + 3 * data[row];
+        data[n_rows + row] = std::round(data[2 * n_rows + row] * 2);
+    }
+
+    auto tree = JointProbabilityTree::make_shared(variables, 200, 0.01);
+    tree->min_samples_per_quantile = 50;
+    auto sequential_result = tree->fit(data.data(), n_rows);
+
+    tree->number_of_threads = 4;
+    tree->min_samples_per_parallel_task = 1000;
+    auto parallel_result = tree->fit(data.data(), n_rows);
+
+    ASSERT_GT(sequential_result->sub_circuits.size(), 2);
+    ASSERT_EQ(parallel_result->weights, sequential_result->weights);
+    std::vector<double> sequential_log_likelihoods(n_rows);
+    std::vector<double> parallel_log_likelihoods(n_rows);
+    sequential_result->log_likelihood_batch(data.data(), n_rows, sequential_log_likelihoods.data());
+    parallel_result->log_likelihood_batch(data.data(), n_rows, parallel_log_likelihoods.data());
+    ASSERT_EQ(parallel_log_likelihoods, sequential_log_likelihoods);
+    for (auto log_likelihood: sequential_log_likelihoods) {
+        ASSERT_GT(log_likelihood, -std::numeric_limits<double>::infinity());
+    }
+}
+
+TEST_F(JointProbabilityTreeTest, FitInvalidData) {
+    auto tree = JointProbabilityTree::make_shared(variables);
+    std::vector<double> data{3, 1, 0.5};
+    ASSERT_THROW(tree->fit(data.data(), 1), std::invalid_argument);
+    data[0] = 1;
+    data[2] = std::nan("");
+    ASSERT_THROW(tree->fit(data.data(), 1), std::invalid_argument);
+    ASSERT_THROW(tree->fit(data.data(), 0), std::invalid_argument);
+}
@@ -0,0 +1,176 @@
+#include <numeric>
+#include <random>
+#include "gtest/gtest.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+/**
+ * A normal distribution, the simplest leaf with a smooth density.
+ */
+class GaussianDistribution : public ContinuousDistribution {
+public:
+    double mean;
+    double standard_deviation;
+
+    GaussianDistribution(const ContinuousPtr_t &variable, double mean, double standard_deviation) :
+            mean(mean), standard_deviation(standard_deviation) {
+        this->variable = variable;
+    }
+
+    double log_pdf(double value) const override {
+        auto standardized = (value - mean) / standard_deviation;
+        return -0.5 * standardized * standardized - log(standard_deviation * sqrt(2 * M_PI));
+    }
+
+    double log_pdf_derivative(double value) const override {
+        return -(value - mean) / (standard_deviation * standard_deviation);
+    }
+
+    std::string distribution_representation() const override {
+        return "N(" + std::to_string(mean) + ", " + std::to_string(standard_deviation) + ")";
+    }
+};
+
+
+class LogLikelihoodGradientTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    ContinuousPtr_t variable_y = make_shared_continuous("y");
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+    std::shared_ptr<SmoothSumUnit> inner_sum = std::make_shared<SmoothSumUnit>();
+    size_t n_rows = ProbabilisticModel::batch_block_size + 13;
+
+    /**
+     * The columns a, x and y.
+     */
+    std::vector<double> data;
+
+    /**
+     * A mixture of two products that share the leaf of y. The second product mixes two leaves of x.
+     */
+    LogLikelihoodGradientTest() {
+        auto shared_y = std::make_shared<GaussianDistribution>(variable_y, 0.5, 1.5);
+
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(std::make_shared<SymbolicDistribution>(
+                variable_a, std::map<int, double>{{0, 0.5}, {1, 0.3}, {2, 0.2}}));
+        product_1->add_subcircuit(std::make_shared<GaussianDistribution>(variable_x, 0, 1));
+        product_1->add_subcircuit(shared_y);
+
+        inner_sum->add_subcircuit(0.3, std::make_shared<GaussianDistribution>(variable_x, 2, 1));
+        inner_sum->add_subcircuit(0.7, std::make_shared<GaussianDistribution>(variable_x, -1, 0.5));
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(std::make_shared<SymbolicDistribution>(
+                variable_a, std::map<int, double>{{0, 0.1}, {1, 0.6}, {2, 0.3}}));
+        product_2->add_subcircuit(inner_sum);
+        product_2->add_subcircuit(shared_y);
+
+        root->add_subcircuit(0.4, product_1);
+        root->add_subcircuit(0.6, product_2);
+
+        std::mt19937_64 generator(69);
+        std::uniform_int_distribution<int> codes(0, 2);
+        std::normal_distribution<double> normal(0, 1.5);
+        data.resize(3 * n_rows);
+        for (size_t row = 0; row < n_rows; row++) {
+            data[row] = codes(generator);
+            data[n_rows + row] = normal(generator);
+            data[2 * n_rows + row] = normal(generator);
+        }
+    }
+
+    double total_log_likelihood() const {
+        std::vector<double> log_likelihoods(n_rows);
+        root->log_likelihood_batch(data.data(), n_rows, log_likelihoods.data());
+        return std::accumulate(log_likelihoods.begin(), log_likelihoods.end(), 0.);
+    }
+};
+
+TEST_F(LogLikelihoodGradientTest, WeightsMatchFiniteDifferences) {
+    ASSERT_EQ(root->number_of_sum_weights(), 4);
+    std::vector<double> log_likelihoods(n_rows);
+    std::vector<double> weight_gradients(4, 42.);
+    root->log_likelihood_gradient(data.data(), n_rows, log_likelihoods.data(), weight_gradients.data());
+
+    std::vector<double> expected_log_likelihoods(n_rows);
+    root->log_likelihood_batch(data.data(), n_rows, expected_log_likelihoods.data());
+    for (size_t row = 0; row < n_rows; row++) {
+        ASSERT_DOUBLE_EQ(log_likelihoods[row], expected_log_likelihoods[row]);
+    }
+
+    // the inner sum comes before the root in post order
+    std::vector<SmoothSumUnit *> sums{inner_sum.get(), inner_sum.get(), root.get(), root.get()};
+    std::vector<size_t> indices{0, 1, 0, 1};
+    double epsilon = 1e-6;
+    for (size_t parameter = 0; parameter < 4; parameter++) {
+        auto weight = sums[parameter]->weights[indices[parameter]];
+        sums[parameter]->set_weight(indices[parameter], weight + epsilon);
+        auto upper = total_log_likelihood();
+        sums[parameter]->set_weight(indices[parameter], weight - epsilon);
+        auto lower = total_log_likelihood();
+        sums[parameter]->set_weight(indices[parameter], weight);
+        ASSERT_NEAR(weight_gradients[parameter], (upper - lower) / (2 * epsilon),
+                    1e-5 * std::abs(weight_gradients[parameter]));
+    }
+}
+
+TEST_F(LogLikelihoodGradientTest, InputsMatchFiniteDifferences) {
+    std::vector<double> input_gradients(data.size(), 42.);
+    root->log_likelihood_gradient(data.data(), n_rows, nullptr, nullptr, input_gradients.data());
+
+    double epsilon = 1e-6;
+    for (size_t row: {(size_t) 0, (size_t) 7, n_rows - 1}) {
+        ASSERT_EQ(input_gradients[row], 0);
+        for (size_t column = 1; column < 3; column++) {
+            std::vector<double> evidence{data[row], data[n_rows + row], data[2 * n_rows + row]};
+            double upper, lower;
+            evidence[column] += epsilon;
+            root->log_likelihood_batch(evidence.data(), 1, &upper);
+            evidence[column] -= 2 * epsilon;
+            root->log_likelihood_batch(evidence.data(), 1, &lower);
+            ASSERT_NEAR(input_gradients[column * n_rows + row], (upper - lower) / (2 * epsilon), 1e-6);
+        }
+    }
+}
+
+TEST_F(LogLikelihoodGradientTest, PiecewiseConstantLeavesAndImpossibleRows) {
+    auto mixture = std::make_shared<SmoothSumUnit>();
+    mixture->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+    mixture->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(1, 5)));
+
+    // the last row is impossible
+    std::vector<double> values{0.5, 1.5, 3, 7};
+    std::vector<double> log_likelihoods(4);
+    std::vector<double> weight_gradients(2);
+    std::vector<double> input_gradients(4, 42.);
+    mixture->log_likelihood_gradient(values.data(), 4, log_likelihoods.data(), weight_gradients.data(),
+                                     input_gradients.data());
+
+    ASSERT_EQ(log_likelihoods[3], -std::numeric_limits<double>::infinity());
+    ASSERT_EQ(input_gradients, std::vector<double>(4, 0.));
+    // d/dw_1 log(w_1 p_1 + w_2 p_2) = p_1 / (w_1 p_1 + w_2 p_2)
+    ASSERT_DOUBLE_EQ(weight_gradients[0], 0.5 / 0.25 + 0.5 / 0.375);
+    ASSERT_DOUBLE_EQ(weight_gradients[1], 0.25 / 0.375 + 0.25 / 0.125);
+}
+
+TEST_F(LogLikelihoodGradientTest, InfiniteDensity) {
+    auto mixture = std::make_shared<SmoothSumUnit>();
+    mixture->add_subcircuit(0.5, std::make_shared<DiracDeltaDistribution>(variable_x, 1.));
+    mixture->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+
+    std::vector<double> values{1, 1.5, 0.5};
+    std::vector<double> log_likelihoods(3);
+    std::vector<double> expected_log_likelihoods(3);
+    std::vector<double> weight_gradients(2);
+    mixture->log_likelihood_gradient(values.data(), 3, log_likelihoods.data(), weight_gradients.data());
+    mixture->log_likelihood_batch(values.data(), 3, expected_log_likelihoods.data());
+
+    ASSERT_EQ(log_likelihoods, expected_log_likelihoods);
+    ASSERT_EQ(log_likelihoods[0], std::numeric_limits<double>::infinity());
+    // the point mass takes all of the first row in the limit, the uniform distribution the others
+    ASSERT_DOUBLE_EQ(weight_gradients[0], 1 / 0.5);
+    ASSERT_DOUBLE_EQ(weight_gradients[1], 2 * 0.5 / 0.25);
+}
@@ -0,0 +1,58 @@
+#include "gtest/gtest.h"
+#include "log_sum_exp.h"
+#include <vector>
+
+
+TEST(VectorizableExp, MatchesStandardExp) {
+    for (double x = -708.; x < 709.; x += 0.137) {
+        EXPECT_NEAR(vectorizable_exp(x) / exp(x), 1., 1e-15) << x;
+    }
+    EXPECT_EQ(vectorizable_exp(0.), 1.);
+}
+
+TEST(VectorizableExp, Underflow) {
+    EXPECT_EQ(vectorizable_exp(-800.), 0.);
+    EXPECT_EQ(vectorizable_exp(-std::numeric_limits<double>::infinity()), 0.);
+}
+
+TEST(VectorizableExp, SinglePrecision) {
+    for (float x = -87.f; x < 88.f; x += 0.137f) {
+        EXPECT_NEAR(vectorizable_exp(x) / std::exp(x), 1.f, 3e-7f) << x;
+    }
+    EXPECT_EQ(vectorizable_exp(0.f), 1.f);
+    EXPECT_EQ(vectorizable_exp(-100.f), 0.f);
+    EXPECT_EQ(vectorizable_exp(-std::numeric_limits<float>::infinity()), 0.f);
+}
+
+TEST(LogSumExp, ShiftsByMaximum) {
+    std::vector<double> values{-1000., -1000. + log(3.)};
+    EXPECT_NEAR(log_sum_exp(values.data(), values.size()), -1000. + log(4.), 1e-12);
+
+    std::vector<double> impossible{-std::numeric_limits<double>::infinity(),
+                                   -std::numeric_limits<double>::infinity()};
+    EXPECT_EQ(log_sum_exp(impossible.data(), impossible.size()), -std::numeric_limits<double>::infinity());
+}
+
+TEST(LogSumExp, Weighted) {
+    // two children, three rows, child-major
+    std::vector<double> values{log(0.5), -std::numeric_limits<double>::infinity(), -900.,
+                               log(0.2), -std::numeric_limits<double>::infinity(), -901.};
+    std::vector<double> log_weights{log(0.3), log(0.7)};
+    std::vector<double> out(3);
+    std::vector<double> accumulator(3);
+    weighted_log_sum_exp(values.data(), log_weights.data(), 2, 3, out.data(), accumulator.data());
+    EXPECT_NEAR(out[0], log(0.3 * 0.5 + 0.7 * 0.2), 1e-14);
+    EXPECT_EQ(out[1], -std::numeric_limits<double>::infinity());
+    EXPECT_NEAR(out[2], -900. + log(0.3 + 0.7 * exp(-1.)), 1e-12);
+}
+
+TEST(LogSumExp, WeightedInfiniteMaximum) {
+    // a point mass with an infinite density next to a finite density
+    std::vector<double> values{std::numeric_limits<double>::infinity(), log(0.5), log(0.5), log(0.5)};
+    std::vector<double> log_weights{log(0.5), log(0.5)};
+    std::vector<double> out(2);
+    std::vector<double> accumulator(2);
+    weighted_log_sum_exp(values.data(), log_weights.data(), 2, 2, out.data(), accumulator.data());
+    EXPECT_EQ(out[0], std::numeric_limits<double>::infinity());
+    EXPECT_NEAR(out[1], log(0.5), 1e-14);
+}
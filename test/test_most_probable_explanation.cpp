@@ -0,0 +1,104 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "nyga_distribution.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class MostProbableExplanationTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+    double nan = std::numeric_limits<double>::quiet_NaN();
+
+    MostProbableExplanationTest() {
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{0, 0.9}, {1, 0.1}}));
+        product_1->add_subcircuit(UniformDistribution::make_shared(variable_x, closed<double>(0, 1)));
+
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                         std::map<int, double>{{1, 0.6}, {2, 0.4}}));
+        product_2->add_subcircuit(UniformDistribution::make_shared(variable_x, closed<double>(2, 6)));
+
+        root->add_subcircuit(0.3, product_1);
+        root->add_subcircuit(0.7, product_2);
+    }
+};
+
+TEST_F(MostProbableExplanationTest, PartialEvidence) {
+    // the columns are a and x
+    std::vector<double> data{nan, nan, 2, 1,
+                             nan, 3, nan, 0.5};
+    std::vector<double> assignments(data.size());
+    std::vector<double> max_log_likelihoods(4);
+    root->most_probable_explanation(data.data(), 4, assignments.data(), max_log_likelihoods.data());
+
+    ASSERT_EQ(assignments, (std::vector<double>{0, 1, 2, 1,
+                                                0.5, 3, 4, 0.5}));
+    ASSERT_DOUBLE_EQ(max_log_likelihoods[0], log(0.3 * 0.9));
+    ASSERT_DOUBLE_EQ(max_log_likelihoods[1], log(0.7 * 0.6 * 0.25));
+    ASSERT_DOUBLE_EQ(max_log_likelihoods[2], log(0.7 * 0.4 * 0.25));
+    ASSERT_DOUBLE_EQ(max_log_likelihoods[3], log(0.3 * 0.1));
+}
+
+TEST_F(MostProbableExplanationTest, MultipleBlocks) {
+    size_t n_rows = 3 * ProbabilisticModel::batch_block_size + 7;
+    std::vector<double> data(2 * n_rows, nan);
+    for (size_t row = 0; row < n_rows; row += 2) {
+        data[n_rows + row] = 3;
+    }
+    std::vector<double> assignments(data.size());
+    root->most_probable_explanation(data.data(), n_rows, assignments.data());
+
+    for (size_t row = 0; row < n_rows; row++) {
+        ASSERT_EQ(assignments[row], row % 2 == 0 ? 1 : 0);
+        ASSERT_EQ(assignments[n_rows + row], row % 2 == 0 ? 3 : 0.5);
+    }
+}
+
+TEST_F(MostProbableExplanationTest, AssignmentsReachTheirMaximum) {
+    auto data = new DataVector(1000);
+    std::mt19937_64 generator(69);
+    std::normal_distribution<double> normal(0, 1);
+    std::generate(data->begin(), data->end(), [&]() { return normal(generator); });
+    auto nyga = NygaDistribution::make_shared(variable_x, 20, 0.01)->fit(data);
+    delete data;
+
+    auto product = std::make_shared<DecomposableProductUnit>();
+    product->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                   std::map<int, double>{{0, 0.2}, {2, 0.8}}));
+    product->add_subcircuit(nyga);
+
+    std::vector<double> evidence{nan, 0, nan, 0.3};
+    std::vector<double> assignments(evidence.size());
+    std::vector<double> max_log_likelihoods(2);
+    product->most_probable_explanation(evidence.data(), 2, assignments.data(), max_log_likelihoods.data());
+
+    ASSERT_EQ(assignments[0], 2);
+    ASSERT_EQ(assignments[1], 0);
+    ASSERT_EQ(assignments[3], 0.3);
+    for (size_t row = 0; row < 2; row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{assignments[row], assignments[2 + row]});
+        ASSERT_NEAR(product->log_likelihood(event), max_log_likelihoods[row], 1e-12);
+    }
+
+    // the densest quantile of the Nyga Distribution
+    double max_log_density = -std::numeric_limits<double>::infinity();
+    for (size_t index = 0; index < nyga->sub_circuits.size(); index++) {
+        auto uniform = std::static_pointer_cast<UniformDistribution>(nyga->sub_circuits[index]);
+        max_log_density = std::max(max_log_density, nyga->log_weights()[index] + log(uniform->pdf_value()));
+    }
+    ASSERT_DOUBLE_EQ(max_log_likelihoods[0], log(0.8) + max_log_density);
+}
+
+TEST_F(MostProbableExplanationTest, UndefinedMode) {
+    auto product = std::make_shared<DecomposableProductUnit>();
+    product->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a, std::map<int, double>()));
+    std::vector<double> evidence{nan};
+    std::vector<double> assignments(1);
+    ASSERT_THROW(product->most_probable_explanation(evidence.data(), 1, assignments.data()), std::logic_error);
+}
@@ -84,4 +84,284 @@ TEST_F(NygaDistributionTest, FitWithSingularData){
     ASSERT_EQ(subcircuit->location, 1);
     ASSERT_EQ(result->weights.size(), 1);
     ASSERT_EQ(result->weights[0], 1);
-}
\ No newline at end of file
+}
+
+/**
+ * The quadratic split search as it was implemented before the prefix sums were introduced.
+ */
+std::tuple<double, int> reference_best_split(const InductionStep &step) {
+    auto sum_weights = [&](size_t begin_index, size_t end_index) {
+        double result = 0;
+        for (size_t i = begin_index; i < end_index; i++) {
+            result += (*step.log_weights_p)[i];
+        }
+        return result;
+    };
+
+    auto log_likelihood_of_split = [&](size_t split_index, double connecting_point) {
+        auto split_value = (step.data_p->at(split_index - 1) + step.data_p->at(split_index)) / 2;
+        double density = split_value - connecting_point;
+        double log_weight_sum = density < 0 ? sum_weights(step.begin_index, split_index)
+                                            : sum_weights(split_index, step.end_index);
+        return -log(fabs(density)) + log_weight_sum;
+    };
+
+    double maximum_log_likelihood = -std::numeric_limits<double>::infinity();
+    int best_split_index = -1;
+    auto min_samples = step.nyga_distribution_p->min_samples_per_quantile;
+    for (size_t split_index = step.begin_index + min_samples;
+         split_index < step.end_index - min_samples + 1; split_index++) {
+        auto log_likelihood = log_likelihood_of_split(split_index, step.left_connecting_point()) +
+                              log_likelihood_of_split(split_index, step.right_connecting_point());
+        if (log_likelihood > maximum_log_likelihood) {
+            maximum_log_likelihood = log_likelihood;
+            best_split_index = (int) split_index;
+        }
+    }
+    return std::make_tuple(maximum_log_likelihood, best_split_index);
+}
+
+TEST_F(NygaDistributionTest, ComputeBestSplitMatchesReference){
+    std::default_random_engine generator(42);
+    auto normal = std::normal_distribution<double>(0, 1);
+    auto counts = std::uniform_int_distribution<int>(1, 5);
+
+    auto data = new DataVector(500);
+    std::generate(data->begin(), data->end(), [&](){return normal(generator);});
+    std::sort(data->begin(), data->end());
+    auto log_weights = new WeightsVector(data->size());
+    std::generate(log_weights->begin(), log_weights->end(), [&](){return log(counts(generator));});
+
+    auto root = InductionStep(data, log_weights, 0, data->size(), model);
+    for (size_t min_samples: {1, 5, 20}) {
+        model->min_samples_per_quantile = min_samples;
+        for (auto [begin_index, end_index]: std::vector<std::pair<size_t, size_t>>{{0, 500}, {0, 137}, {212, 500},
+                                                                                   {40, 360}, {10, 30}}) {
+            auto step = root.construct_left_induction_step(end_index)->construct_right_induction_step(begin_index);
+            auto [likelihood, split_index] = step->compute_best_split();
+            auto [reference_likelihood, reference_split_index] = reference_best_split(*step);
+            EXPECT_EQ(split_index, reference_split_index);
+            if (reference_split_index >= 0) {
+                EXPECT_NEAR(likelihood, reference_likelihood, 1e-9);
+            }
+        }
+    }
+    delete data;
+    delete log_weights;
+}
+
+TEST_F(NygaDistributionTest, FitWithDuplicates){
+    auto data = new DataVector{1, 1, 2, 3, 3, 3, 4, 7, 9, 9};
+    auto result = model->fit(data);
+    for (auto &sub_circuit: result->sub_circuits) {
+        auto uniform = std::static_pointer_cast<UniformDistribution>(sub_circuit);
+        ASSERT_GE(uniform->support->lower(), 1);
+        ASSERT_LE(uniform->support->upper(), 9);
+    }
+    delete data;
+}
+
+TEST_F(NygaDistributionTest, FitInParallel){
+    auto normal = std::normal_distribution<double>(0, 1);
+    std::default_random_engine generator(69);
+    auto data = new DataVector(20000);
+    std::generate(data->begin(), data->end(), [&](){return normal(generator);});
+    auto parallel_data = new DataVector(*data);
+
+    model->min_samples_per_quantile = 10;
+    auto sequential_result = model->fit(data);
+
+    model->number_of_threads = 4;
+    model->min_samples_per_parallel_task = 64;
+    auto parallel_result = model->fit(parallel_data);
+
+    ASSERT_EQ(parallel_result->sub_circuits.size(), sequential_result->sub_circuits.size());
+    ASSERT_EQ(parallel_result->weights, sequential_result->weights);
+    double previous_upper = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < parallel_result->sub_circuits.size(); i++) {
+        auto parallel_uniform = std::static_pointer_cast<UniformDistribution>(parallel_result->sub_circuits[i]);
+        auto sequential_uniform = std::static_pointer_cast<UniformDistribution>(sequential_result->sub_circuits[i]);
+        ASSERT_EQ(parallel_uniform->support->lower(), sequential_uniform->support->lower());
+        ASSERT_EQ(parallel_uniform->support->upper(), sequential_uniform->support->upper());
+        ASSERT_GE(parallel_uniform->support->lower(), previous_upper);
+        previous_upper = parallel_uniform->support->upper();
+    }
+    delete data;
+    delete parallel_data;
+}
+
+TEST_F(NygaDistributionTest, FitStreaming){
+    auto normal = std::normal_distribution<double>(0, 1);
+    std::default_random_engine generator(69);
+    std::vector<DataVector> chunks(10, DataVector(1000));
+    auto data = new DataVector();
+    for (auto &chunk: chunks) {
+        std::generate(chunk.begin(), chunk.end(), [&](){return std::round(normal(generator) * 100) / 100;});
+        data->insert(data->end(), chunk.begin(), chunk.end());
+    }
+
+    model->min_samples_per_quantile = 20;
+    auto expected = model->fit(data);
+    // a budget of 64 unique values spills to disk
+    auto result = model->fit_streaming(chunks.begin(), chunks.end(), 64 * 2 * sizeof(double));
+
+    ASSERT_EQ(result->sub_circuits.size(), expected->sub_circuits.size());
+    ASSERT_EQ(result->weights, expected->weights);
+    for (size_t i = 0; i < result->sub_circuits.size(); i++) {
+        auto uniform = std::static_pointer_cast<UniformDistribution>(result->sub_circuits[i]);
+        auto expected_uniform = std::static_pointer_cast<UniformDistribution>(expected->sub_circuits[i]);
+        ASSERT_EQ(uniform->support->lower(), expected_uniform->support->lower());
+        ASSERT_EQ(uniform->support->upper(), expected_uniform->support->upper());
+    }
+    delete data;
+}
+
+TEST_F(NygaDistributionTest, FitWeightedMatchesFitOnSamples){
+    auto values = DataVector{3, 1, 2, 5, 4, 8, 7};
+    auto weights = WeightsVector{2, 1, 4, 0, 3, 1, 2};
+    auto data = new DataVector();
+    for (size_t i = 0; i < values.size(); i++) {
+        data->insert(data->end(), (size_t) weights[i], values[i]);
+    }
+
+    auto expected = model->fit(data);
+    auto result = model->fit_weighted(values, weights);
+    ASSERT_EQ(result->weights, expected->weights);
+    ASSERT_EQ(result->sub_circuits.size(), expected->sub_circuits.size());
+    for (size_t i = 0; i < result->sub_circuits.size(); i++) {
+        auto uniform = std::static_pointer_cast<UniformDistribution>(result->sub_circuits[i]);
+        auto expected_uniform = std::static_pointer_cast<UniformDistribution>(expected->sub_circuits[i]);
+        ASSERT_EQ(uniform->support->lower(), expected_uniform->support->lower());
+        ASSERT_EQ(uniform->support->upper(), expected_uniform->support->upper());
+    }
+    delete data;
+}
+
+TEST_F(NygaDistributionTest, FitWeightedRejectsInvalidWeights){
+    EXPECT_THROW(model->fit_weighted({1, 2}, {1}), std::invalid_argument);
+    EXPECT_THROW(model->fit_weighted({1, 2}, {1, -1}), std::invalid_argument);
+}
+
+TEST_F(NygaDistributionTest, QuantileWeightsAreProbabilities){
+    auto normal = std::normal_distribution<double>(0, 1);
+    std::default_random_engine generator(69);
+    auto data = new DataVector(2000);
+    std::generate(data->begin(), data->end(), [&](){return std::round(normal(generator) * 20) / 20;});
+
+    model->min_samples_per_quantile = 20;
+    auto result = model->fit(data);
+    ASSERT_GT(result->weights.size(), 1);
+    ASSERT_NEAR(std::accumulate(result->weights.begin(), result->weights.end(), 0.), 1., 1e-12);
+    for (auto weight: result->weights) {
+        ASSERT_GT(weight, 0);
+    }
+    delete data;
+}
+
+/**
+ * Build the Nyga Distribution 0.25 * U[0, 1) + 0.5 * U[1, 3) + 0.25 * U[3, 4] by hand.
+ */
+NygaDistributionPtr_t make_three_quantile_nyga_distribution(const ContinuousPtr_t &variable) {
+    auto result = NygaDistribution::make_shared(variable);
+    result->add_subcircuit(0.5, UniformDistribution::make_shared(variable, closed_open<double>(1, 3)));
+    result->add_subcircuit(0.25, UniformDistribution::make_shared(variable, closed_open<double>(0, 1)));
+    result->add_subcircuit(0.25, UniformDistribution::make_shared(variable, closed<double>(3, 4)));
+    return result;
+}
+
+TEST_F(NygaDistributionTest, CumulativeDistributionFunction) {
+    auto distribution = make_three_quantile_nyga_distribution(variable_x);
+    EXPECT_DOUBLE_EQ(distribution->cdf(-1.), 0.);
+    EXPECT_DOUBLE_EQ(distribution->cdf(0.), 0.);
+    EXPECT_DOUBLE_EQ(distribution->cdf(0.5), 0.125);
+    EXPECT_DOUBLE_EQ(distribution->cdf(2.), 0.5);
+    EXPECT_DOUBLE_EQ(distribution->cdf(3.5), 0.875);
+    EXPECT_DOUBLE_EQ(distribution->cdf(4.), 1.);
+    EXPECT_DOUBLE_EQ(distribution->cdf(10.), 1.);
+
+    std::vector<double> values{-1., 0.5, 2., 3.5, 10.};
+    std::vector<double> out(values.size());
+    distribution->cdf(values.data(), values.size(), out.data());
+    for (size_t index = 0; index < values.size(); index++) {
+        EXPECT_DOUBLE_EQ(out[index], distribution->cdf(values[index]));
+    }
+}
+
+TEST_F(NygaDistributionTest, QuantileInvertsCumulativeDistributionFunction) {
+    auto distribution = make_three_quantile_nyga_distribution(variable_x);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.), 0.);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.125), 0.5);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.25), 1.);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.5), 2.);
+    EXPECT_DOUBLE_EQ(distribution->quantile(1.), 4.);
+    EXPECT_THROW(distribution->quantile(1.5), std::invalid_argument);
+    EXPECT_THROW(distribution->quantile(std::numeric_limits<double>::quiet_NaN()), std::invalid_argument);
+
+    std::vector<double> probabilities{0.01, 0.3, 0.6, 0.99};
+    std::vector<double> values(probabilities.size());
+    std::vector<double> recovered(probabilities.size());
+    distribution->quantile(probabilities.data(), probabilities.size(), values.data());
+    distribution->cdf(values.data(), values.size(), recovered.data());
+    for (size_t index = 0; index < probabilities.size(); index++) {
+        EXPECT_NEAR(recovered[index], probabilities[index], 1e-12);
+    }
+}
+
+TEST_F(NygaDistributionTest, ProbabilityOfIntervals) {
+    auto distribution = make_three_quantile_nyga_distribution(variable_x);
+    EXPECT_DOUBLE_EQ(distribution->probability(closed<double>(0.5, 3.5)), 0.75);
+    EXPECT_DOUBLE_EQ(distribution->probability(reals()), 1.);
+
+    auto event = std::static_pointer_cast<Interval<double>>(
+            closed_open<double>(-1, 0.5)->union_with(closed_open<double>(1, 2))->union_with(open<double>(3.5, 8)));
+    EXPECT_DOUBLE_EQ(distribution->probability(event), 0.125 + 0.25 + 0.125);
+
+    std::vector<double> lowers{-1., 0.5, 2., 3.};
+    std::vector<double> uppers{0.5, 3.5, 1., 3.};
+    std::vector<double> out(lowers.size());
+    distribution->probability(lowers.data(), uppers.data(), lowers.size(), out.data());
+    EXPECT_DOUBLE_EQ(out[0], 0.125);
+    EXPECT_DOUBLE_EQ(out[1], 0.75);
+    EXPECT_DOUBLE_EQ(out[2], 0.);
+    EXPECT_DOUBLE_EQ(out[3], 0.);
+}
+
+TEST_F(NygaDistributionTest, ProbabilityOfDiracDelta) {
+    auto distribution = model->fit(new DataVector{2., 2., 2.});
+    EXPECT_DOUBLE_EQ(distribution->cdf(1.9), 0.);
+    EXPECT_DOUBLE_EQ(distribution->cdf(2.), 1.);
+    EXPECT_DOUBLE_EQ(distribution->probability(closed<double>(2, 2)), 1.);
+    EXPECT_DOUBLE_EQ(distribution->probability(closed_open<double>(1, 2)), 0.);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.5), 2.);
+}
+
+TEST_F(NygaDistributionTest, QueriesOfFittedDistribution) {
+    std::mt19937_64 generator(69);
+    std::normal_distribution<double> normal(0, 1);
+    DataVector samples(5000);
+    std::generate(samples.begin(), samples.end(), [&]() { return normal(generator); });
+    auto distribution = model->fit(&samples);
+
+    // the fitted distribution is close to the empirical distribution
+    EXPECT_NEAR(distribution->cdf(0.), 0.5, 0.02);
+    EXPECT_NEAR(distribution->quantile(0.5), 0., 0.05);
+    EXPECT_NEAR(distribution->probability(closed<double>(-1, 1)), 0.6827, 0.02);
+    EXPECT_DOUBLE_EQ(distribution->cdf(samples.back()), 1.);
+    EXPECT_DOUBLE_EQ(distribution->quantile(0.), samples.front());
+}
+
+TEST_F(NygaDistributionTest, ProbabilityOfProductEvent) {
+    auto distribution = make_three_quantile_nyga_distribution(variable_x);
+    ProductEvent event;
+    event[variable_x] = closed<double>(0.5, 3.5);
+    EXPECT_DOUBLE_EQ(distribution->probability(event), 0.75);
+    EXPECT_DOUBLE_EQ(distribution->probability(ProductEvent()), 1.);
+}
+
+TEST_F(NygaDistributionTest, NumberOfCandidateSplits){
+    ASSERT_EQ(induction_step.number_of_candidate_splits(), 5);
+    model->min_samples_per_quantile = 3;
+    ASSERT_EQ(induction_step.number_of_candidate_splits(), 1);
+    model->min_samples_per_quantile = 4;
+    ASSERT_EQ(induction_step.number_of_candidate_splits(), 0);
+}
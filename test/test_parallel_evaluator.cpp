@@ -0,0 +1,80 @@
+#include <cstring>
+#include <random>
+#include "gtest/gtest.h"
+#include "parallel_evaluator.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class ParallelEvaluatorTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    ContinuousPtr_t variable_y = make_shared_continuous("y");
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+    size_t n_rows = 5 * ProbabilisticModel::batch_block_size + 13;
+    std::vector<double> data;
+
+    ParallelEvaluatorTest() {
+        for (int component = 0; component < 4; component++) {
+            auto product = std::make_shared<DecomposableProductUnit>();
+            product->add_subcircuit(UniformDistribution::make_shared(variable_x,
+                                                                     closed<double>(component, component + 2)));
+            product->add_subcircuit(UniformDistribution::make_shared(variable_y,
+                                                                     closed_open<double>(-component, 1)));
+            root->add_subcircuit(0.1 + 0.1 * component, product);
+        }
+
+        std::mt19937_64 generator(69);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        data.resize(2 * n_rows);
+        std::generate(data.begin(), data.end(), [&]() { return uniform(generator); });
+    }
+};
+
+TEST_F(ParallelEvaluatorTest, BitIdenticalToSingleThreaded) {
+    auto compiled = CompiledCircuit::make_shared(root);
+    std::vector<double> expected(n_rows);
+    compiled->log_likelihood_batch(data.data(), n_rows, expected.data());
+
+    ParallelEvaluator evaluator(root, 4);
+    ASSERT_EQ(evaluator.number_of_threads(), 4);
+    std::vector<double> result(n_rows);
+    evaluator.log_likelihood_batch(data.data(), n_rows, result.data());
+    for (size_t row = 0; row < n_rows; row++) {
+        ASSERT_EQ(std::memcmp(&expected[row], &result[row], sizeof(double)), 0);
+    }
+
+    // the buffers of the workers are reused by the next batch
+    std::vector<double> prefix(100);
+    evaluator.log_likelihood_batch(data.data(), 1, prefix.data());
+    ASSERT_EQ(prefix[0], root->log_likelihood(std::make_shared<FullEvidence>(FullEvidence{data[0], data[1]})));
+}
+
+TEST_F(ParallelEvaluatorTest, SharesCompiledCircuit) {
+    auto compiled = CompiledCircuit::make_shared(root);
+    ParallelEvaluator evaluator(compiled, compiled->tape(), 3, -1, 100);
+    std::vector<double> result(n_rows);
+    evaluator.log_likelihood_batch(data.data(), n_rows, result.data());
+    for (size_t row = 0; row < n_rows; row += 97) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row], data[n_rows + row]});
+        ASSERT_NEAR(result[row], root->log_likelihood(event), 1e-12);
+    }
+    ASSERT_THROW(ParallelEvaluator(compiled, compiled->tape(), 1, -1, 0), std::invalid_argument);
+}
+
+TEST_F(ParallelEvaluatorTest, NumaNode) {
+    ASSERT_THROW(ParallelEvaluator(root, 1, 1 << 20), std::invalid_argument);
+    std::vector<size_t> cpus;
+    try {
+        cpus = cpus_of_numa_node(0);
+    } catch (const std::invalid_argument &) {
+        GTEST_SKIP() << "The platform does not expose NUMA nodes";
+    }
+
+    ParallelEvaluator evaluator(root, 0, 0);
+    ASSERT_EQ(evaluator.number_of_threads(), cpus.size());
+    std::vector<double> result(n_rows);
+    evaluator.log_likelihood_batch(data.data(), n_rows, result.data());
+    auto event = std::make_shared<FullEvidence>(FullEvidence{data[n_rows - 1], data[2 * n_rows - 1]});
+    ASSERT_NEAR(result[n_rows - 1], root->log_likelihood(event), 1e-12);
+}
@@ -80,3 +80,349 @@ TEST_F(DecomposableProductUnitTest, Likelihood) {
     EXPECT_DOUBLE_EQ(model.likelihood(event2), 0);
     EXPECT_DOUBLE_EQ(model.log_likelihood(event2), log(0));
 }
+
+TEST_F(SmoothSumUnitTest, LogLikelihoodBatch) {
+    auto data = std::vector<double>{1.0, 4.0, 2.5, 0.0, 8.0};
+    auto result = std::vector<double>(data.size());
+    model.log_likelihood_batch(data.data(), data.size(), result.data());
+    for (size_t row = 0; row < data.size(); row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row]});
+        EXPECT_DOUBLE_EQ(result[row], model.log_likelihood(event));
+    }
+}
+
+TEST_F(DecomposableProductUnitTest, LogLikelihoodBatch) {
+    // column x followed by column y
+    auto data = std::vector<double>{1.0, 2.0, 0.5,
+                                    0.5, 0.5, 0.9};
+    auto result = std::vector<double>(3);
+    model.log_likelihood_batch(data.data(), 3, result.data());
+    for (size_t row = 0; row < 3; row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row], data[3 + row]});
+        EXPECT_DOUBLE_EQ(result[row], model.log_likelihood(event));
+    }
+}
+
+TEST(ProbabilisticCircuit, LogLikelihoodBatchOfNestedCircuit) {
+    auto variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                           make_shared_all_elements(std::set<std::string>{"a", "b", "c"}));
+    auto variable_x = make_shared_continuous("x");
+    auto variable_y = make_shared_continuous("y");
+
+    auto sum = std::make_shared<SmoothSumUnit>();
+    sum->add_subcircuit(0.3, UniformDistribution::make_shared(variable_x, closed<double>(0, 1)));
+    sum->add_subcircuit(0.7, UniformDistribution::make_shared(variable_x, closed_open<double>(0.5, 4)));
+
+    auto product = std::make_shared<DecomposableProductUnit>();
+    product->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a,
+                                                                   std::map<int, double>{{0, 0.2}, {1, 0.8}}));
+    product->add_subcircuit(sum);
+    product->add_subcircuit(DiracDeltaDistribution::make_shared(variable_y, 2., 5.));
+
+    // more rows than one block
+    size_t n_rows = ProbabilisticModel::batch_block_size + 7;
+    std::vector<double> data(3 * n_rows);
+    for (size_t row = 0; row < n_rows; row++) {
+        data[row] = (double) (row % 3);
+        data[n_rows + row] = (double) (row % 50) / 10.;
+        data[2 * n_rows + row] = row % 4 == 0 ? 3. : 2.;
+    }
+
+    std::vector<double> result(n_rows);
+    product->log_likelihood_batch(data.data(), n_rows, result.data());
+    for (size_t row = 0; row < n_rows; row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row], data[n_rows + row],
+                                                                 data[2 * n_rows + row]});
+        EXPECT_DOUBLE_EQ(result[row], product->log_likelihood(event));
+    }
+}
+
+TEST(SmoothSumUnit, LogLikelihoodDoesNotUnderflow) {
+    auto variable_x = make_shared_continuous("x");
+    auto variable_y = make_shared_continuous("y");
+
+    // every product has a log-likelihood of about -1381, far below the smallest exponent of a double
+    auto model = std::make_shared<SmoothSumUnit>();
+    for (auto weight: {0.25, 0.75}) {
+        auto product = std::make_shared<DecomposableProductUnit>();
+        product->add_subcircuit(UniformDistribution::make_shared(variable_x, closed<double>(0, 1e300)));
+        product->add_subcircuit(UniformDistribution::make_shared(variable_y, closed<double>(0, 1e300)));
+        model->add_subcircuit(weight, product);
+    }
+
+    auto event = std::make_shared<FullEvidence>(FullEvidence{1., 2.});
+    auto expected = -2 * log(1e300);
+    EXPECT_NEAR(model->log_likelihood(event), expected, 1e-9);
+
+    std::vector<double> data{1., 2.};
+    double result;
+    model->log_likelihood_batch(data.data(), 1, &result);
+    EXPECT_NEAR(result, expected, 1e-9);
+}
+
+TEST_F(SmoothSumUnitTest, SetWeights) {
+    model.set_weights({0.2, 0.8});
+    auto event = std::make_shared<FullEvidence>(FullEvidence{4.0});
+    EXPECT_DOUBLE_EQ(model.log_likelihood(event), log(0.8 * 0.2));
+    EXPECT_DOUBLE_EQ(model.likelihood(event), 0.8 * 0.2);
+    EXPECT_THROW(model.set_weights({1.}), std::invalid_argument);
+
+    model.set_weight(0, 0.5);
+    EXPECT_DOUBLE_EQ(model.log_weights()[0], log(0.5));
+    EXPECT_EQ(model.weights, (std::vector<double>{0.5, 0.8}));
+}
+
+TEST_F(SmoothSumUnitTest, CopiesViewTheirOwnWeights) {
+    SmoothSumUnit copy(model);
+    SmoothSumUnit assigned;
+    assigned = model;
+    copy.set_weight(0, 0.1);
+    assigned.set_weight(1, 0.9);
+
+    EXPECT_EQ(model.weights, (std::vector<double>{0.5, 0.5}));
+    EXPECT_EQ(copy.weights, (std::vector<double>{0.1, 0.5}));
+    EXPECT_EQ(assigned.weights, (std::vector<double>{0.5, 0.9}));
+    EXPECT_DOUBLE_EQ(assigned.log_weights()[1], log(0.9));
+}
+
+TEST_F(DecomposableProductUnitTest, ScopeIsCachedAndInvalidated) {
+    auto scope = model.scope();
+    EXPECT_EQ(model.scope(), scope);
+    ASSERT_EQ(scope->sub_circuit_column_indices.size(), 2);
+    EXPECT_EQ(scope->sub_circuit_column_indices[0], std::vector<size_t>{0});
+    EXPECT_EQ(scope->sub_circuit_column_indices[1], std::vector<size_t>{1});
+
+    // adding a subcircuit over a variable that sorts between x and y shifts the columns of y
+    auto variable_xy = make_shared_continuous("xy");
+    model.add_subcircuit(UniformDistribution::make_shared(variable_xy, closed_open<double>(0, 4)));
+    auto new_scope = model.scope();
+    EXPECT_NE(new_scope, scope);
+    EXPECT_EQ(new_scope->variables->size(), 3);
+    EXPECT_EQ(new_scope->sub_circuit_column_indices[1], std::vector<size_t>{2});
+    EXPECT_EQ(new_scope->sub_circuit_column_indices[2], std::vector<size_t>{1});
+
+    auto event = std::make_shared<FullEvidence>(FullEvidence{1.0, 2.0, 0.5});
+    EXPECT_DOUBLE_EQ(model.log_likelihood(event), log(0.5 * 0.25));
+}
+
+TEST(DecomposableProductUnit, NestedProducts) {
+    auto variable_a = make_shared_continuous("a");
+    auto variable_b = make_shared_continuous("b");
+    auto variable_c = make_shared_continuous("c");
+
+    auto inner = std::make_shared<DecomposableProductUnit>();
+    inner->add_subcircuit(UniformDistribution::make_shared(variable_a, closed<double>(0, 2)));
+    inner->add_subcircuit(UniformDistribution::make_shared(variable_c, closed<double>(0, 4)));
+
+    auto outer = std::make_shared<DecomposableProductUnit>();
+    outer->add_subcircuit(UniformDistribution::make_shared(variable_b, closed<double>(0, 1)));
+    outer->add_subcircuit(inner);
+
+    auto event = std::make_shared<FullEvidence>(FullEvidence{1.0, 0.5, 5.0});
+    EXPECT_EQ(outer->log_likelihood(event), -std::numeric_limits<double>::infinity());
+    event = std::make_shared<FullEvidence>(FullEvidence{1.0, 0.5, 3.0});
+    EXPECT_DOUBLE_EQ(outer->log_likelihood(event), log(0.5 * 0.25));
+}
+
+class DeterministicSumUnitTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x;
+    std::shared_ptr<DeterministicSumUnit> model;
+    SmoothSumUnit reference;
+
+    /**
+     * Build 0.2 * U[3, 4) + 0.3 * U(0, 1] + 0.1 * U(1, 2) + 0.4 * U[2, 3) with the subcircuits out of order.
+     */
+    DeterministicSumUnitTest() {
+        variable_x = make_shared_continuous("x");
+        model = std::make_shared<DeterministicSumUnit>();
+        std::vector<std::pair<double, ProbabilisticCircuitPtr_t>> sub_circuits{
+                {0.2, UniformDistribution::make_shared(variable_x, closed_open<double>(3, 4))},
+                {0.3, UniformDistribution::make_shared(variable_x, open_closed<double>(0, 1))},
+                {0.1, UniformDistribution::make_shared(variable_x, open<double>(1, 2))},
+                {0.4, UniformDistribution::make_shared(variable_x, closed_open<double>(2, 3))}};
+        for (auto &[weight, sub_circuit]: sub_circuits) {
+            model->add_subcircuit(weight, sub_circuit);
+            reference.add_subcircuit(weight, sub_circuit);
+        }
+    }
+};
+
+TEST_F(DeterministicSumUnitTest, IntervalIndexMatchesSum) {
+    EXPECT_TRUE(model->interval_index()->is_applicable);
+
+    std::vector<double> values{-1., 0., 0.5, 1., 1.5, 2., 2.5, 3., 3.5, 4., 5.,
+                               std::numeric_limits<double>::quiet_NaN()};
+    std::vector<double> out(values.size());
+    model->log_likelihood_batch(values.data(), values.size(), out.data());
+    for (size_t index = 0; index < values.size(); index++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{values[index]});
+        EXPECT_DOUBLE_EQ(model->log_likelihood(event), reference.log_likelihood(event));
+        EXPECT_DOUBLE_EQ(out[index], reference.log_likelihood(event));
+        EXPECT_DOUBLE_EQ(model->likelihood(event), reference.likelihood(event));
+    }
+}
+
+TEST_F(DeterministicSumUnitTest, IntervalIndexIsRebuilt) {
+    auto index = model->interval_index();
+    EXPECT_EQ(model->interval_index(), index);
+
+    model->add_subcircuit(0.1, UniformDistribution::make_shared(variable_x, closed<double>(5, 6)));
+    EXPECT_NE(model->interval_index(), index);
+    EXPECT_EQ(model->interval_index()->lowers.size(), 5);
+    EXPECT_DOUBLE_EQ(model->log_likelihood(std::make_shared<FullEvidence>(FullEvidence{6.})), log(0.1));
+
+    model->set_weight(4, 0.5);
+    EXPECT_DOUBLE_EQ(model->log_likelihood(std::make_shared<FullEvidence>(FullEvidence{6.})), log(0.5));
+}
+
+TEST_F(DeterministicSumUnitTest, OverlappingSupportsFallBack) {
+    model->add_subcircuit(0.1, UniformDistribution::make_shared(variable_x, closed<double>(3.5, 6)));
+    reference.add_subcircuit(0.1, model->sub_circuits.back());
+    EXPECT_FALSE(model->interval_index()->is_applicable);
+
+    auto event = std::make_shared<FullEvidence>(FullEvidence{3.75});
+    EXPECT_DOUBLE_EQ(model->log_likelihood(event), reference.log_likelihood(event));
+}
+
+TEST_F(DeterministicSumUnitTest, SharedBorderFallsBack) {
+    model->add_subcircuit(0.1, UniformDistribution::make_shared(variable_x, closed<double>(1, 1.5)));
+    EXPECT_FALSE(model->interval_index()->is_applicable);
+}
+
+class ProbabilityTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x;
+    SymbolicPtr_t variable_a;
+    IntegerPtr_t variable_i;
+    ProbabilisticCircuitPtr_t shared_leaf;
+    ProbabilisticCircuitPtr_t model;
+
+    /**
+     * Build 0.4 * [x ~ U[0, 2), a ~ {0: 0.5, 1: 0.5}, i ~ {1: 0.2, 2: 0.8}]
+     *     + 0.6 * [x ~ δ(3), a ~ {2: 1}, i ~ {1: 0.2, 2: 0.8}]
+     * where the distribution of i is shared.
+     */
+    ProbabilityTest() {
+        variable_x = make_shared_continuous("x");
+        variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                          make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+        variable_i = make_shared_integer("i");
+        shared_leaf = std::make_shared<IntegerDistribution>(variable_i, std::map<int, double>{{1, 0.2}, {2, 0.8}});
+
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(UniformDistribution::make_shared(variable_x, closed_open<double>(0, 2)));
+        product_1->add_subcircuit(std::make_shared<SymbolicDistribution>(
+                variable_a, std::map<int, double>{{0, 0.5}, {1, 0.5}}));
+        product_1->add_subcircuit(shared_leaf);
+
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(DiracDeltaDistribution::make_shared(variable_x, 3.));
+        product_2->add_subcircuit(std::make_shared<SymbolicDistribution>(variable_a, std::map<int, double>{{2, 1.}}));
+        product_2->add_subcircuit(shared_leaf);
+
+        auto sum = std::make_shared<SmoothSumUnit>();
+        sum->add_subcircuit(0.4, product_1);
+        sum->add_subcircuit(0.6, product_2);
+        model = sum;
+    }
+};
+
+TEST_F(ProbabilityTest, UnconstrainedEventIsCertain) {
+    EXPECT_DOUBLE_EQ(model->probability(ProductEvent()), 1.);
+}
+
+TEST_F(ProbabilityTest, ProbabilityOfEvents) {
+    ProductEvent event;
+    event[variable_x] = closed<double>(1, 3);
+    EXPECT_DOUBLE_EQ(model->probability(event), 0.4 * 0.5 + 0.6);
+
+    event[variable_x] = closed_open<double>(1, 3);
+    EXPECT_DOUBLE_EQ(model->probability(event), 0.4 * 0.5);
+
+    event[variable_a] = make_shared_set_element(0, variable_a->all_elements)->union_with(
+            make_shared_set_element(2, variable_a->all_elements));
+    event[variable_x] = closed<double>(1, 3);
+    EXPECT_DOUBLE_EQ(model->probability(event), 0.4 * 0.5 * 0.5 + 0.6);
+
+    event[variable_i] = closed_open<int>(0, 2);
+    EXPECT_DOUBLE_EQ(model->probability(event), (0.4 * 0.5 * 0.5 + 0.6) * 0.2);
+}
+
+TEST_F(ProbabilityTest, BatchMatchesSingleEvents) {
+    std::vector<ProductEvent> events(3);
+    events[0][variable_x] = closed<double>(-1, 0.5);
+    events[1][variable_i] = singleton<int>(2);
+    events[2][variable_x] = closed_open<double>(0, 1)->union_with(closed<double>(1.5, 3));
+    events[2][variable_a] = make_shared_set_element(1, variable_a->all_elements);
+
+    std::vector<double> out(events.size());
+    model->probability(events, out.data());
+    EXPECT_DOUBLE_EQ(out[0], 0.4 * 0.25);
+    EXPECT_DOUBLE_EQ(out[1], 0.8);
+    EXPECT_DOUBLE_EQ(out[2], 0.4 * 0.75 * 0.5);
+    for (size_t index = 0; index < events.size(); index++) {
+        EXPECT_DOUBLE_EQ(out[index], model->probability(events[index]));
+    }
+}
+
+TEST_F(ProbabilityTest, SharedNodesAreVisitedOnce) {
+    auto nodes = model->nodes_in_post_order();
+    EXPECT_EQ(nodes.size(), 8);
+    EXPECT_EQ(nodes.back(), model.get());
+    EXPECT_EQ(std::count(nodes.begin(), nodes.end(), shared_leaf.get()), 1);
+}
+
+TEST_F(ProbabilityTest, MarginalCollapsesProducts) {
+    auto variables = make_shared_variable_set();
+    variables->insert(variable_x);
+    auto marginal = model->marginal(variables);
+    EXPECT_EQ(marginal->representation(), "+");
+    EXPECT_EQ(marginal->get_variables()->size(), 1);
+    EXPECT_EQ(marginal->sub_circuits[0], model->sub_circuits[0]->sub_circuits[0]);
+    EXPECT_EQ(marginal->sub_circuits[1], model->sub_circuits[1]->sub_circuits[0]);
+
+    ProductEvent event;
+    event[variable_x] = closed<double>(1, 3);
+    EXPECT_DOUBLE_EQ(marginal->probability(event), model->probability(event));
+}
+
+TEST_F(ProbabilityTest, MarginalKeepsSharedNodesShared) {
+    auto variables = make_shared_variable_set();
+    variables->insert({variable_a, variable_i});
+    auto marginal = model->marginal(variables);
+    EXPECT_EQ(marginal->get_variables()->size(), 2);
+    EXPECT_EQ(marginal->sub_circuits[0]->sub_circuits.size(), 2);
+    EXPECT_EQ(marginal->sub_circuits[0]->sub_circuits[1], shared_leaf);
+    EXPECT_EQ(marginal->sub_circuits[1]->sub_circuits[1], shared_leaf);
+
+    ProductEvent event;
+    event[variable_a] = make_shared_set_element(0, variable_a->all_elements);
+    event[variable_i] = singleton<int>(2);
+    EXPECT_DOUBLE_EQ(marginal->probability(event), model->probability(event));
+
+    // a shared cache returns the same marginal for the same variables
+    MarginalCache cache;
+    EXPECT_EQ(model->marginal(variables, cache), model->marginal(variables, cache));
+}
+
+TEST_F(ProbabilityTest, MarginalOfAllOrNoVariables) {
+    EXPECT_EQ(model->marginal(model->get_variables()), model);
+    EXPECT_EQ(model->marginal(make_shared_variable_set()), nullptr);
+}
+
+TEST(SmoothSumUnit, LogLikelihoodBatchOfDiracDelta) {
+    auto variable_x = make_shared_continuous("x");
+    auto model = std::make_shared<SmoothSumUnit>();
+    model->add_subcircuit(0.5, std::make_shared<DiracDeltaDistribution>(variable_x, 1.));
+    model->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+
+    std::vector<double> data{1., 1.5, 3.};
+    std::vector<double> result(data.size());
+    model->log_likelihood_batch(data.data(), data.size(), result.data());
+    for (size_t row = 0; row < data.size(); row++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{data[row]});
+        EXPECT_EQ(result[row], model->log_likelihood(event));
+    }
+    EXPECT_EQ(result[0], std::numeric_limits<double>::infinity());
+}
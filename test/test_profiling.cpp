@@ -0,0 +1,122 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "nyga_distribution.h"
+#include "profiling.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class ProfilingTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    std::shared_ptr<SmoothSumUnit> sum = std::make_shared<SmoothSumUnit>();
+
+    ProfilingTest() {
+        Profiler::instance().reset();
+        sum->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 1)));
+        sum->add_subcircuit(0.5, UniformDistribution::make_shared(variable_x, closed<double>(0, 2)));
+    }
+
+    ~ProfilingTest() override {
+        Profiler::instance().set_node_evaluation_callback(nullptr);
+        Profiler::instance().reset();
+    }
+};
+
+TEST_F(ProfilingTest, ReportAggregatesNodesAndTypes) {
+    int first_node;
+    int second_node;
+    int third_node;
+    auto &profiler = Profiler::instance();
+    profiler.record_node_evaluation(&first_node, typeid(SmoothSumUnit), 10, 1.);
+    profiler.record_node_evaluation(&first_node, typeid(SmoothSumUnit), 5, 2.);
+    profiler.record_node_evaluation(&second_node, typeid(SmoothSumUnit), 1, 4.);
+    profiler.record_node_evaluation(&third_node, typeid(DecomposableProductUnit), 1, 0.5);
+
+    auto report = profiler.report();
+    ASSERT_EQ(report.nodes.size(), 3);
+    ASSERT_EQ(report.nodes[0].node, &second_node);
+    ASSERT_EQ(report.nodes[1].node, &first_node);
+    ASSERT_EQ(report.nodes[1].evaluations, 2);
+    ASSERT_EQ(report.nodes[1].rows, 15);
+    ASSERT_EQ(report.nodes[1].seconds, 3.);
+    ASSERT_EQ(report.nodes[1].type, "SmoothSumUnit");
+
+    ASSERT_EQ(report.node_types.size(), 2);
+    ASSERT_EQ(report.node_types[0].type, "SmoothSumUnit");
+    ASSERT_EQ(report.node_types[0].node, nullptr);
+    ASSERT_EQ(report.node_types[0].evaluations, 3);
+    ASSERT_EQ(report.node_types[0].rows, 16);
+    ASSERT_EQ(report.node_types[0].seconds, 7.);
+    ASSERT_EQ(report.node_types[1].type, "DecomposableProductUnit");
+
+    auto json = report.to_json();
+    ASSERT_NE(json.find("\"node_types\": [{\"type\": \"SmoothSumUnit\", \"evaluations\": 3, \"rows\": 16"),
+              std::string::npos);
+    ASSERT_NE(json.find("\"fitting\": {\"fits\": 0"), std::string::npos);
+    ASSERT_NE(report.to_text().find("DecomposableProductUnit"), std::string::npos);
+
+    profiler.reset();
+    ASSERT_TRUE(profiler.report().nodes.empty());
+}
+
+TEST_F(ProfilingTest, FitCounters) {
+    auto &profiler = Profiler::instance();
+    profiler.record_fit();
+    profiler.record_induction_step(0);
+    profiler.record_induction_step(3);
+    profiler.record_induction_step(1);
+    profiler.record_candidate_splits(7);
+    profiler.record_fit_phase(FitPhase::SORT, 1.);
+    profiler.record_fit_phase(FitPhase::SPLIT_SEARCH, 2.);
+    profiler.record_fit_phase(FitPhase::SPLIT_SEARCH, 0.5);
+
+    auto fitting = profiler.report().fitting;
+    ASSERT_EQ(fitting.fits, 1);
+    ASSERT_EQ(fitting.induction_steps, 3);
+    ASSERT_EQ(fitting.max_depth, 3);
+    ASSERT_EQ(fitting.candidate_splits, 7);
+    ASSERT_EQ(fitting.sort_seconds, 1.);
+    ASSERT_EQ(fitting.aggregation_seconds, 0.);
+    ASSERT_EQ(fitting.split_search_seconds, 2.5);
+}
+
+TEST_F(ProfilingTest, Callback) {
+    std::vector<NodeEvaluation> evaluations;
+    Profiler::instance().set_node_evaluation_callback([&evaluations](const NodeEvaluation &evaluation) {
+        evaluations.push_back(evaluation);
+    });
+    Profiler::instance().record_node_evaluation(sum.get(), typeid(SmoothSumUnit), 3, 1.);
+    ASSERT_EQ(evaluations.size(), 1);
+    ASSERT_EQ(evaluations[0].node, sum.get());
+    ASSERT_EQ(evaluations[0].type, std::type_index(typeid(SmoothSumUnit)));
+    ASSERT_EQ(evaluations[0].rows, 3);
+}
+
+TEST_F(ProfilingTest, Hooks) {
+    std::vector<double> values{0.5, 1.5, 3};
+    std::vector<double> log_likelihoods(values.size());
+    sum->log_likelihood_batch(values.data(), values.size(), log_likelihoods.data());
+
+    auto data = new DataVector{1, 2, 3, 4, 7, 9};
+    NygaDistribution::make_shared(variable_x, 1, 0.01)->fit(data);
+    delete data;
+
+    auto report = Profiler::instance().report();
+#ifdef PROBABILISTIC_MODEL_PROFILING
+    ASSERT_EQ(report.nodes.size(), 3);
+    ASSERT_EQ(report.nodes[0].node, sum.get());
+    ASSERT_EQ(report.nodes[0].evaluations, 1);
+    ASSERT_EQ(report.nodes[0].rows, 3);
+    ASSERT_EQ(report.node_types[0].type, "SmoothSumUnit");
+    ASSERT_EQ(report.node_types[1].type, "UniformDistribution");
+    ASSERT_EQ(report.node_types[1].evaluations, 2);
+    ASSERT_EQ(report.fitting.fits, 1);
+    ASSERT_GT(report.fitting.induction_steps, 1);
+    ASSERT_GT(report.fitting.candidate_splits, 0);
+    ASSERT_GT(report.fitting.max_depth, 0);
+#else
+    ASSERT_TRUE(report.nodes.empty());
+    ASSERT_EQ(report.fitting.fits, 0);
+#endif
+}
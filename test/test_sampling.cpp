@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+#include "alias_table.h"
+#include "probabilistic_circuit.h"
+#include "univariate.h"
+#include "interval.h"
+#include "variable.h"
+#include <stdexcept>
+
+
+TEST(AliasTable, DrawsProportionalToWeights) {
+    AliasTable table({1., 0., 3., 4.});
+    RandomGenerator_t generator(69);
+    std::vector<size_t> counts(table.size());
+    size_t n = 200000;
+    for (size_t i = 0; i < n; i++) {
+        counts[table.draw(generator)]++;
+    }
+    EXPECT_NEAR((double) counts[0] / n, 0.125, 0.005);
+    EXPECT_EQ(counts[1], 0);
+    EXPECT_NEAR((double) counts[2] / n, 0.375, 0.005);
+    EXPECT_NEAR((double) counts[3] / n, 0.5, 0.005);
+}
+
+TEST(AliasTable, RejectsInvalidWeights) {
+    EXPECT_THROW(AliasTable({}), std::invalid_argument);
+    EXPECT_THROW(AliasTable({0., 0.}), std::invalid_argument);
+    EXPECT_THROW(AliasTable({1., -1., 2.}), std::invalid_argument);
+}
+
+class SamplingTest : public testing::Test {
+public:
+    ContinuousPtr_t variable_x;
+    ContinuousPtr_t variable_y;
+    IntegerPtr_t variable_i;
+    ProbabilisticCircuitPtr_t model;
+
+    /**
+     * Build the mixture 0.25 * [x ~ U(0, 1), y ~ δ(5), i ~ {1: 1}] + 0.75 * [x ~ U(2, 4), y ~ δ(7), i ~ {2: .5, 3: .5}].
+     */
+    SamplingTest() {
+        variable_x = make_shared_continuous("x");
+        variable_y = make_shared_continuous("y");
+        variable_i = make_shared_integer("i");
+
+        auto product_1 = std::make_shared<DecomposableProductUnit>();
+        product_1->add_subcircuit(UniformDistribution::make_shared(variable_x, closed_open<double>(0, 1)));
+        product_1->add_subcircuit(DiracDeltaDistribution::make_shared(variable_y, 5., 1.));
+        product_1->add_subcircuit(std::make_shared<IntegerDistribution>(variable_i, std::map<int, double>{{1, 1.}}));
+
+        auto product_2 = std::make_shared<DecomposableProductUnit>();
+        product_2->add_subcircuit(DiracDeltaDistribution::make_shared(variable_y, 7., 1.));
+        product_2->add_subcircuit(std::make_shared<IntegerDistribution>(
+                variable_i, std::map<int, double>{{2, 0.5}, {3, 0.5}}));
+        product_2->add_subcircuit(UniformDistribution::make_shared(variable_x, closed_open<double>(2, 4)));
+
+        auto sum = std::make_shared<SmoothSumUnit>();
+        sum->add_subcircuit(0.25, product_1);
+        sum->add_subcircuit(0.75, product_2);
+        model = sum;
+    }
+};
+
+TEST_F(SamplingTest, SamplesAreConsistentWithTheComponents) {
+    size_t n = 100000;
+    std::vector<double> samples(3 * n);
+    RandomGenerator_t generator(69);
+    model->sample(n, generator, samples.data());
+
+    // the columns are ordered by name: i, x, y
+    auto i = samples.data();
+    auto x = samples.data() + n;
+    auto y = samples.data() + 2 * n;
+    size_t first_component = 0;
+    size_t code_2 = 0;
+    for (size_t row = 0; row < n; row++) {
+        if (y[row] == 5.) {
+            first_component++;
+            EXPECT_EQ(i[row], 1.);
+            EXPECT_GE(x[row], 0.);
+            EXPECT_LT(x[row], 1.);
+        } else {
+            EXPECT_EQ(y[row], 7.);
+            EXPECT_TRUE(i[row] == 2. || i[row] == 3.);
+            code_2 += i[row] == 2.;
+            EXPECT_GE(x[row], 2.);
+            EXPECT_LT(x[row], 4.);
+        }
+    }
+    EXPECT_NEAR((double) first_component / n, 0.25, 0.01);
+    EXPECT_NEAR((double) code_2 / (n - first_component), 0.5, 0.01);
+}
+
+TEST_F(SamplingTest, SamplesHaveFiniteLikelihood) {
+    size_t n = 1000;
+    std::vector<double> samples(3 * n);
+    RandomGenerator_t generator(69);
+    model->sample(n, generator, samples.data());
+
+    std::vector<double> log_likelihoods(n);
+    model->log_likelihood_batch(samples.data(), n, log_likelihoods.data());
+    for (auto log_likelihood: log_likelihoods) {
+        EXPECT_TRUE(std::isfinite(log_likelihood));
+    }
+}
+
+TEST_F(SamplingTest, SameSeedSameSamples) {
+    size_t n = 100;
+    std::vector<double> samples_1(3 * n);
+    std::vector<double> samples_2(3 * n);
+    RandomGenerator_t generator_1(42);
+    RandomGenerator_t generator_2(42);
+    model->sample(n, generator_1, samples_1.data());
+    model->sample(n, generator_2, samples_2.data());
+    EXPECT_EQ(samples_1, samples_2);
+}
+
+TEST_F(SamplingTest, ChangedWeightsAfterResetCaches) {
+    auto sum = std::static_pointer_cast<SmoothSumUnit>(model);
+    size_t n = 100;
+    std::vector<double> samples(3 * n);
+    RandomGenerator_t generator(69);
+    model->sample(n, generator, samples.data());
+
+    sum->set_weights({0., 1.});
+    model->sample(n, generator, samples.data());
+    for (size_t row = 0; row < n; row++) {
+        EXPECT_EQ(samples[2 * n + row], 7.);
+    }
+}
+
+TEST(UniformSampling, MultipleIntervals) {
+    auto variable_x = make_shared_continuous("x");
+    auto support = closed_open<double>(0, 1)->union_with(closed_open<double>(2, 5));
+    UniformDistribution distribution(variable_x, std::static_pointer_cast<Interval<double>>(support));
+
+    size_t n = 100000;
+    std::vector<double> samples(n);
+    RandomGenerator_t generator(69);
+    distribution.sample(n, generator, samples.data());
+    size_t in_first_interval = 0;
+    for (auto sample: samples) {
+        EXPECT_TRUE((sample >= 0 && sample < 1) || (sample >= 2 && sample < 5));
+        in_first_interval += sample < 1;
+    }
+    EXPECT_NEAR((double) in_first_interval / n, 0.25, 0.01);
+}
+
+TEST(Sampling, UnsupportedLeafThrows) {
+    class Unsupported : public ContinuousDistribution {
+    public:
+        explicit Unsupported(const AbstractVariablePtr_t &variable) {
+            this->variable = variable;
+        }
+
+        double log_pdf(double /*value*/) const override {
+            return 0;
+        }
+
+        std::string distribution_representation() const override {
+            return "Unsupported";
+        }
+    };
+
+    Unsupported distribution(make_shared_continuous("x"));
+    std::vector<double> samples(1);
+    RandomGenerator_t generator(69);
+    EXPECT_THROW(distribution.sample(1, generator, samples.data()), std::logic_error);
+}
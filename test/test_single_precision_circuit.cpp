@@ -0,0 +1,106 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "single_precision_circuit.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class SinglePrecisionCircuitTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    ContinuousPtr_t variable_y = make_shared_continuous("y");
+    std::mt19937_64 generator{69};
+
+    /**
+     * A circuit of `depth` sum layers above a layer of products. The borders of the uniform distributions are
+     * multiples of 1/8, hence they are the same in single and double precision.
+     */
+    ProbabilisticCircuitPtr_t random_circuit(size_t depth) {
+        std::uniform_int_distribution<int> eighths(0, 24);
+        std::uniform_real_distribution<double> weight(0.1, 1);
+        if (depth == 0) {
+            auto product = std::make_shared<DecomposableProductUnit>();
+            for (auto &variable: {variable_x, variable_y}) {
+                auto lower = eighths(generator) / 8.;
+                product->add_subcircuit(UniformDistribution::make_shared(
+                        variable, closed<double>(lower, lower + 1 + eighths(generator) / 8.)));
+            }
+            auto probability = weight(generator);
+            product->add_subcircuit(std::make_shared<SymbolicDistribution>(
+                    variable_a, std::map<int, double>{{0, probability / 2}, {1, probability / 2},
+                                                      {2, 1 - probability}}));
+            return product;
+        }
+        auto sum = std::make_shared<SmoothSumUnit>();
+        std::vector<double> weights{weight(generator), weight(generator), weight(generator)};
+        auto total = weights[0] + weights[1] + weights[2];
+        for (auto child_weight: weights) {
+            sum->add_subcircuit(child_weight / total, random_circuit(depth - 1));
+        }
+        return sum;
+    }
+};
+
+TEST_F(SinglePrecisionCircuitTest, ErrorBound) {
+    size_t n_rows = 3 * ProbabilisticModel::batch_block_size + 5;
+    std::uniform_real_distribution<float> value(0, 6);
+    std::uniform_int_distribution<int> code(0, 2);
+    std::vector<float> float_data(3 * n_rows);
+    for (size_t row = 0; row < n_rows; row++) {
+        float_data[row] = (float) code(generator);
+        float_data[n_rows + row] = value(generator);
+        float_data[2 * n_rows + row] = value(generator);
+    }
+    std::vector<double> data(float_data.begin(), float_data.end());
+
+    for (size_t depth = 0; depth < 4; depth++) {
+        auto circuit = random_circuit(depth);
+        auto compiled = CompiledCircuit::make_shared(circuit);
+        std::vector<double> expected(n_rows);
+        compiled->log_likelihood_batch(data.data(), n_rows, expected.data());
+
+        SinglePrecisionCircuit single_precision(compiled, compiled->tape());
+        std::vector<float> result(n_rows);
+        single_precision.log_likelihood_batch(float_data.data(), n_rows, result.data());
+
+        size_t possible_rows = 0;
+        for (size_t row = 0; row < n_rows; row++) {
+            if (std::isinf(expected[row])) {
+                ASSERT_EQ(result[row], expected[row]);
+                continue;
+            }
+            possible_rows++;
+            auto bound = (double) (depth + 1) * 1.2e-7 * (std::abs(expected[row]) + 1);
+            ASSERT_NEAR(result[row], expected[row], bound) << depth << " " << row;
+        }
+        ASSERT_GT(possible_rows, n_rows / 10);
+    }
+}
+
+TEST_F(SinglePrecisionCircuitTest, SharesStructure) {
+    auto compiled = CompiledCircuit::make_shared(random_circuit(2));
+    SinglePrecisionCircuit single_precision(compiled, compiled->tape());
+    auto tape = single_precision.tape();
+    ASSERT_EQ(single_precision.number_of_nodes(), compiled->number_of_nodes());
+    ASSERT_EQ(tape.children, compiled->children.data());
+    ASSERT_EQ(single_precision.edge_log_weights.size(), compiled->edge_log_weights.size());
+    ASSERT_EQ(single_precision.edge_log_weights[0], (float) compiled->edge_log_weights[0]);
+    ASSERT_EQ(single_precision.parameters.size(), compiled->parameters.size());
+}
+
+TEST_F(SinglePrecisionCircuitTest, CodesMustBeExact) {
+    auto variable_i = make_shared_integer("i");
+    auto large_codes = std::make_shared<IntegerDistribution>(variable_i, std::map<int, double>{{1 << 25, 1.}});
+    ASSERT_THROW(SinglePrecisionCircuit{large_codes}, std::invalid_argument);
+
+    auto small_codes = std::make_shared<IntegerDistribution>(variable_i, std::map<int, double>{{-3, 0.25}, {4, 0.75}});
+    SinglePrecisionCircuit single_precision(small_codes);
+    std::vector<float> data{-3, 4, 0};
+    std::vector<float> result(3);
+    single_precision.log_likelihood_batch(data.data(), 3, result.data());
+    ASSERT_FLOAT_EQ(result[0], std::log(0.25f));
+    ASSERT_FLOAT_EQ(result[1], std::log(0.75f));
+    ASSERT_EQ(result[2], -std::numeric_limits<float>::infinity());
+}
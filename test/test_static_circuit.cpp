@@ -0,0 +1,103 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "static_circuit.h"
+#include "univariate.h"
+#include "variable.h"
+
+
+class StaticCircuitTest : public testing::Test {
+public:
+    SymbolicPtr_t variable_a = make_shared_symbolic(std::make_shared<std::string>("a"),
+                                                    make_shared_all_elements(std::set<std::string>{"r", "g", "b"}));
+    ContinuousPtr_t variable_x = make_shared_continuous("x");
+    ContinuousPtr_t variable_y = make_shared_continuous("y");
+    std::shared_ptr<SmoothSumUnit> root = std::make_shared<SmoothSumUnit>();
+
+    typedef StaticProduct<StaticDiscrete<3>, StaticUniform, StaticUniform> Component;
+
+    StaticCircuitTest() {
+        for (int component = 0; component < 3; component++) {
+            auto product = std::make_shared<DecomposableProductUnit>();
+            product->add_subcircuit(std::make_shared<SymbolicDistribution>(
+                    variable_a, std::map<int, double>{{component, 0.5}, {(component + 1) % 3, 0.5}}));
+            product->add_subcircuit(UniformDistribution::make_shared(variable_x,
+                                                                     closed<double>(component, component + 2)));
+            product->add_subcircuit(UniformDistribution::make_shared(variable_y,
+                                                                     closed_open<double>(-component, 1)));
+            root->add_subcircuit(0.2 + 0.1 * component, product);
+        }
+    }
+
+    /**
+     * Column-major rows over a, x and y that hit every component and some impossible rows.
+     */
+    std::vector<double> rows(size_t n_rows) {
+        std::mt19937_64 generator(69);
+        std::uniform_int_distribution<int> code(0, 2);
+        std::uniform_real_distribution<double> value(-2, 5);
+        std::vector<double> data(3 * n_rows);
+        for (size_t row = 0; row < n_rows; row++) {
+            data[row] = code(generator);
+            data[n_rows + row] = value(generator);
+            data[2 * n_rows + row] = value(generator);
+        }
+        return data;
+    }
+};
+
+TEST_F(StaticCircuitTest, MatchesRuntimeCircuit) {
+    StaticCircuit<StaticMixture<Component, 3>> mixture(root);
+    StaticCircuit<StaticSum<Component, Component, Component>> sum(root);
+    ASSERT_EQ(mixture.variables.size(), 3);
+
+    size_t n_rows = 200;
+    auto data = rows(n_rows);
+    std::vector<double> expected(n_rows);
+    root->log_likelihood_batch(data.data(), n_rows, expected.data());
+    std::vector<double> result(n_rows);
+    mixture.log_likelihood_batch(data.data(), n_rows, result.data());
+
+    size_t possible_rows = 0;
+    for (size_t row = 0; row < n_rows; row++) {
+        double values[3] = {data[row], data[n_rows + row], data[2 * n_rows + row]};
+        if (std::isinf(expected[row])) {
+            ASSERT_EQ(result[row], expected[row]);
+            ASSERT_EQ(sum.log_likelihood(values), expected[row]);
+            continue;
+        }
+        possible_rows++;
+        ASSERT_NEAR(result[row], expected[row], 1e-12);
+        ASSERT_NEAR(sum.log_likelihood(values), expected[row], 1e-12);
+    }
+    ASSERT_GT(possible_rows, 10);
+}
+
+TEST_F(StaticCircuitTest, Leaves) {
+    auto dirac_delta = DiracDeltaDistribution::make_shared(variable_x, 2., 5.);
+    StaticCircuit<StaticDiracDelta> static_dirac_delta(dirac_delta);
+    double location = 2.;
+    double elsewhere = 2.5;
+    ASSERT_EQ(static_dirac_delta.log_likelihood(&location), log(5.));
+    ASSERT_EQ(static_dirac_delta.log_likelihood(&elsewhere), -std::numeric_limits<double>::infinity());
+
+    auto uniform = UniformDistribution::make_shared(variable_x, open_closed<double>(0, 2));
+    StaticCircuit<StaticUniform> static_uniform(uniform);
+    double lower = 0.;
+    double upper = 2.;
+    ASSERT_EQ(static_uniform.log_likelihood(&lower), -std::numeric_limits<double>::infinity());
+    ASSERT_EQ(static_uniform.log_likelihood(&upper), log(0.5));
+}
+
+TEST_F(StaticCircuitTest, ShapeMismatch) {
+    typedef StaticCircuit<StaticMixture<Component, 2>> TooFewComponents;
+    ASSERT_THROW(TooFewComponents{root}, std::invalid_argument);
+
+    typedef StaticCircuit<StaticMixture<StaticProduct<StaticDiscrete<2>, StaticUniform, StaticUniform>, 3>> FewCodes;
+    ASSERT_THROW(FewCodes{root}, std::invalid_argument);
+
+    typedef StaticCircuit<StaticMixture<StaticProduct<StaticDiscrete<3>, StaticUniform, StaticDiracDelta>, 3>> Leaf;
+    ASSERT_THROW(Leaf{root}, std::invalid_argument);
+
+    typedef StaticCircuit<StaticProduct<Component>> Product;
+    ASSERT_THROW(Product{root}, std::invalid_argument);
+}
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+
+TEST(ThreadPool, RunsAllTasks) {
+    ThreadPool thread_pool(4);
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 1000; i++) {
+        thread_pool.submit([&counter] { counter++; });
+    }
+    thread_pool.wait();
+    EXPECT_EQ(counter, 1000);
+}
+
+TEST(ThreadPool, NestedTasks) {
+    ThreadPool thread_pool(3);
+    std::atomic<int> leaves{0};
+    std::function<void(int)> recurse = [&](int depth) {
+        if (depth == 0) {
+            leaves++;
+            return;
+        }
+        thread_pool.submit([&recurse, depth] { recurse(depth - 1); });
+        thread_pool.submit([&recurse, depth] { recurse(depth - 1); });
+    };
+    thread_pool.submit([&recurse] { recurse(10); });
+    thread_pool.wait();
+    EXPECT_EQ(leaves, 1 << 10);
+}
+
+TEST(ThreadPool, RethrowsExceptions) {
+    ThreadPool thread_pool(2);
+    thread_pool.submit([] { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(thread_pool.wait(), std::runtime_error);
+    thread_pool.submit([] {});
+    EXPECT_NO_THROW(thread_pool.wait());
+}
+
+TEST(ThreadPool, ParseCpuList) {
+    EXPECT_EQ(parse_cpu_list("0-3,8,10-11\n"), (std::vector<size_t>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(parse_cpu_list("5"), (std::vector<size_t>{5}));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+    EXPECT_THROW(parse_cpu_list("3-1"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("1;2"), std::invalid_argument);
+}
+
+TEST(ThreadPool, PinWorkers) {
+    ThreadPool thread_pool(2);
+    EXPECT_THROW(thread_pool.pin_workers({}), std::invalid_argument);
+#ifdef __linux__
+    thread_pool.pin_workers({0});
+    std::atomic<int> counter{0};
+    thread_pool.submit([&counter] { counter++; });
+    thread_pool.wait();
+    EXPECT_EQ(counter, 1);
+#endif
+}
@@ -43,4 +43,85 @@ TEST(DiracDeltaDistribution, Likelihood){
     auto d4 = DiracDeltaDistribution(continuous_x, 1, 3);
     EXPECT_EQ(d4.pdf(1), 3);
     EXPECT_EQ(d4.pdf(2), 0);
-}
\ No newline at end of file
+}
+
+TEST(UniformDistribution, LogLikelihoodBatch) {
+    auto d1 = UniformDistribution(continuous_x, closed_open<double>(0, 2));
+    auto data = std::vector<double>{-1, 0, 0.5, 2, 3};
+    auto result = std::vector<double>(data.size());
+    d1.log_likelihood_batch(data.data(), data.size(), result.data());
+    for (size_t row = 0; row < data.size(); row++) {
+        EXPECT_EQ(result[row], d1.log_pdf(data[row]));
+    }
+}
+
+TEST(SymbolicDistribution, LogLikelihoodBatch) {
+    auto d2 = SymbolicDistribution(symbolic_a, std::map<int, double>{{0, 0.7}, {2, 0.3}});
+    auto data = std::vector<double>{0, 1, 2, 2};
+    auto result = std::vector<double>(data.size());
+    d2.log_likelihood_batch(data.data(), data.size(), result.data());
+    EXPECT_EQ(result[0], log(0.7));
+    EXPECT_EQ(result[1], log(0.));
+    EXPECT_EQ(result[2], log(0.3));
+    EXPECT_EQ(result[3], log(0.3));
+}
+
+TEST(DiracDeltaDistribution, LogLikelihoodBatch) {
+    auto d4 = DiracDeltaDistribution(continuous_x, 1, 3);
+    auto data = std::vector<double>{1, 2};
+    auto result = std::vector<double>(data.size());
+    d4.log_likelihood_batch(data.data(), data.size(), result.data());
+    EXPECT_EQ(result[0], log(3.));
+    EXPECT_EQ(result[1], log(0.));
+}
+
+TEST(IntegerDistribution, DenseProbabilities) {
+    auto d3 = IntegerDistribution(integer_i, std::map<int, double>{{-2, 0.25}, {1, 0.75}});
+    ASSERT_TRUE(d3.is_dense());
+    EXPECT_EQ(d3.first_code(), -2);
+    EXPECT_EQ(d3.dense_probabilities(), (std::vector<double>{0.25, 0., 0., 0.75}));
+    EXPECT_DOUBLE_EQ(d3.pmf(-2), 0.25);
+    EXPECT_DOUBLE_EQ(d3.pmf(0), 0.);
+    EXPECT_DOUBLE_EQ(d3.pmf(5), 0.);
+
+    std::vector<double> values{-3, -2, -1, 0, 1, 2};
+    std::vector<double> out(values.size());
+    d3.log_likelihood_batch(values.data(), values.size(), out.data());
+    for (size_t index = 0; index < values.size(); index++) {
+        auto event = std::make_shared<FullEvidence>(FullEvidence{values[index]});
+        EXPECT_DOUBLE_EQ(out[index], log(d3.pmf((int) values[index])));
+        EXPECT_DOUBLE_EQ(d3.log_likelihood(event), out[index]);
+    }
+}
+
+TEST(IntegerDistribution, SparseProbabilities) {
+    auto d3 = IntegerDistribution(integer_i, std::map<int, double>{{-1000, 0.5}, {1000, 0.5}});
+    EXPECT_FALSE(d3.is_dense());
+    EXPECT_DOUBLE_EQ(d3.pmf(1000), 0.5);
+    EXPECT_DOUBLE_EQ(d3.pmf(0), 0.);
+
+    std::vector<double> values{-1000, 0, 1000};
+    std::vector<double> out(values.size());
+    d3.log_likelihood_batch(values.data(), values.size(), out.data());
+    EXPECT_DOUBLE_EQ(out[0], log(0.5));
+    EXPECT_DOUBLE_EQ(out[1], -std::numeric_limits<double>::infinity());
+    EXPECT_DOUBLE_EQ(out[2], log(0.5));
+}
+
+TEST(SymbolicDistribution, DenseProbabilitiesAfterSetProbabilities) {
+    auto d2 = SymbolicDistribution(symbolic_a, std::map<int, double>{{0, 0.7}, {2, 0.3}});
+    d2.set_probabilities({{0, 0.1}, {1, 0.9}});
+    EXPECT_DOUBLE_EQ(d2.pmf(1), 0.9);
+    EXPECT_DOUBLE_EQ(d2.pmf(2), 0.);
+    EXPECT_EQ(d2.dense_log_probabilities().size(), 2);
+}
+
+TEST(SymbolicDistribution, CopiesViewTheirOwnProbabilities) {
+    auto d2 = SymbolicDistribution(symbolic_a, std::map<int, double>{{0, 0.7}, {2, 0.3}});
+    auto copy = d2;
+    copy.set_probabilities({{1, 1.}});
+    EXPECT_EQ(d2.probabilities, (std::map<int, double>{{0, 0.7}, {2, 0.3}}));
+    EXPECT_EQ(copy.probabilities, (std::map<int, double>{{1, 1.}}));
+    EXPECT_DOUBLE_EQ(d2.pmf(2), 0.3);
+    EXPECT_DOUBLE_EQ(copy.pmf(1), 1.);
+}